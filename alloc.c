@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "alloc.h"
+
+
+int alloc_profiling = 0;
+
+/* what a subsystem or a call site allocated */
+typedef struct alloc_counts {
+    long count;
+    long bytes;
+} alloc_counts;
+
+/* a place in the code that allocates */
+typedef struct alloc_site {
+    char* file; /* NULL for an unused entry */
+    int line;
+    alloc_subsystem subsystem;
+    alloc_counts counts;
+} alloc_site;
+
+/* put in front of every block while profiling, so freeing it knows its size.
+ * it is 16 bytes so the block stays aligned like malloc's blocks */
+typedef union alloc_header {
+    unsigned long size;
+    char padding[16];
+} alloc_header;
+
+char* subsystem_names[ALLOC_SUBSYSTEMS] = {
+    "utils", "sentences", "data_nodes", "preprocessor", "second_pass", "ob_file", "object_file", "optimizer", "errors", "assembler", "library", "driver"
+};
+
+alloc_counts total_counts;
+alloc_counts subsystem_counts[ALLOC_SUBSYSTEMS];
+alloc_site alloc_sites[MAX_ALLOC_SITES + 1]; /* a hash table, the last entry is for the sites that didn't fit */
+long live_bytes = 0;
+long peak_live_bytes = 0;
+
+
+/* counts an allocation of size bytes (or the growth of a block to size bytes) at the call site */
+void count_allocation(unsigned long size, alloc_subsystem subsystem, char* file, int line) {
+    unsigned long hash = ((unsigned long)file * 31 + line) % MAX_ALLOC_SITES;
+    alloc_site* site;
+    int tries;
+
+    /* the file is always the same __FILE__ string of its file, so its address is enough */
+    site = &alloc_sites[hash];
+    for (tries = 0; site->file != NULL && (site->file != file || site->line != line); tries++) {
+        hash = (hash + 1) % MAX_ALLOC_SITES;
+        site = &alloc_sites[hash];
+        if (tries == MAX_ALLOC_SITES) { /* the table is full */
+            site = &alloc_sites[MAX_ALLOC_SITES];
+            site->file = "(other sites)";
+            break;
+        }
+    }
+    if (site->file == NULL) {
+        site->file = file;
+        site->line = line;
+        site->subsystem = subsystem;
+    }
+
+    site->counts.count++;
+    site->counts.bytes += size;
+    subsystem_counts[subsystem].count++;
+    subsystem_counts[subsystem].bytes += size;
+    total_counts.count++;
+    total_counts.bytes += size;
+}
+
+/* adds the change in the live bytes */
+void count_live(long change) {
+    live_bytes += change;
+    if (live_bytes > peak_live_bytes)
+        peak_live_bytes = live_bytes;
+}
+
+void* tagged_malloc(unsigned long size, alloc_subsystem subsystem, char* file, int line) {
+    alloc_header* header;
+
+    if (!alloc_profiling)
+        return malloc(size);
+
+    header = (alloc_header*)malloc(sizeof(alloc_header) + size);
+    if (header == NULL)
+        return NULL;
+    header->size = size;
+    count_allocation(size, subsystem, file, line);
+    count_live(size);
+    return header + 1;
+}
+
+void* tagged_calloc(unsigned long count, unsigned long size, alloc_subsystem subsystem, char* file, int line) {
+    void* pointer;
+
+    if (!alloc_profiling)
+        return calloc(count, size);
+
+    pointer = tagged_malloc(count * size, subsystem, file, line);
+    if (pointer != NULL)
+        memset(pointer, 0, count * size);
+    return pointer;
+}
+
+void* tagged_realloc(void* pointer, unsigned long size, alloc_subsystem subsystem, char* file, int line) {
+    alloc_header* header;
+    unsigned long old_size;
+
+    if (!alloc_profiling)
+        return realloc(pointer, size);
+    if (pointer == NULL)
+        return tagged_malloc(size, subsystem, file, line);
+
+    header = (alloc_header*)pointer - 1;
+    old_size = header->size;
+    header = (alloc_header*)realloc(header, sizeof(alloc_header) + size);
+    if (header == NULL)
+        return NULL;
+    header->size = size;
+
+    /* a reallocation counts as an allocation of the bytes it added */
+    count_allocation(size > old_size ? size - old_size : 0, subsystem, file, line);
+    count_live((long)size - (long)old_size);
+    return header + 1;
+}
+
+char* tagged_strdup(const char* text, alloc_subsystem subsystem, char* file, int line) {
+    unsigned long length = strlen(text) + 1;
+    char* copy = (char*)tagged_malloc(length, subsystem, file, line);
+
+    if (copy != NULL)
+        memcpy(copy, text, length);
+    return copy;
+}
+
+void tagged_free(void* pointer) {
+    alloc_header* header;
+
+    if (!alloc_profiling || pointer == NULL) {
+        free(pointer);
+        return;
+    }
+
+    header = (alloc_header*)pointer - 1;
+    count_live(-(long)header->size);
+    free(header);
+}
+
+
+/* orders call sites by their bytes, the most first */
+int compare_sites(const void* a, const void* b) {
+    long difference = ((alloc_site*)b)->counts.bytes - ((alloc_site*)a)->counts.bytes;
+    return (difference > 0) - (difference < 0);
+}
+
+/* prints what was allocated by every subsystem and the call sites that allocated the most */
+void print_alloc_report(FILE* stream) {
+    alloc_site sites[MAX_ALLOC_SITES + 1];
+    int site_count;
+    int i;
+
+    fprintf(stream, "allocations: %ld (%ld bytes), peak %ld bytes live, %ld bytes still live\n",
+            total_counts.count, total_counts.bytes, peak_live_bytes, live_bytes);
+
+    for (i=0; i<ALLOC_SUBSYSTEMS; i++)
+        if (subsystem_counts[i].count > 0)
+            fprintf(stream, "  %-13s %9ld allocations %11ld bytes\n", subsystem_names[i],
+                    subsystem_counts[i].count, subsystem_counts[i].bytes);
+
+    site_count = 0;
+    for (i=0; i<=MAX_ALLOC_SITES; i++)
+        if (alloc_sites[i].file != NULL)
+            sites[site_count++] = alloc_sites[i];
+    qsort(sites, site_count, sizeof(alloc_site), compare_sites);
+
+    fprintf(stream, "top call sites:\n");
+    for (i=0; i<site_count && i<10; i++) {
+        char place[128];
+        sprintf(place, "%.100s:%d", sites[i].file, sites[i].line);
+        fprintf(stream, "  %-20s %-13s %9ld allocations %11ld bytes\n", place,
+                subsystem_names[sites[i].subsystem], sites[i].counts.count, sites[i].counts.bytes);
+    }
+}
@@ -0,0 +1,52 @@
+/* every allocation of the assembler goes through these macros, so they can be counted by subsystem and by call site
+ * (all --alloc-stats). nothing is counted unless alloc_profiling is set before the first allocation,
+ * and building with -DNO_ALLOC_TAGS turns the macros back into plain malloc and free.
+ * every file that allocates defines ALLOC_SUBSYSTEM as the subsystem its allocations are counted under */
+
+typedef enum {
+    ALLOC_UTILS,
+    ALLOC_SENTENCES,
+    ALLOC_DATA_NODES,
+    ALLOC_PREPROCESSOR,
+    ALLOC_SECOND_PASS,
+    ALLOC_OB_FILE,
+    ALLOC_OBJECT_FILE,
+    ALLOC_OPTIMIZER,
+    ALLOC_ERRORS,
+    ALLOC_ASSEMBLER,
+    ALLOC_LIBRARY, /* asm.c and asm_session.c */
+    ALLOC_DRIVER, /* the command line, the cache, the server and the other modes */
+    ALLOC_SUBSYSTEMS
+} alloc_subsystem;
+
+/* how many different call sites are counted, the rest are counted together */
+#define MAX_ALLOC_SITES 512
+
+#ifdef NO_ALLOC_TAGS
+#define MALLOC(size) malloc(size)
+#define CALLOC(count, size) calloc(count, size)
+#define REALLOC(pointer, size) realloc(pointer, size)
+#define STRDUP(text) strdup(text)
+#define FREE(pointer) free(pointer)
+#else
+#define MALLOC(size) tagged_malloc(size, ALLOC_SUBSYSTEM, __FILE__, __LINE__)
+#define CALLOC(count, size) tagged_calloc(count, size, ALLOC_SUBSYSTEM, __FILE__, __LINE__)
+#define REALLOC(pointer, size) tagged_realloc(pointer, size, ALLOC_SUBSYSTEM, __FILE__, __LINE__)
+#define STRDUP(text) tagged_strdup(text, ALLOC_SUBSYSTEM, __FILE__, __LINE__)
+#define FREE(pointer) tagged_free(pointer)
+#endif
+
+extern int alloc_profiling;
+
+
+void* tagged_malloc(unsigned long size, alloc_subsystem subsystem, char* file, int line);
+
+void* tagged_calloc(unsigned long count, unsigned long size, alloc_subsystem subsystem, char* file, int line);
+
+void* tagged_realloc(void* pointer, unsigned long size, alloc_subsystem subsystem, char* file, int line);
+
+char* tagged_strdup(const char* text, alloc_subsystem subsystem, char* file, int line);
+
+void tagged_free(void* pointer);
+
+void print_alloc_report(FILE* stream);
@@ -0,0 +1,279 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sentences.h"
+#include "errors.h"
+#include "data_nodes.h"
+#include "utils.h"
+#include "preprocessor.h"
+#include "assembler.h"
+#include "asm.h"
+#include "asm_internal.h"
+#include "alloc.h"
+
+#define ALLOC_SUBSYSTEM ALLOC_LIBRARY
+
+
+struct asm_context {
+    asm_allocator allocator;
+    diagnostics diag; /* the messages of the current compilation (the list is reused) */
+    char* source; /* a null terminated copy of the current source (reused) */
+    long source_capacity;
+    int out_of_memory; /* set when the allocator failed while building the current result */
+};
+
+
+/* the default allocator */
+void* default_allocate(unsigned long size, void* data) {
+    return MALLOC(size);
+}
+
+void default_release(void* pointer, void* data) {
+    FREE(pointer);
+}
+
+
+/* creates a context that uses the given allocator for the results (NULL for malloc and free) */
+asm_context* asm_create_context(asm_allocator* allocator) {
+    asm_context* context = (asm_context*)MALLOC(sizeof(asm_context));
+    if (context == NULL)
+        return NULL;
+
+    if (allocator != NULL)
+        context->allocator = *allocator;
+    else {
+        context->allocator.allocate = default_allocate;
+        context->allocator.release = default_release;
+        context->allocator.data = NULL;
+    }
+
+    start_diagnostics(&context->diag, NULL, 0);
+    context->source = NULL;
+    context->source_capacity = 0;
+    context->out_of_memory = FALSE;
+
+    return context;
+}
+
+/* frees a context and everything it kept for reuse */
+void asm_destroy_context(asm_context* context) {
+    if (context == NULL)
+        return;
+    free_diagnostics(&context->diag);
+    FREE(context->source);
+    FREE(context);
+}
+
+
+/* allocates memory for the result with the caller's allocator */
+void* result_allocate(asm_context* context, unsigned long size) {
+    void* pointer;
+
+    if (size == 0)
+        size = 1;
+    pointer = context->allocator.allocate(size, context->allocator.data);
+    if (pointer == NULL)
+        context->out_of_memory = TRUE;
+    return pointer;
+}
+
+void result_release(asm_context* context, void* pointer) {
+    if (pointer != NULL)
+        context->allocator.release(pointer, context->allocator.data);
+}
+
+/* copies length bytes of text into memory from the caller's allocator and null terminates it */
+char* result_copy(asm_context* context, char* text, long length) {
+    char* copy = (char*)result_allocate(context, length + 1);
+    if (copy == NULL)
+        return NULL;
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    return copy;
+}
+
+/* turns the text of a .ent or .ext file ("<name> <address>" lines) into a list of symbols, returns the amount of symbols */
+int to_symbols(asm_context* context, char* text, asm_symbol** symbols) {
+    line_reader reader;
+    char* line;
+    int count;
+
+    *symbols = NULL;
+    count = count_lines(text);
+    if (count == 0)
+        return 0;
+
+    *symbols = (asm_symbol*)result_allocate(context, count * sizeof(asm_symbol));
+    if (*symbols == NULL)
+        return 0;
+
+    count = 0;
+    start_lines(&reader, text);
+    line = next_line(&reader);
+    while (line != NULL) {
+        char* space = strchr(line, ' ');
+
+        if (space != NULL) {
+            (*symbols)[count].name = result_copy(context, line, space - line);
+            (*symbols)[count].address = atoi(space);
+            count++;
+        }
+        line = next_line(&reader);
+    }
+    end_lines(&reader);
+
+    return count;
+}
+
+/* hands the collected messages over to the result */
+void to_messages(asm_context* context, diagnostics* diag, asm_result* result) {
+    int i;
+    
+    result->messages = NULL;
+    result->message_count = 0;
+    if (diag->count == 0)
+        return;
+
+    result->messages = (asm_message*)result_allocate(context, diag->count * sizeof(asm_message));
+    if (result->messages == NULL)
+        return;
+
+    for (i=0; i<diag->count; i++) {
+        diagnostic* d = &diag->list[i];
+        char* message = diagnostic_message(d);
+
+        result->messages[i].line = d->line;
+        result->messages[i].column = d->column;
+        result->messages[i].span = d->span;
+        result->messages[i].code = diagnostic_code_name(d->code);
+        result->messages[i].severity = diagnostic_severity(d->code);
+        result->messages[i].message = result_copy(context, message, strlen(message));
+        FREE(message);
+    }
+    result->message_count = diag->count;
+}
+
+/* fills the result of a successful assembly with copies of its outputs (made with the context's allocator).
+ * words has the IC + DC words of the .ob file, ent_text and ext_text are NULL when there is no .ent or .ext file.
+ * returns whether the assembly succeeded, which is only false when the allocator failed */
+int fill_result(asm_context* context, diagnostics* diag, asm_result* result, char* am_text, char* ob_image, int* words, int IC, int DC, char* ent_text, char* ext_text) {
+    context->out_of_memory = FALSE;
+    
+    result->am_length = strlen(am_text);
+    result->am = result_copy(context, am_text, result->am_length);
+    
+    to_messages(context, diag, result);
+
+    result->IC = IC;
+    result->DC = DC;
+
+    result->ob_length = strlen(ob_image);
+    result->ob = result_copy(context, ob_image, result->ob_length);
+
+    result->word_count = result->IC + result->DC;
+    result->words = (int*)result_allocate(context, result->word_count * sizeof(int));
+    if (result->words != NULL)
+        memcpy(result->words, words, result->word_count * sizeof(int));
+
+    if (ent_text != NULL)
+        result->ent = result_copy(context, ent_text, strlen(ent_text));
+    if (ext_text != NULL)
+        result->ext = result_copy(context, ext_text, strlen(ext_text));
+
+    result->entry_count = to_symbols(context, ent_text, &result->entries);
+    result->external_count = to_symbols(context, ext_text, &result->externals);
+
+    if (context->out_of_memory) {
+        asm_free_result(context, result);
+        return FALSE;
+    }
+
+    result->succeeded = TRUE;
+    return TRUE;
+}
+
+
+/* assembles length bytes of source text (it doesn't need to be null terminated).
+ * everything in the result is allocated with the context's allocator and is released with asm_free_result.
+ * returns whether the assembly succeeded (the messages are in the result either way) */
+int asm_compile_buffer(asm_context* context, const char* source, long length, asm_result* result) {
+    char* am_text;
+    char* ob_image;
+    int* words;
+    second_pass_result* texts;
+    int succeeded;
+
+    memset(result, 0, sizeof(asm_result));
+    clear_diagnostics(&context->diag);
+    context->out_of_memory = FALSE;
+
+    /* the passes work on null terminated text, the copy is kept for the next call */
+    if (length + 1 > context->source_capacity) {
+        char* bigger = (char*)REALLOC(context->source, length + 1);
+        if (bigger == NULL)
+            return FALSE;
+        context->source = bigger;
+        context->source_capacity = length + 1;
+    }
+    memcpy(context->source, source, length);
+    context->source[length] = '\0';
+
+    am_text = create_am_file(context->source, &context->diag);
+    if (am_text == NULL) {
+        to_messages(context, &context->diag, result);
+        return FALSE;
+    }
+
+    ob_image = NULL;
+    words = NULL;
+    texts = assemble(context->source, am_text, NULL, &ob_image, &words, NULL, &context->diag); /* the default engine */
+
+    if (texts == NULL) {
+        /* the .am text is part of the result even when the assembly fails */
+        result->am_length = strlen(am_text);
+        result->am = result_copy(context, am_text, result->am_length);
+        to_messages(context, &context->diag, result);
+        if (context->out_of_memory)
+            asm_free_result(context, result);
+        FREE(am_text);
+        return FALSE;
+    }
+
+    succeeded = fill_result(context, &context->diag, result, am_text, ob_image, words, texts->IC, texts->DC,
+                            texts->ent_file, texts->ext_file);
+
+    FREE(am_text);
+    FREE(ob_image);
+    FREE(words);
+    FREE(texts->ent_file);
+    FREE(texts->ext_file);
+    FREE(texts->words); /* only there with all --object */
+    free_symbol_nodes(texts->entries);
+    free_symbol_nodes(texts->externals);
+    FREE(texts);
+
+    return succeeded;
+}
+
+/* releases everything in a result created by asm_compile_buffer */
+void asm_free_result(asm_context* context, asm_result* result) {
+    int i;
+
+    for (i=0; i<result->entry_count && result->entries != NULL; i++)
+        result_release(context, result->entries[i].name);
+    for (i=0; i<result->external_count && result->externals != NULL; i++)
+        result_release(context, result->externals[i].name);
+    for (i=0; i<result->message_count && result->messages != NULL; i++)
+        result_release(context, result->messages[i].message);
+
+    result_release(context, result->am);
+    result_release(context, result->ob);
+    result_release(context, result->ent);
+    result_release(context, result->ext);
+    result_release(context, result->words);
+    result_release(context, result->entries);
+    result_release(context, result->externals);
+    result_release(context, result->messages);
+
+    memset(result, 0, sizeof(asm_result));
+}
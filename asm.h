@@ -0,0 +1,94 @@
+#ifndef ASM_H
+#define ASM_H
+
+/* the library interface of the assembler (libasm.a).
+ * it assembles source text in memory without touching the file system, and it doesn't keep or read any global state
+ * (it always uses the default engine), so different threads can assemble at the same time as long as each one uses
+ * its own context */
+
+
+/* the memory functions used for everything that is handed to the caller */
+typedef struct asm_allocator {
+    void* (*allocate)(unsigned long size, void* data);
+    void (*release)(void* pointer, void* data);
+    void* data; /* passed to allocate and release */
+} asm_allocator;
+
+/* an entry (the address of the label) or an external (the address of the word that uses it) */
+typedef struct asm_symbol {
+    char* name;
+    int address;
+} asm_symbol;
+
+/* an error or warning in the source */
+typedef struct asm_message {
+    int line;
+    int column; /* where in the line (starting from 1), 0 when it isn't known */
+    int span; /* how many characters of the line it is about */
+    char* code; /* "E<number>" for errors and "W<number>" for warnings */
+    char* severity; /* "error" or "warning" */
+    char* message;
+} asm_message;
+
+/* everything the assembler produces for one source */
+typedef struct asm_result {
+    int succeeded;
+
+    int IC;
+    int DC;
+
+    char* am; /* the text of the .am file, NULL if the preprocessor failed */
+    long am_length;
+    char* ob; /* the text of the .ob file (null terminated) */
+    long ob_length;
+    int* words; /* the value of the word at every address, starting at address 100 */
+    int word_count;
+
+    char* ent; /* the texts of the .ent and .ext files, NULL when they would not be created */
+    char* ext;
+    asm_symbol* entries; /* the lines of the .ent file */
+    int entry_count;
+    asm_symbol* externals; /* the lines of the .ext file */
+    int external_count;
+
+    asm_message* messages;
+    int message_count;
+} asm_result;
+
+/* the state that is kept between compilations, its buffers are reused by the next call */
+typedef struct asm_context asm_context;
+
+
+asm_context* asm_create_context(asm_allocator* allocator);
+
+void asm_destroy_context(asm_context* context);
+
+int asm_compile_buffer(asm_context* context, const char* source, long length, asm_result* result);
+
+void asm_free_result(asm_context* context, asm_result* result);
+
+
+/* a source that stays loaded between edits (see asm_session.c).
+ * the session keeps the lines, the symbols and the words of the last assembly, so an edit of a few lines
+ * only re-assembles those lines and the words that point at labels that moved */
+typedef struct asm_session asm_session;
+
+/* what an edit cost */
+typedef struct asm_edit_stats {
+    int incremental; /* FALSE when the whole source had to be assembled again */
+    int lines_lexed;
+    int words_encoded; /* the words of the edited lines */
+    int words_patched; /* words of other lines that point at a label that moved */
+} asm_edit_stats;
+
+asm_session* asm_session_create(asm_context* context);
+
+void asm_session_destroy(asm_session* session);
+
+int asm_session_load(asm_session* session, const char* source, long length);
+
+int asm_session_edit(asm_session* session, int first_line, int line_count, const char* text, long length, asm_edit_stats* stats);
+
+int asm_session_result(asm_session* session, asm_result* result);
+
+#endif
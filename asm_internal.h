@@ -0,0 +1,3 @@
+/* the parts of the library that are shared between its files but aren't part of its interface (asm.h) */
+
+int fill_result(asm_context* context, diagnostics* diag, asm_result* result, char* am_text, char* ob_image, int* words, int IC, int DC, char* ent_text, char* ext_text);
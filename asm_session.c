@@ -0,0 +1,1247 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sentences.h"
+#include "errors.h"
+#include "utils.h"
+#include "arguments.h"
+#include "data_nodes.h"
+#include "first_pass.h"
+#include "preprocessor.h"
+#include "ob_file.h"
+#include "second_pass.h"
+#include "assembler.h"
+#include "asm.h"
+#include "asm_internal.h"
+#include "alloc.h"
+
+#define ALLOC_SUBSYSTEM ALLOC_LIBRARY
+
+
+/* the amount of lists in the symbol table (a power of 2) */
+#define SYMBOL_TABLE_SIZE 4096
+
+/* what a line of the source is.
+ * LINE_FIXED lines (.define, .extern, .entry and macros) change the meaning of other lines,
+ * so editing one of them assembles the whole source again */
+typedef enum {LINE_BLANK, LINE_CODE, LINE_DATA, LINE_FIXED} line_kind;
+
+struct session_symbol;
+
+/* a line of the source and what it became.
+ * the lines are the nodes of a treap in the order of the source (see the lines below), and every line keeps the sums
+ * of its subtree, so nothing a line keeps depends on the lines before it and an edit never changes the lines after it */
+typedef struct session_line {
+    char* text; /* without the new line */
+    line_kind kind;
+    int length; /* the amount of words the line takes */
+    int* words; /* the value of every word of the line */
+    struct session_symbol* label; /* the label defined on the line */
+    struct session_symbol* operands[2]; /* the labels the operands point at (NULL for any other operand) */
+    int operand_words[2]; /* the word of each of those operands (from the start of the line) */
+    struct session_symbol* external; /* the external of the line's .ext line */
+    int external_word;
+    struct session_symbol* entry; /* the label of a .entry line */
+
+    struct session_line* left; /* the lines before it in its subtree */
+    struct session_line* right; /* the lines after it in its subtree */
+    struct session_line* parent;
+    unsigned int priority; /* smaller than the priority of the parent */
+    int line_sum; /* the amount of lines in the subtree */
+    int code_sum; /* the instruction words of the subtree */
+    int data_sum; /* the data words of the subtree */
+    int code_label_sum; /* the lines of the subtree that define a label on an instruction */
+    int data_label_sum; /* the lines of the subtree that define a label on data */
+
+    struct session_line* previous_label; /* the lines that define a label of the same kind, in their order */
+    struct session_line* next_label;
+} session_line;
+
+/* an operand word that points at a label */
+typedef struct session_reference {
+    session_line* line;
+    int operand;
+    struct session_reference* next;
+} session_reference;
+
+typedef struct session_symbol {
+    char* name;
+    int is_external;
+    session_line* definition; /* the line that defines the label, NULL when there isn't one */
+    int address; /* the address its references were encoded with */
+    int entries; /* the amount of .entry lines that name it */
+    session_reference* references; /* the reference index of the label */
+    struct session_symbol* next; /* the next symbol in the same list of the table */
+} session_symbol;
+
+/* a .define, a name can be defined again and every line sees the last definition before it */
+typedef struct session_define {
+    char* name;
+    int value;
+    session_line* line; /* the .define line (it is never removed by an incremental edit) */
+    struct session_define* next;
+} session_define;
+
+struct asm_session {
+    asm_context* context;
+
+    session_line* lines; /* the root of the treap of the lines */
+    int line_count;
+    unsigned int seed; /* of the priorities of the lines */
+
+    int succeeded; /* whether the source assembles */
+    int is_incremental; /* FALSE when every edit assembles the whole source again (macros or errors in the source) */
+
+    int IC;
+    int DC;
+
+    session_line* first_label[2]; /* the first line that defines a label on an instruction [0] and on data [1] */
+    session_line* last_label[2];
+
+    session_symbol* symbols[SYMBOL_TABLE_SIZE];
+    session_define* defines; /* in the order of their lines */
+    diagnostics diag; /* the messages of the last full assembly */
+    session_line** diagnostic_lines; /* the line of every message (.extern and .entry lines, so edits don't remove them) */
+};
+
+
+void* session_allocate(unsigned long size) {
+    void* pointer = MALLOC(size);
+    if (pointer == NULL) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    return pointer;
+}
+
+
+/* --- the symbol table --- */
+
+unsigned int symbol_hash(char* name) {
+    unsigned int hash = 5381;
+    while (*name != '\0')
+        hash = hash * 33 + (unsigned char)*name++;
+    return hash & (SYMBOL_TABLE_SIZE - 1);
+}
+
+session_symbol* find_symbol(asm_session* session, char* name) {
+    session_symbol* current = session->symbols[symbol_hash(name)];
+    while (current != NULL && strcmp(current->name, name) != 0)
+        current = current->next;
+    return current;
+}
+
+/* returns the symbol of the given name, it is created if it doesn't exist */
+session_symbol* add_symbol(asm_session* session, char* name) {
+    session_symbol* symbol;
+    unsigned int hash;
+
+    symbol = find_symbol(session, name);
+    if (symbol != NULL)
+        return symbol;
+
+    hash = symbol_hash(name);
+    symbol = (session_symbol*)session_allocate(sizeof(session_symbol));
+    symbol->name = STRDUP(name);
+    symbol->is_external = FALSE;
+    symbol->definition = NULL;
+    symbol->address = -1;
+    symbol->entries = 0;
+    symbol->references = NULL;
+    symbol->next = session->symbols[hash];
+    session->symbols[hash] = symbol;
+    return symbol;
+}
+
+/* frees the symbol if nothing uses it anymore */
+void release_symbol(asm_session* session, session_symbol* symbol) {
+    session_symbol** link;
+
+    if (symbol->is_external || symbol->definition != NULL || symbol->entries > 0 || symbol->references != NULL)
+        return;
+
+    link = &session->symbols[symbol_hash(symbol->name)];
+    while (*link != symbol)
+        link = &(*link)->next;
+    *link = symbol->next;
+
+    FREE(symbol->name);
+    FREE(symbol);
+}
+
+void free_references(session_reference* current) {
+    while (current != NULL) {
+        session_reference* next = current->next;
+        FREE(current);
+        current = next;
+    }
+}
+
+void free_symbols(asm_session* session) {
+    int i;
+    for (i=0; i<SYMBOL_TABLE_SIZE; i++) {
+        session_symbol* current = session->symbols[i];
+        while (current != NULL) {
+            session_symbol* next = current->next;
+            free_references(current->references);
+            FREE(current->name);
+            FREE(current);
+            current = next;
+        }
+        session->symbols[i] = NULL;
+    }
+}
+
+void add_reference(session_symbol* symbol, session_line* line, int operand) {
+    session_reference* reference = (session_reference*)session_allocate(sizeof(session_reference));
+    reference->line = line;
+    reference->operand = operand;
+    reference->next = symbol->references;
+    symbol->references = reference;
+}
+
+/* disconnects a line that is being removed from the symbols */
+void unhook_line(session_line* line) {
+    int i;
+
+    for (i=0; i<2; i++) {
+        session_reference** link;
+
+        if (line->operands[i] == NULL)
+            continue;
+        link = &line->operands[i]->references;
+        while (*link != NULL && ((*link)->line != line || (*link)->operand != i))
+            link = &(*link)->next;
+        if (*link != NULL) {
+            session_reference* reference = *link;
+            *link = reference->next;
+            FREE(reference);
+        }
+    }
+
+    if (line->label != NULL && line->label->definition == line)
+        line->label->definition = NULL;
+}
+
+
+/* --- lines --- */
+
+session_line* create_line(const char* text, long length) {
+    session_line* line = (session_line*)session_allocate(sizeof(session_line));
+    memset(line, 0, sizeof(session_line));
+    line->text = (char*)session_allocate(length + 1);
+    memcpy(line->text, text, length);
+    line->text[length] = '\0';
+    line->line_sum = 1;
+    return line;
+}
+
+void free_line(session_line* line) {
+    FREE(line->words);
+    FREE(line->text);
+    FREE(line);
+}
+
+/* splits length bytes of text into lines, *count is set to the amount of lines */
+session_line** split_lines(const char* text, long length, int* count) {
+    session_line** lines;
+    long start;
+    long i;
+
+    *count = 0;
+    for (i=0; i<length; i++)
+        if (text[i] == '\n')
+            (*count)++;
+    if (length > 0 && text[length-1] != '\n')
+        (*count)++; /* the last line doesn't end with a new line */
+
+    lines = (session_line**)session_allocate((*count + 1) * sizeof(session_line*));
+
+    *count = 0;
+    start = 0;
+    for (i=0; i<=length; i++) {
+        if (i == length ? i > start : text[i] == '\n') {
+            lines[(*count)++] = create_line(text + start, i - start);
+            start = i + 1;
+        }
+    }
+    return lines;
+}
+
+
+/* --- the treap of the lines ---
+ * a binary tree in the order of the source where the priority of every line is random and smaller than its parent's,
+ * so it stays balanced through any edit. the sums of the subtrees give the words before a line on the way up to the root,
+ * and the labels that moved are found without going through the lines that have none */
+
+#define LINE_SUM(line) ((line) != NULL ? (line)->line_sum : 0)
+#define CODE_SUM(line) ((line) != NULL ? (line)->code_sum : 0)
+#define DATA_SUM(line) ((line) != NULL ? (line)->data_sum : 0)
+
+/* sets the sums of the line from what it is and from the sums of its children */
+void update_sums(session_line* line) {
+    line->line_sum = 1 + LINE_SUM(line->left) + LINE_SUM(line->right);
+    line->code_sum = (line->kind == LINE_CODE ? line->length : 0) + CODE_SUM(line->left) + CODE_SUM(line->right);
+    line->data_sum = (line->kind == LINE_DATA ? line->length : 0) + DATA_SUM(line->left) + DATA_SUM(line->right);
+    line->code_label_sum = (line->kind == LINE_CODE && line->label != NULL);
+    line->data_label_sum = (line->kind == LINE_DATA && line->label != NULL);
+    if (line->left != NULL) {
+        line->code_label_sum += line->left->code_label_sum;
+        line->data_label_sum += line->left->data_label_sum;
+    }
+    if (line->right != NULL) {
+        line->code_label_sum += line->right->code_label_sum;
+        line->data_label_sum += line->right->data_label_sum;
+    }
+}
+
+/* updates the sums of the line and of the lines above it after it changed */
+void update_sums_up(session_line* line) {
+    for (; line != NULL; line = line->parent)
+        update_sums(line);
+}
+
+/* updates the sums of every line of the subtree */
+void update_all_sums(session_line* line) {
+    if (line == NULL)
+        return;
+    update_all_sums(line->left);
+    update_all_sums(line->right);
+    update_sums(line);
+}
+
+unsigned int next_priority(asm_session* session) {
+    session->seed = session->seed * 1103515245 + 12345;
+    return session->seed >> 8;
+}
+
+/* builds the treap of count lines in their order, returns its root */
+session_line* build_tree(asm_session* session, session_line** lines, int count) {
+    session_line** stack; /* the lines on the right edge of the tree */
+    session_line* root;
+    int top;
+    int i;
+
+    stack = (session_line**)session_allocate((count + 1) * sizeof(session_line*));
+    top = 0;
+    for (i=0; i<count; i++) {
+        session_line* line = lines[i];
+        session_line* last = NULL;
+
+        line->priority = next_priority(session);
+        line->right = NULL;
+        while (top > 0 && stack[top-1]->priority < line->priority) { /* finished, they go under the new line */
+            last = stack[--top];
+            update_sums(last);
+        }
+        line->left = last;
+        if (last != NULL)
+            last->parent = line;
+        line->parent = (top > 0) ? stack[top-1] : NULL;
+        if (top > 0)
+            stack[top-1]->right = line;
+        stack[top++] = line;
+    }
+    root = (top > 0) ? stack[0] : NULL;
+    while (top > 0)
+        update_sums(stack[--top]);
+    FREE(stack);
+    return root;
+}
+
+/* splits the tree into its first count lines and the rest */
+void split_tree(session_line* root, int count, session_line** before, session_line** after) {
+    if (root == NULL) {
+        *before = NULL;
+        *after = NULL;
+        return;
+    }
+    if (count <= LINE_SUM(root->left)) {
+        split_tree(root->left, count, before, &root->left);
+        if (root->left != NULL)
+            root->left->parent = root;
+        *after = root;
+    }
+    else {
+        split_tree(root->right, count - LINE_SUM(root->left) - 1, &root->right, after);
+        if (root->right != NULL)
+            root->right->parent = root;
+        *before = root;
+    }
+    root->parent = NULL;
+    update_sums(root);
+}
+
+/* joins two trees, the lines of before come first */
+session_line* merge_trees(session_line* before, session_line* after) {
+    if (before == NULL)
+        return after;
+    if (after == NULL)
+        return before;
+    if (before->priority > after->priority) {
+        before->right = merge_trees(before->right, after);
+        before->right->parent = before;
+        update_sums(before);
+        return before;
+    }
+    after->left = merge_trees(before, after->left);
+    after->left->parent = after;
+    update_sums(after);
+    return after;
+}
+
+/* adds the lines of the subtree to lines in their order */
+void collect_lines(session_line* line, session_line** lines, int* count) {
+    if (line == NULL)
+        return;
+    collect_lines(line->left, lines, count);
+    lines[(*count)++] = line;
+    collect_lines(line->right, lines, count);
+}
+
+void free_tree(session_line* line) {
+    if (line == NULL)
+        return;
+    free_tree(line->left);
+    free_tree(line->right);
+    free_line(line);
+}
+
+session_line* first_session_line(asm_session* session) {
+    session_line* line = session->lines;
+    while (line != NULL && line->left != NULL)
+        line = line->left;
+    return line;
+}
+
+/* returns the line after the given one, NULL after the last line */
+session_line* next_session_line(session_line* line) {
+    if (line->right != NULL) {
+        line = line->right;
+        while (line->left != NULL)
+            line = line->left;
+        return line;
+    }
+    while (line->parent != NULL && line->parent->right == line)
+        line = line->parent;
+    return line->parent;
+}
+
+/* replaces removed_count lines from the index first with count lines, the removed lines are copied to removed */
+void replace_lines(asm_session* session, int first, int removed_count, session_line** removed, session_line** lines, int count) {
+    session_line* before;
+    session_line* middle;
+    session_line* after;
+    int collected;
+
+    split_tree(session->lines, first, &before, &after);
+    split_tree(after, removed_count, &middle, &after);
+    collected = 0;
+    collect_lines(middle, removed, &collected);
+
+    session->lines = merge_trees(merge_trees(before, build_tree(session, lines, count)), after);
+    if (session->lines != NULL)
+        session->lines->parent = NULL;
+    session->line_count += count - removed_count;
+}
+
+/* returns the index of the line */
+int line_index(session_line* line) {
+    int index = LINE_SUM(line->left);
+    for (; line->parent != NULL; line = line->parent)
+        if (line->parent->right == line)
+            index += LINE_SUM(line->parent->left) + 1;
+    return index;
+}
+
+/* sets code and data to the amount of instruction and data words before the line */
+void line_offsets(session_line* line, int* code, int* data) {
+    *code = CODE_SUM(line->left);
+    *data = DATA_SUM(line->left);
+    for (; line->parent != NULL; line = line->parent)
+        if (line->parent->right == line) {
+            session_line* parent = line->parent;
+            *code += CODE_SUM(parent->left) + (parent->kind == LINE_CODE ? parent->length : 0);
+            *data += DATA_SUM(parent->left) + (parent->kind == LINE_DATA ? parent->length : 0);
+        }
+}
+
+/* the address of the label defined on the line */
+int line_address(asm_session* session, session_line* line) {
+    int code;
+    int data;
+
+    line_offsets(line, &code, &data);
+    if (line->kind == LINE_DATA)
+        return FIRST_ADDRESS + session->IC + data;
+    return FIRST_ADDRESS + code;
+}
+
+/* returns the source text of the session's lines */
+char* join_lines(asm_session* session, long* length) {
+    session_line* line;
+    char* text;
+    char* end;
+
+    *length = 0;
+    for (line = first_session_line(session); line != NULL; line = next_session_line(line))
+        *length += strlen(line->text) + 1;
+
+    text = (char*)session_allocate(*length + 1);
+    end = text;
+    for (line = first_session_line(session); line != NULL; line = next_session_line(line)) {
+        long line_length = strlen(line->text);
+        memcpy(end, line->text, line_length);
+        end += line_length;
+        *end++ = '\n';
+    }
+    *end = '\0';
+    return text;
+}
+
+
+/* --- the .define table --- */
+
+void add_session_define(asm_session* session, char* name, int value, session_line* line) {
+    session_define* define;
+    session_define** link;
+
+    define = (session_define*)session_allocate(sizeof(session_define));
+    define->name = STRDUP(name);
+    define->value = value;
+    define->line = line;
+    define->next = NULL;
+
+    link = &session->defines;
+    while (*link != NULL)
+        link = &(*link)->next;
+    *link = define;
+}
+
+/* returns the definition of name that the line with the given index sees (NULL if there isn't one) */
+session_define* find_define(asm_session* session, char* name, int line) {
+    session_define* current;
+    session_define* found;
+
+    found = NULL;
+    for (current = session->defines; current != NULL; current = current->next)
+        if (strcmp(current->name, name) == 0) {
+            if (line_index(current->line) >= line) /* so are the ones after it */
+                break;
+            found = current;
+        }
+    return found;
+}
+
+void free_session_defines(asm_session* session) {
+    session_define* current = session->defines;
+    while (current != NULL) {
+        session_define* next = current->next;
+        FREE(current->name);
+        FREE(current);
+        current = next;
+    }
+    session->defines = NULL;
+}
+
+
+/* --- what the passes do, one line at a time --- */
+
+/* finds out what the line is and how many words it takes, *s is set to its sentence.
+ * returns FALSE if the line has an error (the whole source is assembled again to report it) */
+int lex_line(session_line* line, sentence* s) {
+    operation_type type;
+
+    *s = to_sentence(line->text);
+
+    line->kind = LINE_BLANK;
+    line->length = 0;
+    line->label = NULL;
+    line->operands[0] = NULL;
+    line->operands[1] = NULL;
+    line->external = NULL;
+    line->entry = NULL;
+
+    if (s->is_blank)
+        return TRUE;
+
+    if (strlen(line->text) > MAX_LINE_LENGTH)
+        return FALSE;
+
+    if (strcmp(s->operation, ".define")==0 || strcmp(s->operation, ".extern")==0 || strcmp(s->operation, ".entry")==0 ||
+        strcmp(s->operation, "mcr")==0 || strcmp(s->operation, "endmcr")==0) {
+        line->kind = LINE_FIXED;
+        return TRUE;
+    }
+
+    if (s->err != NULL || find_error(*s) != NULL)
+        return FALSE;
+
+    type = get_operation_type(s->operation);
+    if (type == INSTRUCTION) {
+        line->kind = LINE_CODE;
+        line->length = instruction_number_of_machine_words(*s);
+        return line->length >= 0;
+    }
+    line->kind = LINE_DATA;
+    line->length = data_number_of_machine_words(*s, type);
+    return TRUE;
+}
+
+/* adds what a .define, .extern or .entry line declares to the session, returns FALSE for macros */
+int load_fixed_line(asm_session* session, session_line* line, sentence s) {
+    if (strcmp(s.operation, ".define")==0)
+        add_session_define(session, s.argv[0], to_integer(s.argv[1]), line);
+    else if (strcmp(s.operation, ".extern")==0)
+        add_symbol(session, s.argv[0])->is_external = TRUE;
+    else if (strcmp(s.operation, ".entry")==0) {
+        line->entry = add_symbol(session, s.argv[0]);
+        line->entry->entries++;
+    }
+    else
+        return FALSE;
+    return TRUE;
+}
+
+/* defines the label of the line, returns FALSE if it already exists or it's an external */
+int define_label(asm_session* session, session_line* line, sentence s) {
+    session_symbol* symbol;
+
+    if ((line->kind != LINE_CODE && line->kind != LINE_DATA) || s.label == NULL)
+        return TRUE;
+
+    symbol = add_symbol(session, s.label);
+    if (symbol->is_external || symbol->definition != NULL)
+        return FALSE;
+    symbol->definition = line;
+    line->label = symbol;
+    return TRUE;
+}
+
+/* adds the definition of name that the line sees to defines, returns FALSE if there isn't one */
+int use_define(asm_session* session, define_node** defines, char* name, int index) {
+    session_define* define = find_define(session, name, index);
+    if (define == NULL)
+        return FALSE;
+    if (get_define(*defines, name) == NULL)
+        add_define(defines, name, define->value);
+    return TRUE;
+}
+
+/* connects an operand of the line to the label it points at (labels and externs get what to_words needs).
+ * returns FALSE if there is no such label */
+int use_label(asm_session* session, session_line* line, int operand, int word, int first_operand_words, char* name, label_node** labels, extern_node** externs) {
+    session_symbol* symbol = find_symbol(session, name);
+
+    if (symbol != NULL && symbol->is_external) {
+        /* like in the second pass, only the first external operand gets a .ext line and it's after the first operand */
+        if (line->external == NULL) {
+            line->external = symbol;
+            line->external_word = first_operand_words;
+        }
+        if (get_extern(*externs, name) == NULL)
+            add_extern(externs, name);
+        return TRUE;
+    }
+
+    if (symbol == NULL || symbol->definition == NULL)
+        return FALSE;
+
+    line->operands[operand] = symbol;
+    line->operand_words[operand] = word;
+    add_reference(symbol, line, operand);
+    if (get_label(*labels, name) == NULL)
+        add_label(labels, name, line_address(session, symbol->definition), INSTRUCTION);
+    return TRUE;
+}
+
+/* checks the operands of the line like the second pass does and connects it to the labels it uses.
+ * when encode is set the words of the line are encoded into the session's words.
+ * returns FALSE if the line has an error */
+int resolve_line(asm_session* session, session_line* line, int index, sentence s, int encode, asm_edit_stats* stats) {
+    label_node* labels;
+    extern_node* externs;
+    entry_node* entries;
+    define_node* defines;
+    int valid;
+    int word;
+    int i;
+
+    labels = NULL;
+    externs = NULL;
+    entries = NULL;
+    defines = NULL;
+    valid = TRUE;
+
+    if (line->kind == LINE_DATA && strcmp(s.operation, ".data")==0) {
+        for (i=0; i<s.argc && valid; i++) /* like in the second pass every value is an integer or a define before the line */
+            valid = use_define(session, &defines, s.argv[i], index) || is_integer(s.argv[i]);
+    }
+    else if (line->kind == LINE_CODE) {
+        word = 1; /* the first word is the instruction itself */
+        for (i=0; i<s.argc && valid; i++) {
+            char* arg = s.argv[i];
+            arg_type type = get_arg_type(arg);
+            int first_operand_words = number_of_machine_words_one_arg(get_arg_type(s.argv[0]));
+
+            if (type == NUMBER)
+                valid = use_define(session, &defines, arg+1, index) || is_integer(arg+1);
+            else if (type == VARIABLE)
+                valid = use_label(session, line, i, word, first_operand_words, arg, &labels, &externs);
+            else if (type == ARRAY_AND_INDEX) {
+                char* name = get_array_name(arg);
+                char* array_index = get_array_index(arg);
+
+                valid = array_index != NULL && use_label(session, line, i, word, first_operand_words, name, &labels, &externs);
+                if (valid && use_define(session, &defines, array_index, index))
+                    valid = get_extern(externs, name) == NULL; /* the second pass can't replace the index of an external array */
+                else if (valid)
+                    valid = is_integer(array_index);
+
+                FREE(array_index);
+                FREE(name);
+            }
+            word += number_of_machine_words_one_arg(type);
+        }
+    }
+
+    if (valid && encode) {
+        char* words = to_words(s, &labels, &externs, &entries, &defines);
+        char* next = words;
+        int count = 0;
+
+        FREE(line->words);
+        line->words = (int*)session_allocate((line->length + 1) * sizeof(int));
+        while (next != NULL && *next != '\0' && count < line->length) {
+            line->words[count] = (int)strtol(next, &next, 2);
+            count++;
+            if (*next == '\n')
+                next++;
+        }
+        valid = count == line->length && (next == NULL || *next == '\0');
+        stats->words_encoded += count;
+        FREE(words);
+    }
+
+    free_labels(labels);
+    free_externs(externs);
+    free_defines(defines);
+    return valid;
+}
+
+/* the value of a word that points at a label at the given address */
+int reference_word(int address) {
+    return ((address & 0xFFF) << 2) | RELOCATABLE_ARE;
+}
+
+/* encodes again the words that point at the label if its address changed */
+void patch_label(session_symbol* symbol, int address, asm_edit_stats* stats) {
+    session_reference* reference;
+
+    if (address == symbol->address)
+        return;
+
+    symbol->address = address;
+    for (reference = symbol->references; reference != NULL; reference = reference->next) {
+        reference->line->words[reference->line->operand_words[reference->operand]] = reference_word(address);
+        stats->words_patched++;
+    }
+}
+
+/* the list of the labels of the kind (see first_label) */
+#define LABEL_LIST(kind) ((kind) == LINE_DATA)
+
+/* returns the first line from the index first of the subtree that defines a label of the given kind, NULL if there isn't one */
+session_line* find_label_line(session_line* line, int first, line_kind kind) {
+    session_line* found;
+    int before;
+
+    if (line == NULL || first >= line->line_sum || (kind == LINE_CODE ? line->code_label_sum : line->data_label_sum) == 0)
+        return NULL;
+
+    before = LINE_SUM(line->left);
+    if (first < before && (found = find_label_line(line->left, first, kind)) != NULL)
+        return found;
+    if (first <= before && line->kind == kind && line->label != NULL)
+        return line;
+    return find_label_line(line->right, first > before ? first - before - 1 : 0, kind);
+}
+
+/* adds the line to the list of the labels of its kind before following (at the end when it's NULL) */
+void link_label(asm_session* session, session_line* line, session_line* following) {
+    int list = LABEL_LIST(line->kind);
+
+    line->next_label = following;
+    line->previous_label = (following != NULL) ? following->previous_label : session->last_label[list];
+    if (line->previous_label != NULL)
+        line->previous_label->next_label = line;
+    else
+        session->first_label[list] = line;
+    if (following != NULL)
+        following->previous_label = line;
+    else
+        session->last_label[list] = line;
+}
+
+void unlink_label(asm_session* session, session_line* line) {
+    int list = LABEL_LIST(line->kind);
+
+    if (line->previous_label != NULL)
+        line->previous_label->next_label = line->next_label;
+    else
+        session->first_label[list] = line->next_label;
+    if (line->next_label != NULL)
+        line->next_label->previous_label = line->previous_label;
+    else
+        session->last_label[list] = line->previous_label;
+    line->previous_label = NULL;
+    line->next_label = NULL;
+}
+
+/* patches the labels of the lines from first until last (not included) that moved by delta words */
+void move_labels(session_line* first, session_line* last, int delta, asm_edit_stats* stats) {
+    if (delta == 0)
+        return;
+    for (; first != last; first = first->next_label)
+        patch_label(first->label, first->label->address + delta, stats);
+}
+
+
+/* --- full assembly --- */
+
+void clear_state(asm_session* session) {
+    free_symbols(session);
+    free_session_defines(session);
+    clear_diagnostics(&session->diag);
+    FREE(session->diagnostic_lines);
+    session->diagnostic_lines = NULL;
+    session->IC = 0;
+    session->DC = 0;
+    session->first_label[0] = NULL;
+    session->first_label[1] = NULL;
+    session->last_label[0] = NULL;
+    session->last_label[1] = NULL;
+    session->succeeded = FALSE;
+    session->is_incremental = FALSE;
+}
+
+/* builds the lines, symbols, references and words of a source that was just assembled (words are its words),
+ * returns FALSE if the source can't be edited incrementally */
+int analyze_lines(asm_session* session, int* words) {
+    session_line** lines;
+    sentence* sentences;
+    int count;
+    int ready;
+    int code;
+    int data;
+    int i;
+
+    lines = (session_line**)session_allocate((session->line_count + 1) * sizeof(session_line*));
+    sentences = (sentence*)session_allocate((session->line_count + 1) * sizeof(sentence));
+    count = 0;
+    collect_lines(session->lines, lines, &count);
+    ready = TRUE;
+
+    for (i=0; i<count; i++) {
+        session_line* line = lines[i];
+        if (!lex_line(line, &sentences[i]) || (line->kind == LINE_FIXED && !load_fixed_line(session, line, sentences[i])))
+            ready = FALSE;
+    }
+
+    for (i=0; i<count && ready; i++)
+        ready = define_label(session, lines[i], sentences[i]);
+
+    update_all_sums(session->lines);
+    if (ready && count > 0) /* the words must agree with the assembly */
+        ready = session->lines->code_sum == session->IC && session->lines->data_sum == session->DC;
+
+    /* the messages must be on lines that an incremental edit doesn't remove */
+    if (ready && session->diag.count > 0) {
+        session->diagnostic_lines = (session_line**)session_allocate(session->diag.count * sizeof(session_line*));
+        for (i=0; i<session->diag.count && ready; i++) {
+            int line = session->diag.list[i].line;
+            ready = line >= 1 && line <= count && lines[line - 1]->kind == LINE_FIXED;
+            if (ready)
+                session->diagnostic_lines[i] = lines[line - 1];
+        }
+    }
+
+    for (i=0; i<count && ready; i++)
+        ready = resolve_line(session, lines[i], i, sentences[i], FALSE, NULL);
+
+    /* the words of the assembly are in the order of the lines */
+    code = 0;
+    data = 0;
+    for (i=0; i<count && ready; i++) {
+        session_line* line = lines[i];
+        line->previous_label = NULL;
+        line->next_label = NULL;
+        if (line->label != NULL)
+            link_label(session, line, NULL);
+        FREE(line->words);
+        line->words = (int*)session_allocate((line->length + 1) * sizeof(int));
+        memcpy(line->words, words + code + data, line->length * sizeof(int));
+        if (line->kind == LINE_CODE)
+            code += line->length;
+        else if (line->kind == LINE_DATA)
+            data += line->length;
+    }
+
+    for (i=0; i<count; i++)
+        free_sentence(sentences[i]);
+    FREE(sentences);
+    FREE(lines);
+
+    if (!ready) {
+        free_symbols(session);
+        free_session_defines(session);
+        return FALSE;
+    }
+
+    for (i=0; i<SYMBOL_TABLE_SIZE; i++) {
+        session_symbol* symbol;
+        for (symbol = session->symbols[i]; symbol != NULL; symbol = symbol->next)
+            if (symbol->definition != NULL)
+                symbol->address = line_address(session, symbol->definition);
+    }
+    return TRUE;
+}
+
+/* assembles the whole source and rebuilds everything the session keeps about it, returns whether it assembles */
+int rebuild(asm_session* session) {
+    char* source;
+    long length;
+    char* am_text;
+    char* ob_image;
+    int* words;
+    second_pass_result* texts;
+
+    clear_state(session);
+
+    source = join_lines(session, &length);
+    am_text = create_am_file(source, &session->diag);
+    ob_image = NULL;
+    words = NULL;
+    texts = NULL;
+    if (am_text != NULL)
+        texts = assemble(source, am_text, NULL, &ob_image, &words, NULL, &session->diag);
+    FREE(source);
+    FREE(am_text);
+
+    if (texts == NULL)
+        return FALSE;
+
+    session->IC = texts->IC;
+    session->DC = texts->DC;
+    session->succeeded = TRUE;
+
+    FREE(ob_image);
+    FREE(texts->ent_file);
+    FREE(texts->ext_file);
+    FREE(texts->words); /* only there with all --object */
+    free_symbol_nodes(texts->entries);
+    free_symbol_nodes(texts->externals);
+    FREE(texts);
+
+    session->is_incremental = analyze_lines(session, words);
+    FREE(words);
+    return TRUE;
+}
+
+
+/* --- incremental assembly --- */
+
+/* returns whether any line of the session goes to the .am file, a source without one doesn't assemble (see create_am_file) */
+int has_am_line(asm_session* session) {
+    session_line* line;
+    for (line = first_session_line(session); line != NULL; line = next_session_line(line))
+        if (line->kind != LINE_BLANK)
+            return TRUE;
+    return FALSE;
+}
+
+/* updates the session after the lines from the index first were replaced by the count lines (the removed lines are
+ * already out of the tree). only the new lines are lexed and encoded, and only the words that point at labels that
+ * moved are encoded again, the lines around them don't change. returns FALSE when the edit needs the whole source to be
+ * assembled again */
+int update_lines(asm_session* session, int first, session_line** removed, int removed_count, session_line** lines, int count, asm_edit_stats* stats) {
+    session_symbol** lost_labels;
+    sentence* sentences;
+    int lexed;
+    int valid;
+    int old_code, old_data, new_code, new_data;
+    int i;
+
+    for (i=0; i<removed_count; i++)
+        if (removed[i]->kind == LINE_FIXED)
+            return FALSE;
+
+    /* take the removed lines out of the symbols */
+    lost_labels = (session_symbol**)session_allocate((removed_count + 1) * sizeof(session_symbol*));
+    old_code = 0;
+    old_data = 0;
+    for (i=0; i<removed_count; i++) {
+        if (removed[i]->kind == LINE_CODE)
+            old_code += removed[i]->length;
+        else if (removed[i]->kind == LINE_DATA)
+            old_data += removed[i]->length;
+        lost_labels[i] = removed[i]->label;
+        if (removed[i]->label != NULL)
+            unlink_label(session, removed[i]);
+        unhook_line(removed[i]);
+    }
+
+    /* lex the new lines and define their labels */
+    sentences = (sentence*)session_allocate((count + 1) * sizeof(sentence));
+    valid = TRUE;
+    new_code = 0;
+    new_data = 0;
+    for (lexed=0; lexed<count && valid; lexed++) {
+        session_line* line = lines[lexed];
+        valid = lex_line(line, &sentences[lexed]) && line->kind != LINE_FIXED && define_label(session, line, sentences[lexed]);
+        update_sums_up(line);
+        if (line->kind == LINE_CODE)
+            new_code += line->length;
+        else if (line->kind == LINE_DATA)
+            new_data += line->length;
+    }
+
+    /* only removing lines can leave nothing for the .am file */
+    if (valid && removed_count > 0)
+        valid = has_am_line(session);
+
+    /* a label that is gone must not be used anymore */
+    for (i=0; i<removed_count && valid; i++) {
+        session_symbol* symbol = lost_labels[i];
+        if (symbol != NULL && symbol->definition == NULL && (symbol->references != NULL || symbol->entries > 0))
+            valid = FALSE;
+        else if (symbol != NULL)
+            release_symbol(session, symbol);
+    }
+
+    if (valid) {
+        session->IC += new_code - old_code;
+        session->DC += new_data - old_data;
+
+        for (i=0; i<count && valid; i++)
+            valid = resolve_line(session, lines[i], first + i, sentences[i], TRUE, stats);
+    }
+
+    if (valid) {
+        /* the labels after the new lines move by the words the edit added, and the data after the code moves by the code */
+        session_line* code_after = find_label_line(session->lines, first + count, LINE_CODE);
+        session_line* data_after = find_label_line(session->lines, first + count, LINE_DATA);
+
+        move_labels(code_after, NULL, new_code - old_code, stats);
+        move_labels(session->first_label[1], data_after, new_code - old_code, stats);
+        move_labels(data_after, NULL, new_code - old_code + new_data - old_data, stats);
+
+        for (i=0; i<count; i++)
+            if (lines[i]->label != NULL) {
+                link_label(session, lines[i], lines[i]->kind == LINE_CODE ? code_after : data_after);
+                patch_label(lines[i]->label, line_address(session, lines[i]), stats);
+            }
+    }
+
+    for (i=0; i<lexed; i++)
+        free_sentence(sentences[i]);
+    FREE(sentences);
+    FREE(lost_labels);
+    return valid;
+}
+
+
+/* --- the interface --- */
+
+/* creates an empty session that assembles with the given context (its allocator is used for the results) */
+asm_session* asm_session_create(asm_context* context) {
+    asm_session* session = (asm_session*)MALLOC(sizeof(asm_session));
+    if (session == NULL)
+        return NULL;
+
+    memset(session, 0, sizeof(asm_session));
+    session->context = context;
+    start_diagnostics(&session->diag, NULL, 0);
+    return session;
+}
+
+void asm_session_destroy(asm_session* session) {
+    if (session == NULL)
+        return;
+    clear_state(session);
+    free_diagnostics(&session->diag);
+    free_tree(session->lines);
+    FREE(session);
+}
+
+/* loads (and assembles) a whole source, returns whether it assembles */
+int asm_session_load(asm_session* session, const char* source, long length) {
+    session_line** lines;
+    session_line** removed;
+    int count;
+    int i;
+
+    lines = split_lines(source, length, &count);
+    removed = (session_line**)session_allocate((session->line_count + 1) * sizeof(session_line*));
+    i = session->line_count;
+    replace_lines(session, 0, session->line_count, removed, lines, count);
+    while (i-- > 0)
+        free_line(removed[i]);
+    FREE(removed);
+    FREE(lines);
+
+    return rebuild(session);
+}
+
+/* replaces line_count lines from the line first_line (counting from 1) with the lines of text (length bytes).
+ * a line_count of 0 inserts the text before first_line, a first_line after the last line appends it.
+ * returns whether the edited source assembles, stats (can be NULL) is set to what the edit cost */
+int asm_session_edit(asm_session* session, int first_line, int line_count, const char* text, long length, asm_edit_stats* stats) {
+    asm_edit_stats unused;
+    session_line** lines;
+    session_line** removed;
+    int first;
+    int count;
+    int i;
+
+    if (stats == NULL)
+        stats = &unused;
+    memset(stats, 0, sizeof(asm_edit_stats));
+
+    first = first_line - 1;
+    if (first < 0)
+        first = 0;
+    if (first > session->line_count)
+        first = session->line_count;
+    if (line_count < 0)
+        line_count = 0;
+    if (first + line_count > session->line_count)
+        line_count = session->line_count - first;
+
+    lines = split_lines(text, length, &count);
+    removed = (session_line**)session_allocate((line_count + 1) * sizeof(session_line*));
+    replace_lines(session, first, line_count, removed, lines, count);
+    stats->lines_lexed = count;
+
+    if (session->is_incremental && update_lines(session, first, removed, line_count, lines, count, stats))
+        stats->incremental = TRUE;
+    else {
+        memset(stats, 0, sizeof(asm_edit_stats));
+        stats->lines_lexed = session->line_count;
+        rebuild(session);
+        stats->words_encoded = session->IC + session->DC;
+    }
+
+    for (i=0; i<line_count; i++)
+        free_line(removed[i]);
+    FREE(removed);
+    FREE(lines);
+
+    return session->succeeded;
+}
+
+/* the length of the .ent or .ext line of a name (see second_pass) */
+long symbol_line_length(char* name) {
+    long length = strlen(name);
+    return length + (length > 9 ? 1 : 10 - length) + 12;
+}
+
+/* adds a "<name><spaces><address>" line of a .ent or .ext file at end, returns the new end */
+char* add_symbol_line(char* end, char* name, int address) {
+    int length = strlen(name);
+    return end + sprintf(end, "%s%*s%04d\n", name, length > 9 ? 1 : 10 - length, "", address);
+}
+
+/* fills result with everything the assembler produces for the session's source.
+ * returns whether it assembles */
+int asm_session_result(asm_session* session, asm_result* result) {
+    char* source;
+    long length;
+    char* am_text;
+    char* ent_text;
+    char* ext_text;
+    char* am_end;
+    char* ent_end;
+    char* ext_end;
+    long ent_length;
+    long ext_length;
+    char* ob_image;
+    ob_writer* writer;
+    session_line* line;
+    int* words;
+    int position;
+    int succeeded;
+    int i;
+
+    if (!session->is_incremental) { /* nothing is kept for such a source, it is assembled again */
+        source = join_lines(session, &length);
+        succeeded = asm_compile_buffer(session->context, source, length, result);
+        FREE(source);
+        return succeeded;
+    }
+
+    memset(result, 0, sizeof(asm_result));
+
+    /* there are no macros, so the .am file is the source without its blank lines and comments */
+    length = 0;
+    ent_length = 0;
+    ext_length = 0;
+    for (line = first_session_line(session); line != NULL; line = next_session_line(line)) {
+        if (line->kind != LINE_BLANK)
+            length += strlen(line->text) + 1;
+        if (line->entry != NULL)
+            ent_length += symbol_line_length(line->entry->name);
+        if (line->external != NULL)
+            ext_length += symbol_line_length(line->external->name);
+    }
+
+    am_text = (char*)session_allocate(length + 1);
+    ent_text = (ent_length > 0) ? (char*)session_allocate(ent_length + 1) : NULL;
+    ext_text = (ext_length > 0) ? (char*)session_allocate(ext_length + 1) : NULL;
+    am_end = am_text;
+    ent_end = ent_text;
+    ext_end = ext_text;
+
+    /* the words are in the order of the lines */
+    words = (int*)session_allocate((session->IC + session->DC + 1) * sizeof(int));
+    position = 0;
+    for (line = first_session_line(session); line != NULL; line = next_session_line(line)) {
+        if (line->kind != LINE_BLANK)
+            am_end += sprintf(am_end, "%s\n", line->text);
+        if (line->entry != NULL)
+            ent_end = add_symbol_line(ent_end, line->entry->name, line_address(session, line->entry->definition));
+        if (line->external != NULL)
+            ext_end = add_symbol_line(ext_end, line->external->name, FIRST_ADDRESS + position + line->external_word);
+        memcpy(words + position, line->words, line->length * sizeof(int));
+        position += line->length;
+    }
+    *am_end = '\0';
+
+    /* the messages are on the lines they were reported on, wherever the edits moved them */
+    for (i=0; i<session->diag.count; i++)
+        session->diag.list[i].line = line_index(session->diagnostic_lines[i]) + 1;
+
+    ob_image = create_ob_image(session->IC, session->DC);
+    writer = (ob_writer*)session_allocate(sizeof(ob_writer));
+    start_ob_image_writer(writer, ob_image, session->IC, session->DC);
+    for (i=0; i<session->IC + session->DC; i++) {
+        char binary[15];
+        int bit;
+        for (bit=0; bit<14; bit++)
+            binary[bit] = ((words[i] >> (13 - bit)) & 1) ? '1' : '0';
+        binary[14] = '\0';
+        write_ob_word(writer, FIRST_ADDRESS + i, binary);
+    }
+    flush_ob_writer(writer);
+    FREE(writer);
+
+    succeeded = fill_result(session->context, &session->diag, result, am_text, ob_image, words, session->IC, session->DC,
+                            ent_text, ext_text);
+
+    FREE(words);
+    FREE(am_text);
+    FREE(ent_text);
+    FREE(ext_text);
+    FREE(ob_image);
+    return succeeded;
+}
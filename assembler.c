@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sentences.h"
+#include "errors.h"
+#include "utils.h"
+#include "data_nodes.h"
+#include "arguments.h"
+#include "first_pass.h"
+#include "ob_file.h"
+#include "second_pass.h"
+#include "assembler.h"
+#include "trace.h"
+#include "counters.h"
+#include "stats.h"
+#include "alloc.h"
+
+#define ALLOC_SUBSYSTEM ALLOC_ASSEMBLER
+
+
+/* runs the first and the second pass on the .am text.
+ * the .ob file is written to ob_filename, or into memory (*ob_image) when ob_filename is NULL.
+ * when words isn't NULL *words is set to an array with the value of every word in the .ob file.
+ * options are passed to the second pass (NULL for the defaults).
+ * returns the .ent and .ext texts with the IC and DC, or NULL if an error was found. the errors are reported to diag */
+second_pass_result* assemble(char* as_text, char* am_text, char* ob_filename, char** ob_image, int** words, pass_options* options, diagnostics* diag) {
+    label_node* label_head;
+    extern_node* extern_head;
+    entry_node* entry_head;
+    
+    int IC;
+    int DC;
+    
+    int has_error;
+    
+    char ob_temp_filename[107];
+    int ob_fd;
+    ob_writer* writer;
+    
+    second_pass_result* result;
+    
+    /* the labe, extern and entry lists */
+    label_head = NULL;
+    extern_head = NULL;
+    entry_head = NULL;
+
+    IC=0;
+    DC=0;
+	
+    STATS_ENTER(PHASE_FIRST_PASS);
+    has_error = first_pass(as_text, am_text, &IC, &DC, &label_head, &extern_head, &entry_head, diag);
+    STATS_LEAVE();
+    
+    /* the second pass writes the .ob file while it encodes the words.
+     * it goes to a temporary file which replaces the .ob file only if the whole pass succeeds */
+    writer = NULL;
+    ob_fd = -1;
+    if (!has_error) {
+        writer = (ob_writer*)MALLOC(sizeof(ob_writer));
+        if (writer == NULL) {
+            printf("Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        
+        if (ob_filename != NULL) {
+            strcpy(ob_temp_filename, ob_filename);
+            strcat(ob_temp_filename, ".tmp");
+            ob_fd = create_ob_file(ob_temp_filename, IC, DC);
+            start_ob_writer(writer, ob_fd, IC, DC);
+        }
+        else {
+            *ob_image = create_ob_image(IC, DC);
+            start_ob_image_writer(writer, *ob_image, IC, DC);
+        }
+        
+        if (words != NULL) {
+            *words = (int*)MALLOC((IC + DC + 1) * sizeof(int)); /* +1 so an empty program still gets an array */
+            if (*words == NULL) {
+                printf("Memory allocation failed\n");
+                exit(EXIT_FAILURE);
+            }
+            writer->words = *words;
+        }
+    }
+	
+    STATS_ENTER(PHASE_SECOND_PASS);
+    result = second_pass(as_text, am_text, IC, DC, has_error, &label_head, &extern_head, &entry_head, writer, options, diag);
+    STATS_LEAVE();
+    
+    if (writer != NULL) {
+        STATS_ENTER(PHASE_OB_FILE);
+        flush_ob_writer(writer);
+        FREE(writer);
+        
+        if (ob_filename != NULL) {
+            close_ob_file(ob_fd);
+            if (result != NULL)
+                replace_file(ob_temp_filename, ob_filename); /* the .ob file is complete (an identical .ob file is left as it was) */
+            else
+                remove(ob_temp_filename); /* the words written so far are useless */
+        }
+        else if (result == NULL) {
+            FREE(*ob_image);
+            *ob_image = NULL;
+        }
+        
+        if (words != NULL && result == NULL) {
+            FREE(*words);
+            *words = NULL;
+        }
+        STATS_LEAVE();
+    }
+    
+    free_labels(label_head);
+    free_externs(extern_head);
+    free_entrys(entry_head);
+    
+    return result;
+}
+
+/* runs both passes on the .am text without encoding anything (for all --check).
+ * returns whether the source has no errors, the errors are reported to diag */
+int check_source(char* as_text, char* am_text, diagnostics* diag) {
+    label_node* label_head;
+    extern_node* extern_head;
+    entry_node* entry_head;
+    int IC;
+    int DC;
+    int has_error;
+    second_pass_result* result;
+    
+    label_head = NULL;
+    extern_head = NULL;
+    entry_head = NULL;
+    
+    STATS_ENTER(PHASE_FIRST_PASS);
+    has_error = first_pass(as_text, am_text, &IC, &DC, &label_head, &extern_head, &entry_head, diag);
+    STATS_LEAVE();
+    STATS_ENTER(PHASE_SECOND_PASS);
+    result = second_pass(as_text, am_text, IC, DC, has_error, &label_head, &extern_head, &entry_head, NULL, NULL, diag);
+    STATS_LEAVE();
+    
+    free_labels(label_head);
+    free_externs(extern_head);
+    free_entrys(entry_head);
+    
+    if (result == NULL)
+        return FALSE;
+    FREE(result->ent_file);
+    FREE(result->ext_file);
+    FREE(result);
+    return TRUE;
+}
@@ -0,0 +1,3 @@
+second_pass_result* assemble(char* as_text, char* am_text, char* ob_filename, char** ob_image, int** words, pass_options* options, diagnostics* diag);
+
+int check_source(char* as_text, char* am_text, diagnostics* diag);
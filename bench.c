@@ -0,0 +1,274 @@
+/* the end-to-end benchmark (make bench), it runs the assembler on every file a few times and prints a json report:
+ *
+ *     bench [--runs=N] [--label=text] [--baseline=assembler] <assembler> <files.as>
+ *
+ * every run is a new process (like a build would run it), its output goes to /dev/null.
+ * for every file the report has its lines and bytes, the fastest, median and slowest run,
+ * the lines and megabytes per second of the median run and the peak resident memory of all of the runs,
+ * and the same for all of the files together. the label (usually the commit) is copied into the report
+ * so that reports of different commits can be told apart.
+ * with --baseline the other assembler runs on every file too (every run of the one right after a run of the other,
+ * so both see the same machine) and the report has its median times and the speedup of the assembler over it */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+
+#define DEFAULT_RUNS 5
+
+/* the results of one file */
+typedef struct file_result {
+    char* filename;
+    long lines;
+    long bytes;
+    double* milliseconds; /* of every run, sorted */
+    double* baseline_milliseconds; /* the same for the baseline, if there is one */
+    long peak_rss; /* in kilobytes */
+    int failed; /* the assembler didn't finish with 0 on some run (error lines make it fail) */
+} file_result;
+
+
+double now_in_milliseconds() {
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    return now.tv_sec * 1000.0 + now.tv_usec / 1000.0;
+}
+
+/* counts the lines and bytes of the file, returns 0 if it can't be read */
+int measure_file(char* filename, long* lines, long* bytes) {
+    char buffer[65536];
+    size_t length;
+    size_t i;
+    FILE* file = fopen(filename, "rb");
+
+    if (file == NULL)
+        return 0;
+    *lines = 0;
+    *bytes = 0;
+    while ((length = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        for (i = 0; i < length; i++)
+            if (buffer[i] == '\n')
+                (*lines)++;
+        *bytes += length;
+    }
+    fclose(file);
+    return 1;
+}
+
+/* runs the assembler on the file once, sets the time of the run and the peak memory of the process.
+ * returns the exit status of the assembler, or -1 if it couldn't run */
+int run_once(char* assembler, char* name, double* milliseconds, long* peak_rss) {
+    struct rusage usage;
+    double start;
+    int status;
+    pid_t pid;
+
+    start = now_in_milliseconds();
+    pid = fork();
+    if (pid < 0)
+        return -1;
+    if (pid == 0) {
+        int null = open("/dev/null", O_WRONLY);
+        if (null >= 0) {
+            dup2(null, 1);
+            dup2(null, 2);
+        }
+        execl(assembler, assembler, name, (char*)NULL);
+        _exit(127);
+    }
+    if (wait4(pid, &status, 0, &usage) < 0)
+        return -1;
+    *milliseconds = now_in_milliseconds() - start;
+    *peak_rss = usage.ru_maxrss;
+    return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+int compare_doubles(const void* a, const void* b) {
+    double x = *(double*)a;
+    double y = *(double*)b;
+    return (x > y) - (x < y);
+}
+
+/* the median of sorted values */
+double median(double* values, int count) {
+    if (count % 2 == 1)
+        return values[count / 2];
+    return (values[count / 2 - 1] + values[count / 2]) / 2;
+}
+
+/* prints the speed of the lines and bytes in the median time as json fields */
+void print_rates(long lines, long bytes, double milliseconds) {
+    double seconds = milliseconds / 1000;
+    if (seconds <= 0)
+        seconds = 1e-9;
+    printf("\"lines_per_second\": %.0f, \"mb_per_second\": %.3f", lines / seconds, bytes / seconds / 1e6);
+}
+
+/* prints a json string (the filenames and labels don't need more than this) */
+void print_json_string(char* text) {
+    putchar('"');
+    for (; *text; text++) {
+        if (*text == '"' || *text == '\\')
+            putchar('\\');
+        putchar(*text);
+    }
+    putchar('"');
+}
+
+int main(int argc, char* argv[]) {
+    file_result* results;
+    char* label;
+    char* assembler;
+    char* baseline;
+    long total_lines;
+    long total_bytes;
+    long peak_rss;
+    double total_milliseconds;
+    double baseline_milliseconds;
+    int file_count;
+    int runs;
+    int failed;
+    int i;
+    int j;
+
+    runs = DEFAULT_RUNS;
+    label = "";
+    baseline = NULL;
+    for (i = 1; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+        if (strncmp(argv[i], "--runs=", 7) == 0 && atoi(argv[i] + 7) > 0)
+            runs = atoi(argv[i] + 7);
+        else if (strncmp(argv[i], "--label=", 8) == 0)
+            label = argv[i] + 8;
+        else if (strncmp(argv[i], "--baseline=", 11) == 0)
+            baseline = argv[i] + 11;
+        else {
+            fprintf(stderr, "error: unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (argc - i < 2) {
+        fprintf(stderr, "usage: bench [--runs=N] [--label=text] [--baseline=assembler] <assembler> <files.as>\n");
+        return 1;
+    }
+    assembler = argv[i++];
+    file_count = argc - i;
+
+    results = (file_result*)calloc(file_count, sizeof(file_result));
+    if (results == NULL) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+
+    total_lines = 0;
+    total_bytes = 0;
+    total_milliseconds = 0;
+    baseline_milliseconds = 0;
+    peak_rss = 0;
+    failed = 0;
+
+    for (j = 0; j < file_count; j++) {
+        file_result* result = &results[j];
+        char name[256];
+        int length;
+
+        result->filename = argv[i + j];
+        length = strlen(result->filename);
+        if (length < 3 || length - 3 >= (int)sizeof(name) || strcmp(result->filename + length - 3, ".as") != 0 ||
+            !measure_file(result->filename, &result->lines, &result->bytes)) {
+            fprintf(stderr, "error: can't read %s\n", result->filename);
+            return 1;
+        }
+        sprintf(name, "%.*s", length - 3, result->filename); /* the assembler adds the .as */
+
+        result->milliseconds = (double*)malloc(runs * sizeof(double));
+        result->baseline_milliseconds = (double*)malloc(runs * sizeof(double));
+        if (result->milliseconds == NULL || result->baseline_milliseconds == NULL) {
+            printf("Memory allocation failed\n");
+            exit(1);
+        }
+
+        for (length = 0; length < runs; length++) {
+            long rss;
+            int status = run_once(assembler, name, &result->milliseconds[length], &rss);
+
+            if (status < 0 || status == 127) {
+                fprintf(stderr, "error: can't run %s\n", assembler);
+                return 1;
+            }
+            if (status != 0)
+                result->failed = 1;
+            if (rss > result->peak_rss)
+                result->peak_rss = rss;
+
+            if (baseline != NULL) {
+                status = run_once(baseline, name, &result->baseline_milliseconds[length], &rss);
+                if (status < 0 || status == 127) {
+                    fprintf(stderr, "error: can't run %s\n", baseline);
+                    return 1;
+                }
+            }
+        }
+        qsort(result->milliseconds, runs, sizeof(double), compare_doubles);
+        qsort(result->baseline_milliseconds, runs, sizeof(double), compare_doubles);
+
+        total_lines += result->lines;
+        total_bytes += result->bytes;
+        total_milliseconds += median(result->milliseconds, runs);
+        if (result->peak_rss > peak_rss)
+            peak_rss = result->peak_rss;
+        failed += result->failed;
+        if (baseline != NULL) {
+            baseline_milliseconds += median(result->baseline_milliseconds, runs);
+            fprintf(stderr, "%s: %ld lines, %.2f ms (the baseline %.2f ms)\n", result->filename, result->lines,
+                    median(result->milliseconds, runs), median(result->baseline_milliseconds, runs));
+        }
+        else
+            fprintf(stderr, "%s: %ld lines, %.2f ms\n", result->filename, result->lines, median(result->milliseconds, runs));
+    }
+
+    printf("{\"label\": ");
+    print_json_string(label);
+    printf(", \"assembler\": ");
+    print_json_string(assembler);
+    if (baseline != NULL) {
+        printf(", \"baseline\": ");
+        print_json_string(baseline);
+    }
+    printf(", \"runs\": %d, \"files\": [", runs);
+    for (j = 0; j < file_count; j++) {
+        file_result* result = &results[j];
+        double middle = median(result->milliseconds, runs);
+
+        printf("%s\n  {\"file\": ", j > 0 ? "," : "");
+        print_json_string(result->filename);
+        printf(", \"lines\": %ld, \"bytes\": %ld, \"min_ms\": %.3f, \"median_ms\": %.3f, \"max_ms\": %.3f, ",
+               result->lines, result->bytes, result->milliseconds[0], middle, result->milliseconds[runs - 1]);
+        print_rates(result->lines, result->bytes, middle);
+        printf(", \"peak_rss_kb\": %ld, \"succeeded\": %s", result->peak_rss, result->failed ? "false" : "true");
+        if (baseline != NULL)
+            printf(", \"baseline_median_ms\": %.3f, \"speedup\": %.3f",
+                   median(result->baseline_milliseconds, runs), median(result->baseline_milliseconds, runs) / middle);
+        printf("}");
+        free(result->milliseconds);
+        free(result->baseline_milliseconds);
+    }
+    printf("\n], \"total\": {\"files\": %d, \"lines\": %ld, \"bytes\": %ld, \"median_ms\": %.3f, ",
+           file_count, total_lines, total_bytes, total_milliseconds);
+    print_rates(total_lines, total_bytes, total_milliseconds);
+    printf(", \"peak_rss_kb\": %ld, \"failed\": %d", peak_rss, failed);
+    if (baseline != NULL) {
+        printf(", \"baseline_median_ms\": %.3f, \"speedup\": %.3f", baseline_milliseconds, baseline_milliseconds / total_milliseconds);
+        fprintf(stderr, "%s is %.2fx as fast as %s\n", assembler, baseline_milliseconds / total_milliseconds, baseline);
+    }
+    printf("}}\n");
+
+    free(results);
+    return 0;
+}
@@ -0,0 +1,120 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "sentences.h"
+#include "utils.h"
+#include "cache.h"
+#include "alloc.h"
+
+#define ALLOC_SUBSYSTEM ALLOC_DRIVER
+
+
+/* 64 bit FNV-1a */
+#define HASH_START 14695981039346656037UL
+#define HASH_PRIME 1099511628211UL
+
+
+/* adds length bytes to an FNV-1a hash */
+unsigned long add_to_hash(unsigned long hash, char* bytes, long length) {
+    long i;
+    for (i=0; i<length; i++) {
+        hash ^= (unsigned char)bytes[i];
+        hash *= HASH_PRIME;
+    }
+    return hash;
+}
+
+/* returns the cache key of a source: the hash of the assembler version, the options that change the outputs
+ * (the messages mention the filename and can be json) and the text */
+unsigned long hash_source(char* options, char* text, long length) {
+    unsigned long hash = add_to_hash(HASH_START, ASSEMBLER_VERSION, strlen(ASSEMBLER_VERSION) + 1);
+    hash = add_to_hash(hash, options, strlen(options) + 1);
+    return add_to_hash(hash, text, length);
+}
+
+
+/* puts the name of the cache entry of the given hash into filename */
+void cache_entry_name(char* filename, char* cache_dir, unsigned long hash) {
+    sprintf(filename, "%.200s/%016lx", cache_dir, hash);
+}
+
+/* loads the cached outputs of the given hash, returns FALSE if they aren't in the cache (or the entry is damaged) */
+int load_cached(char* cache_dir, unsigned long hash, cached_outputs* outputs) {
+    char filename[240];
+    source_file entry;
+    char* cursor;
+    char* end;
+    int found_all;
+    int found;
+
+    cache_entry_name(filename, cache_dir, hash);
+    if (!read_file(filename, &entry))
+        return FALSE;
+
+    cursor = entry.text;
+    end = entry.text + entry.length;
+
+    outputs->messages = read_section(&cursor, end, "messages", &found);
+    found_all = found;
+    outputs->am = read_section(&cursor, end, "am", &found);
+    found_all = found_all && found;
+    outputs->ob = read_section(&cursor, end, "ob", &found);
+    found_all = found_all && found;
+    outputs->ent = read_section(&cursor, end, "ent", &found);
+    found_all = found_all && found;
+    outputs->ext = read_section(&cursor, end, "ext", &found);
+    found_all = found_all && found && cursor == end;
+
+    close_file(&entry);
+
+    if (!found_all || outputs->am == NULL || outputs->ob == NULL) {
+        free_cached(outputs);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* stores the outputs of a compilation under the given hash.
+ * the entry is written to a temporary file and renamed, so builds that run at the same time never see half an entry */
+void store_cached(char* cache_dir, unsigned long hash, cached_outputs* outputs) {
+    char filename[240];
+    char temp_filename[260];
+    FILE* file;
+
+    mkdir(cache_dir, 0777); /* fails harmlessly if it exists */
+
+    cache_entry_name(filename, cache_dir, hash);
+    sprintf(temp_filename, "%s.%ld", filename, (long)getpid());
+
+    file = fopen(temp_filename, "w");
+    if (file == NULL)
+        return; /* the cache is only an optimization */
+
+    write_section(file, "messages", outputs->messages);
+    write_section(file, "am", outputs->am);
+    write_section(file, "ob", outputs->ob);
+    write_section(file, "ent", outputs->ent);
+    write_section(file, "ext", outputs->ext);
+
+    if (fclose(file) != 0) {
+        remove(temp_filename);
+        return;
+    }
+    rename(temp_filename, filename);
+}
+
+void free_cached(cached_outputs* outputs) {
+    FREE(outputs->messages);
+    FREE(outputs->am);
+    FREE(outputs->ob);
+    FREE(outputs->ent);
+    FREE(outputs->ext);
+    outputs->messages = NULL;
+    outputs->am = NULL;
+    outputs->ob = NULL;
+    outputs->ent = NULL;
+    outputs->ext = NULL;
+}
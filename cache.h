@@ -0,0 +1,27 @@
+/* the build cache (all --cache).
+ * the outputs of every successful compilation are stored under a hash of the .as file, the assembler version and the options,
+ * so an unchanged file is never assembled again */
+
+/* part of every hash, change it whenever the outputs of the assembler change */
+#define ASSEMBLER_VERSION "asm-1.2"
+
+/* the directory of the cache when --cache is given without one */
+#define DEFAULT_CACHE_DIR ".asm_cache"
+
+/* the outputs of a compilation as they are kept in the cache (NULL for a file that isn't created) */
+typedef struct cached_outputs {
+    char* messages; /* what was printed while compiling */
+    char* am;
+    char* ob;
+    char* ent;
+    char* ext;
+} cached_outputs;
+
+
+unsigned long hash_source(char* options, char* text, long length);
+
+int load_cached(char* cache_dir, unsigned long hash, cached_outputs* outputs);
+
+void store_cached(char* cache_dir, unsigned long hash, cached_outputs* outputs);
+
+void free_cached(cached_outputs* outputs);
@@ -0,0 +1,140 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "sentences.h"
+#include "errors.h"
+#include "data_nodes.h"
+#include "utils.h"
+#include "preprocessor.h"
+#include "assembler.h"
+#include "check.h"
+#include "trace.h"
+#include "alloc.h"
+
+#define ALLOC_SUBSYSTEM ALLOC_DRIVER
+
+
+/* the files of one --check run, the threads take the next file until there are none left */
+typedef struct check_job {
+    char** filenames;
+    int count;
+    int next; /* the index of the next file to check */
+    pthread_mutex_t lock;
+    char** reports; /* the messages of every file (NULL when there are none) */
+    int* failed; /* whether every file has errors */
+    int json; /* the messages are written as json */
+    int max_errors;
+} check_job;
+
+
+/* checks one file, returns whether it has errors. *messages is set to its messages (NULL when there are none) */
+int check_file(check_job* job, char* filename, char** messages) {
+    char filename_with_extension[103];
+    source_file as_file;
+    diagnostics diag;
+    char* am_text;
+    int failed;
+
+    sprintf(filename_with_extension, "%.98s.as", filename);
+    start_diagnostics(&diag, filename_with_extension, job->max_errors);
+
+    if (!read_file(filename_with_extension, &as_file)) {
+        report(&diag, FILE_NOT_FOUND, 0, NULL, NULL, NULL);
+        am_text = NULL;
+        failed = TRUE;
+    }
+    else {
+        am_text = create_am_file(as_file.text, &diag);
+        failed = (am_text == NULL) || !check_source(as_file.text, am_text, &diag);
+        close_file(&as_file);
+    }
+
+    *messages = job->json ? diagnostics_json(&diag) : diagnostics_text(&diag);
+
+    FREE(am_text);
+    free_diagnostics(&diag);
+    return failed;
+}
+
+void* check_thread(void* data) {
+    check_job* job = (check_job*)data;
+
+    while (1) {
+        int i;
+
+        pthread_mutex_lock(&job->lock);
+        i = job->next++;
+        pthread_mutex_unlock(&job->lock);
+
+        if (i >= job->count)
+            break;
+        TRACE_BEGIN("check", job->filenames[i]);
+        job->failed[i] = check_file(job, job->filenames[i], &job->reports[i]);
+        TRACE_END();
+    }
+    return NULL;
+}
+
+/* checks the given files (without their .as extension) and prints their messages in the order of the files,
+ * as text or as one line of json for every file. a file stops being checked after max_errors errors (0 for no limit).
+ * returns 0 if none of them has errors and 1 otherwise */
+int check_files(int filec, char* filenames[], int json, int max_errors) {
+    check_job job;
+    pthread_t* threads;
+    int thread_count;
+    int failed_count;
+    double start;
+    int i;
+
+    start = now_in_microseconds();
+
+    thread_count = DEFAULT_CHECK_THREADS;
+#ifdef _SC_NPROCESSORS_ONLN
+    if (sysconf(_SC_NPROCESSORS_ONLN) > 0)
+        thread_count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (thread_count > filec)
+        thread_count = filec;
+
+    job.filenames = filenames;
+    job.count = filec;
+    job.next = 0;
+    job.json = json;
+    job.max_errors = max_errors;
+    pthread_mutex_init(&job.lock, NULL);
+    job.reports = (char**)CALLOC(filec + 1, sizeof(char*));
+    job.failed = (int*)CALLOC(filec + 1, sizeof(int));
+    threads = (pthread_t*)MALLOC((thread_count + 1) * sizeof(pthread_t));
+    if (job.reports == NULL || job.failed == NULL || threads == NULL) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+
+    /* the files are checked by the threads, this thread checks too */
+    for (i=1; i<thread_count; i++)
+        if (pthread_create(&threads[i], NULL, check_thread, &job) != 0)
+            thread_count = i;
+    check_thread(&job);
+    for (i=1; i<thread_count; i++)
+        pthread_join(threads[i], NULL);
+
+    failed_count = 0;
+    for (i=0; i<filec; i++) {
+        if (job.reports[i] != NULL)
+            fputs(job.reports[i], stdout);
+        failed_count += job.failed[i];
+        FREE(job.reports[i]);
+    }
+    fflush(stdout);
+
+    fprintf(stderr, "checked %d files in %.2f ms, %d with errors\n", filec, (now_in_microseconds() - start) / 1000, failed_count);
+
+    pthread_mutex_destroy(&job.lock);
+    FREE(job.reports);
+    FREE(job.failed);
+    FREE(threads);
+    return failed_count > 0;
+}
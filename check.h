@@ -0,0 +1,8 @@
+/* the check mode (all --check <files>).
+ * the files are preprocessed and go through both passes in parallel without encoding anything or writing any file,
+ * and their messages are printed in the order of the files (see DIAGNOSTIC_FORMAT in errors.h) */
+
+/* how many files are checked at the same time when the amount of processors isn't known */
+#define DEFAULT_CHECK_THREADS 4
+
+int check_files(int filec, char* filenames[], int json, int max_errors);
@@ -0,0 +1,373 @@
+/* the corpus generator (make corpus), it writes a random but valid looking .as file of the given amount of lines:
+ *
+ *     corpus [--seed=N] [--mix=kind:weight,...] <lines> <file.as>
+ *
+ * the same seed and mix always give the same file. the kinds of lines are
+ * instruction (every operation with every addressing mode it allows), data, string, define,
+ * macro (a new macro or a use of an old one), extern, entry, error (lines the assembler must reject)
+ * and comment (comments and blank lines). the names are only used after they are defined so that the
+ * file assembles unless it has error lines */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+#define TRUE 1
+#define FALSE 0
+
+/* the kinds of lines and their default weights */
+typedef enum {
+    INSTRUCTION_LINE,
+    DATA_LINE,
+    STRING_LINE,
+    DEFINE_LINE,
+    MACRO_LINE,
+    EXTERN_LINE,
+    ENTRY_LINE,
+    ERROR_LINE,
+    COMMENT_LINE,
+    KIND_COUNT
+} line_kind;
+
+char* kind_names[KIND_COUNT] = {"instruction", "data", "string", "define", "macro", "extern", "entry", "error", "comment"};
+
+int weights[KIND_COUNT] = {70, 8, 3, 2, 4, 2, 2, 0, 9};
+
+/* the addressing modes (the same numbers as arg_type in arguments.h) */
+#define IMMEDIATE 0
+#define DIRECT 1
+#define INDEX 2
+#define REGISTER 3
+
+/* the operations and the addressing modes they allow (a bit for every mode, 0 when there is no such operand) */
+struct operation {
+    char* name;
+    int origin;
+    int destination;
+} operations[] = {
+    {"mov", 15, 14},
+    {"cmp", 15, 15},
+    {"add", 15, 14},
+    {"sub", 15, 14},
+    {"not", 0, 14},
+    {"clr", 0, 14},
+    {"lea", 6, 14},
+    {"inc", 0, 14},
+    {"dec", 0, 14},
+    {"jmp", 0, 10},
+    {"bne", 0, 10},
+    {"red", 0, 14},
+    {"prn", 0, 15},
+    {"jst", 0, 10},
+    {"rts", 0, 0},
+    {"hlt", 0, 0}
+};
+
+#define OPERATION_COUNT 16
+
+/* lines the assembler rejects, %d is replaced with a number */
+char* error_lines[] = {
+    "\tfoo%d r1, r2",
+    "\tmov r%d",
+    "\tjmp #%d",
+    "\tlea #%d, r1",
+    "\tinc missing%d",
+    "\tprn #x%d",
+    "\tmov r1, #%d",
+    "\tadd r1, r2, r%d"
+};
+
+#define ERROR_LINE_COUNT 8
+
+
+/* the state of the generator, the names are numbered so that only the counts have to be kept */
+typedef struct generator {
+    unsigned long seed;
+    FILE* out;
+    long lines; /* the lines written so far */
+    long code_labels; /* L0, L1, ... */
+    long data_labels; /* D0, D1, ... (.data) */
+    long string_labels; /* S0, S1, ... */
+    long defines; /* k0, k1, ... */
+    long externs; /* X0, X1, ... */
+    long macros; /* m0, m1, ... */
+} generator;
+
+
+/* returns the next random number (xorshift, so the files are the same on every platform) */
+unsigned long next_random(generator* g) {
+    unsigned long x = g->seed;
+    x ^= (x << 13) & 0xffffffffUL;
+    x ^= x >> 17;
+    x ^= (x << 5) & 0xffffffffUL;
+    g->seed = x;
+    return x;
+}
+
+/* returns a random number from 0 to n-1 */
+long random_below(generator* g, long n) {
+    return n <= 0 ? 0 : (long)(next_random(g) % (unsigned long)n);
+}
+
+/* returns whether a random event with the given percent happens */
+int chance(generator* g, int percent) {
+    return random_below(g, 100) < percent;
+}
+
+
+/* writes an operand of the mode into operand, returns FALSE if there is nothing to refer to yet */
+int write_operand(generator* g, int mode, char* operand) {
+    switch (mode) {
+        case IMMEDIATE:
+            if (g->defines > 0 && chance(g, 25))
+                sprintf(operand, "#k%ld", random_below(g, g->defines));
+            else
+                sprintf(operand, "#%ld", random_below(g, 2001) - 1000);
+            return TRUE;
+        case DIRECT: {
+            long total = g->code_labels + g->data_labels + g->string_labels + g->externs;
+            long n = random_below(g, total);
+
+            if (total == 0)
+                return FALSE;
+            if (n < g->code_labels)
+                sprintf(operand, "L%ld", n);
+            else if ((n -= g->code_labels) < g->data_labels)
+                sprintf(operand, "D%ld", n);
+            else if ((n -= g->data_labels) < g->string_labels)
+                sprintf(operand, "S%ld", n);
+            else
+                sprintf(operand, "X%ld", n - g->string_labels);
+            return TRUE;
+        }
+        case INDEX:
+            if (g->data_labels == 0)
+                return FALSE;
+            if (g->defines > 0 && chance(g, 30))
+                sprintf(operand, "D%ld[k%ld]", random_below(g, g->data_labels), random_below(g, g->defines));
+            else
+                sprintf(operand, "D%ld[%ld]", random_below(g, g->data_labels), random_below(g, 8));
+            return TRUE;
+        default:
+            sprintf(operand, "r%ld", random_below(g, 8));
+            return TRUE;
+    }
+}
+
+/* picks a random mode out of the allowed ones that has something to refer to and writes the operand */
+int random_operand(generator* g, int allowed, char* operand) {
+    int tries;
+
+    for (tries = 0; tries < 8; tries++) {
+        int mode = random_below(g, 4);
+        if ((allowed & (1 << mode)) && write_operand(g, mode, operand))
+            return TRUE;
+    }
+    if (allowed & (1 << REGISTER))
+        return write_operand(g, REGISTER, operand);
+    return FALSE;
+}
+
+/* writes an instruction without a label into line */
+void instruction(generator* g, char* line) {
+    struct operation* op = &operations[random_below(g, OPERATION_COUNT)];
+    char origin[48];
+    char destination[48];
+
+    if (op->destination == 0)
+        sprintf(line, "%s", op->name);
+    else if (op->origin == 0) {
+        if (!random_operand(g, op->destination, destination))
+            strcpy(line, "hlt");
+        else
+            sprintf(line, "%s %s", op->name, destination);
+    }
+    else if (!random_operand(g, op->origin, origin) || !random_operand(g, op->destination, destination))
+        strcpy(line, "rts"); /* lea before there are any labels */
+    else
+        sprintf(line, "%s %s, %s", op->name, origin, destination);
+}
+
+void put_line(generator* g, char* line) {
+    fputs(line, g->out);
+    fputc('\n', g->out);
+    g->lines++;
+}
+
+
+/* writes a line (or a few for a macro) of the kind, never more than left lines */
+void write_kind(generator* g, line_kind kind, long left) {
+    char line[128];
+    char body[96];
+    int i;
+    int count;
+
+    switch (kind) {
+        case INSTRUCTION_LINE:
+            instruction(g, body);
+            if (chance(g, 20))
+                sprintf(line, "L%ld:\t%s", g->code_labels++, body);
+            else
+                sprintf(line, "\t%s", body);
+            break;
+        case DATA_LINE:
+            sprintf(line, "D%ld: .data %ld", g->data_labels++, random_below(g, 1001) - 500);
+            count = random_below(g, 8);
+            for (i = 0; i < count; i++) {
+                if (g->defines > 0 && chance(g, 20))
+                    sprintf(body, ", k%ld", random_below(g, g->defines));
+                else
+                    sprintf(body, ", %ld", random_below(g, 1001) - 500);
+                strcat(line, body);
+            }
+            break;
+        case STRING_LINE:
+            count = 1 + random_below(g, 30);
+            for (i = 0; i < count; i++)
+                body[i] = "abcdefghijklmnopqrstuvwxyz ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789"[random_below(g, 63)];
+            body[count] = '\0';
+            sprintf(line, "S%ld: .string \"%s\"", g->string_labels++, body);
+            break;
+        case DEFINE_LINE:
+            sprintf(line, ".define k%ld = %ld", g->defines++, random_below(g, 8));
+            break;
+        case MACRO_LINE:
+            if (g->macros > 0 && (left < 3 || chance(g, 70))) { /* use an old macro */
+                sprintf(line, "\tm%ld", random_below(g, g->macros));
+                break;
+            }
+            if (left < 3) { /* no room for a macro */
+                write_kind(g, INSTRUCTION_LINE, left);
+                return;
+            }
+            sprintf(line, "\tmcr m%ld", g->macros);
+            put_line(g, line);
+            count = 1 + random_below(g, left - 2 < 4 ? left - 2 : 4);
+            for (i = 0; i < count; i++) { /* no labels in the body, it could be used more than once */
+                instruction(g, body);
+                sprintf(line, "\t%s", body);
+                put_line(g, line);
+            }
+            g->macros++;
+            strcpy(line, "\tendmcr");
+            break;
+        case EXTERN_LINE:
+            sprintf(line, ".extern X%ld", g->externs++);
+            break;
+        case ENTRY_LINE:
+            if (g->code_labels + g->data_labels == 0)
+                strcpy(line, "; no labels to enter yet");
+            else if (g->code_labels > 0 && (g->data_labels == 0 || chance(g, 50)))
+                sprintf(line, ".entry L%ld", random_below(g, g->code_labels));
+            else
+                sprintf(line, ".entry D%ld", random_below(g, g->data_labels));
+            break;
+        case ERROR_LINE:
+            sprintf(line, error_lines[random_below(g, ERROR_LINE_COUNT)], (int)random_below(g, 100));
+            break;
+        default:
+            if (chance(g, 50))
+                line[0] = '\0';
+            else
+                sprintf(line, "; line %ld", g->lines + 1);
+            break;
+    }
+    put_line(g, line);
+}
+
+
+/* reads the --mix option, a list of kind:weight, the kinds that aren't given keep their weights */
+int read_mix(char* mix) {
+    while (*mix) {
+        int kind;
+        int length;
+        char* colon = strchr(mix, ':');
+
+        if (colon == NULL)
+            return FALSE;
+        length = colon - mix;
+        for (kind = 0; kind < KIND_COUNT; kind++)
+            if ((int)strlen(kind_names[kind]) == length && strncmp(mix, kind_names[kind], length) == 0)
+                break;
+        if (kind == KIND_COUNT) {
+            printf("error: unknown kind of line %.*s\n", length, mix);
+            return FALSE;
+        }
+        weights[kind] = atoi(colon + 1);
+        mix = strchr(colon, ',');
+        if (mix == NULL)
+            break;
+        mix++;
+    }
+    return TRUE;
+}
+
+int main(int argc, char* argv[]) {
+    generator g;
+    long lines;
+    int total_weight;
+    int i;
+
+    g.seed = 1;
+    for (i = 1; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+        if (strncmp(argv[i], "--seed=", 7) == 0)
+            g.seed = strtoul(argv[i] + 7, NULL, 10);
+        else if (strncmp(argv[i], "--mix=", 6) == 0) {
+            if (!read_mix(argv[i] + 6))
+                return 1;
+        }
+        else {
+            printf("error: unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (argc - i != 2 || (lines = atol(argv[i])) <= 0) {
+        printf("usage: corpus [--seed=N] [--mix=kind:weight,...] <lines> <file.as>\n");
+        return 1;
+    }
+
+    g.seed = (g.seed * 2654435761UL + 12345) & 0xffffffffUL; /* xorshift can't start at 0 */
+    if (g.seed == 0)
+        g.seed = 1;
+
+    total_weight = 0;
+    for (i = 0; i < KIND_COUNT; i++)
+        total_weight += weights[i] > 0 ? weights[i] : 0;
+    if (total_weight == 0) {
+        printf("error: all of the weights are 0\n");
+        return 1;
+    }
+
+    g.out = fopen(argv[argc-1], "w");
+    if (g.out == NULL) {
+        perror(argv[argc-1]);
+        return 1;
+    }
+    g.lines = 0;
+    g.code_labels = 0;
+    g.data_labels = 0;
+    g.string_labels = 0;
+    g.defines = 0;
+    g.externs = 0;
+    g.macros = 0;
+
+    while (g.lines < lines) {
+        long n = random_below(&g, total_weight);
+        int kind;
+
+        for (kind = 0; kind < KIND_COUNT - 1; kind++) {
+            if (weights[kind] > 0 && n < weights[kind])
+                break;
+            if (weights[kind] > 0)
+                n -= weights[kind];
+        }
+        write_kind(&g, (line_kind)kind, lines - g.lines);
+    }
+
+    if (fclose(g.out) != 0) {
+        perror(argv[argc-1]);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,101 @@
+#define _GNU_SOURCE /* for syscall */
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <linux/perf_event.h>
+#include "counters.h"
+
+
+int counters_enabled = 0;
+
+char* counter_names[COUNTER_COUNT] = {"cycles", "instructions", "cache_misses", "branch_misses", "page_faults", "context_switches"};
+
+/* the perf events of the counters (in the order of counter_kind) */
+struct counter_event {
+    unsigned int type;
+    unsigned long config;
+} counter_events[COUNTER_COUNT] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES}
+};
+
+int counter_fds[COUNTER_COUNT]; /* -1 for a counter that couldn't be opened */
+int use_rusage = 0; /* no counter could be opened, the software counters come from getrusage */
+
+
+/* opens a counter of this thread, returns its file descriptor or -1 */
+int open_counter(counter_kind counter) {
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = counter_events[counter].type;
+    attr.config = counter_events[counter].config;
+    attr.exclude_hv = 1;
+    if (attr.type == PERF_TYPE_HARDWARE)
+        attr.exclude_kernel = 1; /* what unprivileged users are usually allowed to count */
+
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/* opens every counter it can, they count the calling thread from now on */
+void start_counters() {
+    int opened;
+    int i;
+
+    opened = 0;
+    for (i=0; i<COUNTER_COUNT; i++) {
+        counter_fds[i] = open_counter((counter_kind)i);
+        if (counter_fds[i] >= 0)
+            opened++;
+    }
+    use_rusage = (opened == 0);
+    counters_enabled = 1;
+}
+
+/* returns whether the counter has values (from perf_event_open or from getrusage) */
+int counter_available(counter_kind counter) {
+    if (use_rusage)
+        return counter == COUNTER_PAGE_FAULTS || counter == COUNTER_CONTEXT_SWITCHES;
+    return counter_fds[counter] >= 0;
+}
+
+/* returns whether the counters come from getrusage */
+int counters_from_rusage() {
+    return use_rusage;
+}
+
+/* puts the current value of every counter in values (0 for the ones that aren't available) */
+void read_counters(double values[COUNTER_COUNT]) {
+    int i;
+
+    for (i=0; i<COUNTER_COUNT; i++) {
+        __u64 value = 0;
+        if (!use_rusage && counter_fds[i] >= 0 && read(counter_fds[i], &value, sizeof(value)) != sizeof(value))
+            value = 0;
+        values[i] = (double)value;
+    }
+
+    if (use_rusage) {
+        struct rusage usage;
+        getrusage(RUSAGE_SELF, &usage);
+        values[COUNTER_PAGE_FAULTS] = usage.ru_minflt + usage.ru_majflt;
+        values[COUNTER_CONTEXT_SWITCHES] = usage.ru_nvcsw + usage.ru_nivcsw;
+    }
+}
+
+void stop_counters() {
+    int i;
+
+    for (i=0; i<COUNTER_COUNT; i++)
+        if (!use_rusage && counter_fds[i] >= 0)
+            close(counter_fds[i]);
+    counters_enabled = 0;
+}
@@ -0,0 +1,29 @@
+/* the hardware and software counters of every phase (all --counters).
+ * they are read through perf_event_open whenever the phase changes (see stats.c). the counters that can't be opened
+ * (hardware counters are often missing in virtual machines and containers) are left out of the report,
+ * and when perf_event_open can't be used at all the page faults and context switches come from getrusage */
+
+typedef enum {
+    COUNTER_CYCLES,
+    COUNTER_INSTRUCTIONS,
+    COUNTER_CACHE_MISSES,
+    COUNTER_BRANCH_MISSES,
+    COUNTER_PAGE_FAULTS,
+    COUNTER_CONTEXT_SWITCHES,
+    COUNTER_COUNT
+} counter_kind;
+
+extern int counters_enabled;
+
+extern char* counter_names[COUNTER_COUNT];
+
+
+void start_counters();
+
+void read_counters(double values[COUNTER_COUNT]);
+
+int counter_available(counter_kind counter);
+
+int counters_from_rusage();
+
+void stop_counters();
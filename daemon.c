@@ -0,0 +1,711 @@
+#define _GNU_SOURCE /* for memfd_create */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "sentences.h"
+#include "utils.h"
+#include "asm.h"
+#include "daemon.h"
+#include "alloc.h"
+
+#define ALLOC_SUBSYSTEM ALLOC_DRIVER
+
+
+/* the size of the memory chunks of a request arena */
+#define ARENA_CHUNK_SIZE 65536
+
+/* how many accepted connections can wait for a worker */
+#define QUEUE_SIZE 256
+
+
+/* memory for everything a single request allocates, it is all released at once when the response was sent */
+typedef struct arena_chunk {
+    struct arena_chunk* next;
+    unsigned long size;
+    unsigned long used;
+    double data[1]; /* the memory itself (double for the alignment) */
+} arena_chunk;
+
+typedef struct arena {
+    arena_chunk* chunks; /* the chunk that is being filled is first */
+} arena;
+
+/* accepted connections waiting for a worker */
+typedef struct connection_queue {
+    int fds[QUEUE_SIZE];
+    int first;
+    int count;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+    pthread_cond_t not_full;
+} connection_queue;
+
+/* the state of one worker thread, nothing in it is shared with the other workers */
+typedef struct worker {
+    pthread_t thread;
+    connection_queue* queue;
+    arena request_arena;
+    asm_context* context;
+    char* buffer; /* inline sources and the messages of the response (reused) */
+    long buffer_size;
+} worker;
+
+char* section_names[5] = {"messages", "am", "ob", "ent", "ext"};
+
+
+/* allocates from the arena given as data (an asm_allocator function) */
+void* arena_allocate(unsigned long size, void* data) {
+    arena* a = (arena*)data;
+    arena_chunk* chunk;
+    void* pointer;
+
+    size = (size + sizeof(double) - 1) / sizeof(double) * sizeof(double);
+
+    chunk = a->chunks;
+    if (chunk == NULL || chunk->used + size > chunk->size) {
+        unsigned long chunk_size = size > ARENA_CHUNK_SIZE ? size : ARENA_CHUNK_SIZE;
+        chunk = (arena_chunk*)MALLOC(sizeof(arena_chunk) + chunk_size);
+        if (chunk == NULL)
+            return NULL;
+        chunk->size = chunk_size;
+        chunk->used = 0;
+        chunk->next = a->chunks;
+        a->chunks = chunk;
+    }
+
+    pointer = (char*)chunk->data + chunk->used;
+    chunk->used += size;
+    return pointer;
+}
+
+/* single allocations aren't released, reset_arena releases everything together */
+void arena_release(void* pointer, void* data) {
+}
+
+/* releases everything that was allocated from the arena.
+ * if the last request needed more than one chunk, they are replaced by a single chunk that is big enough for all of them,
+ * so a stream of similar requests allocates nothing after the first one */
+void reset_arena(arena* a) {
+    arena_chunk* chunk;
+    unsigned long total;
+
+    if (a->chunks == NULL)
+        return;
+
+    if (a->chunks->next == NULL) {
+        a->chunks->used = 0;
+        return;
+    }
+
+    total = 0;
+    while (a->chunks != NULL) {
+        chunk = a->chunks;
+        a->chunks = chunk->next;
+        total += chunk->size;
+        FREE(chunk);
+    }
+
+    chunk = (arena_chunk*)MALLOC(sizeof(arena_chunk) + total);
+    if (chunk == NULL)
+        return;
+    chunk->size = total;
+    chunk->used = 0;
+    chunk->next = NULL;
+    a->chunks = chunk;
+}
+
+void free_arena(arena* a) {
+    while (a->chunks != NULL) {
+        arena_chunk* chunk = a->chunks;
+        a->chunks = chunk->next;
+        FREE(chunk);
+    }
+}
+
+
+/* sends all of the given bytes, returns FALSE if the connection is broken */
+int send_all(int fd, char* data, long length) {
+    while (length > 0) {
+        ssize_t count = send(fd, data, length, 0);
+        if (count <= 0)
+            return FALSE;
+        data += count;
+        length -= count;
+    }
+    return TRUE;
+}
+
+/* receives exactly length bytes, returns FALSE if the connection ended first */
+int receive_all(int fd, char* data, long length) {
+    while (length > 0) {
+        ssize_t count = recv(fd, data, length, 0);
+        if (count <= 0)
+            return FALSE;
+        data += count;
+        length -= count;
+    }
+    return TRUE;
+}
+
+/* sends a "<name> <length>" header, the descriptor attached_fd is passed along with it when it isn't -1 */
+int send_header(int fd, char* name, long length, int attached_fd) {
+    char header[FRAME_HEADER_SIZE];
+    char text[FRAME_HEADER_SIZE + 32];
+    struct msghdr message;
+    struct iovec part;
+    union {
+        struct cmsghdr align;
+        char space[CMSG_SPACE(sizeof(int))];
+    } control;
+
+    /* the name and the length padded with spaces */
+    memset(header, ' ', FRAME_HEADER_SIZE);
+    memcpy(header, text, sprintf(text, "%.15s %ld", name, length));
+    header[FRAME_HEADER_SIZE - 1] = '\n';
+
+    if (attached_fd == -1)
+        return send_all(fd, header, FRAME_HEADER_SIZE);
+
+    memset(&message, 0, sizeof(message));
+    part.iov_base = header;
+    part.iov_len = FRAME_HEADER_SIZE;
+    message.msg_iov = &part;
+    message.msg_iovlen = 1;
+    message.msg_control = control.space;
+    message.msg_controllen = sizeof(control.space);
+    CMSG_FIRSTHDR(&message)->cmsg_level = SOL_SOCKET;
+    CMSG_FIRSTHDR(&message)->cmsg_type = SCM_RIGHTS;
+    CMSG_FIRSTHDR(&message)->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(CMSG_FIRSTHDR(&message)), &attached_fd, sizeof(int));
+
+    if (sendmsg(fd, &message, 0) != FRAME_HEADER_SIZE)
+        return FALSE;
+    return TRUE;
+}
+
+/* receives a header into name (at least FRAME_HEADER_SIZE chars) and length.
+ * *attached_fd is set to a descriptor that was passed with the header or -1.
+ * returns FALSE when the connection ended */
+int receive_header(int fd, char* name, long* length, int* attached_fd) {
+    char header[FRAME_HEADER_SIZE + 1];
+    struct msghdr message;
+    struct iovec part;
+    struct cmsghdr* control_header;
+    ssize_t count;
+    union {
+        struct cmsghdr align;
+        char space[CMSG_SPACE(sizeof(int))];
+    } control;
+
+    memset(&message, 0, sizeof(message));
+    part.iov_base = header;
+    part.iov_len = FRAME_HEADER_SIZE;
+    message.msg_iov = &part;
+    message.msg_iovlen = 1;
+    message.msg_control = control.space;
+    message.msg_controllen = sizeof(control.space);
+
+    count = recvmsg(fd, &message, 0);
+    if (count <= 0)
+        return FALSE;
+
+    *attached_fd = -1;
+    control_header = CMSG_FIRSTHDR(&message);
+    if (control_header != NULL && control_header->cmsg_level == SOL_SOCKET && control_header->cmsg_type == SCM_RIGHTS)
+        memcpy(attached_fd, CMSG_DATA(control_header), sizeof(int));
+
+    /* the rest of the header if it was split */
+    if (!receive_all(fd, header + count, FRAME_HEADER_SIZE - count))
+        return FALSE;
+    header[FRAME_HEADER_SIZE] = '\0';
+
+    *length = 0;
+    return sscanf(header, "%31s %ld", name, length) >= 1;
+}
+
+/* sends a section of the response */
+int send_section(int fd, char* name, char* text, long length) {
+    if (text == NULL)
+        length = 0;
+    return send_header(fd, name, length, -1) && send_all(fd, text, length);
+}
+
+
+/* makes sure the worker's buffer can hold size bytes, returns FALSE if there isn't enough memory.
+ * the worker only drops its connection then, the server and the other connections go on */
+int reserve_buffer(worker* w, long size) {
+    if (size > w->buffer_size) {
+        char* bigger = (char*)REALLOC(w->buffer, size);
+        if (bigger == NULL)
+            return FALSE;
+        w->buffer = bigger;
+        w->buffer_size = size;
+    }
+    return TRUE;
+}
+
+/* assembles the given source and sends the response, returns FALSE if the connection should be dropped */
+int respond(worker* w, int fd, char* source, long length) {
+    asm_result result;
+    int status;
+    long messages_length;
+    int i;
+    int sent;
+
+    asm_compile_buffer(w->context, source, length, &result);
+
+    status = result.succeeded ? 2 : (result.am != NULL ? 1 : 0);
+
+    /* the messages in the format the command line prints them, without the filename the client puts in front of every line */
+    messages_length = 0;
+    sent = TRUE;
+    for (i=0; i<result.message_count && sent; i++) {
+        asm_message* m = &result.messages[i];
+        sent = reserve_buffer(w, messages_length + strlen(m->message) + 64);
+        if (sent)
+            messages_length += sprintf(w->buffer + messages_length, "%d:%d: %s: %s [%s]\n",
+                                       m->line, m->column, m->severity, m->message, m->code);
+    }
+
+    sent = sent && send_header(fd, "result", status, -1) &&
+           send_section(fd, "messages", w->buffer, messages_length) &&
+           send_section(fd, "am", result.am, result.am_length) &&
+           send_section(fd, "ob", result.ob, result.ob_length) &&
+           send_section(fd, "ent", result.ent, result.ent != NULL ? strlen(result.ent) : 0) &&
+           send_section(fd, "ext", result.ext, result.ext != NULL ? strlen(result.ext) : 0);
+
+    asm_free_result(w->context, &result); /* nothing to do with an arena, kept for other allocators */
+    reset_arena(&w->request_arena);
+
+    return sent;
+}
+
+/* reads a source passed as a descriptor, returns FALSE if the server doesn't take it.
+ * only regular files (and memfds) up to MAX_SOURCE_LENGTH are taken, a pipe could block the worker forever.
+ * the client can still change the file while it's being assembled, so it is copied, unless it is a memfd sealed
+ * against changing its size and writing. only such a memfd is mapped, a mapping of a file that shrinks raises SIGBUS */
+int read_passed_fd(int fd, source_file* file) {
+    struct stat info;
+#ifdef F_GET_SEALS
+    int seals;
+#endif
+    long length;
+
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size > MAX_SOURCE_LENGTH)
+        return FALSE;
+
+#ifdef F_GET_SEALS
+    seals = fcntl(fd, F_GET_SEALS);
+    if (seals != -1 && (seals & F_SEAL_SHRINK) && (seals & F_SEAL_GROW) && (seals & F_SEAL_WRITE)) {
+        lseek(fd, 0, SEEK_SET); /* read_fd reads from the offset when it doesn't map the file */
+        return read_fd(fd, file);
+    }
+#endif
+
+    file->text = (char*)MALLOC(info.st_size + 1);
+    if (file->text == NULL)
+        return FALSE;
+    for (length = 0; length < info.st_size; ) { /* a file that shrank meanwhile is only shorter */
+        ssize_t count = pread(fd, file->text + length, info.st_size - length, length);
+        if (count < 0) {
+            FREE(file->text);
+            return FALSE;
+        }
+        if (count == 0)
+            break;
+        length += count;
+    }
+    file->text[length] = '\0';
+    file->length = length;
+    file->is_mapped = FALSE;
+    return TRUE;
+}
+
+/* answers the requests of a connection until it is closed */
+void handle_connection(worker* w, int fd) {
+    char name[FRAME_HEADER_SIZE];
+    long length;
+    int source_fd;
+
+    while (receive_header(fd, name, &length, &source_fd)) {
+        int sent;
+
+        if (strcmp(name, "fd") == 0 && source_fd != -1) { /* the source is in a file or a memfd */
+            source_file file;
+
+            if (!read_passed_fd(source_fd, &file)) {
+                close(source_fd);
+                break;
+            }
+            sent = respond(w, fd, file.text, file.length);
+            close_file(&file);
+            close(source_fd);
+        }
+        else if (strcmp(name, "source") == 0 && length >= 0 && length <= MAX_SOURCE_LENGTH) { /* the source was sent inline */
+            if (source_fd != -1)
+                close(source_fd);
+            if (!reserve_buffer(w, length + 1) || !receive_all(fd, w->buffer, length))
+                break;
+            /* asm_compile_buffer copies the source before the buffer is reused for the response */
+            sent = respond(w, fd, w->buffer, length);
+        }
+        else { /* unknown request, or a source longer than MAX_SOURCE_LENGTH */
+            if (source_fd != -1)
+                close(source_fd);
+            break;
+        }
+
+        if (!sent)
+            break;
+    }
+
+    close(fd);
+}
+
+/* the main function of every worker thread */
+void* worker_main(void* data) {
+    worker* w = (worker*)data;
+    connection_queue* queue = w->queue;
+
+    while (1) {
+        int fd;
+
+        pthread_mutex_lock(&queue->lock);
+        while (queue->count == 0)
+            pthread_cond_wait(&queue->not_empty, &queue->lock);
+        fd = queue->fds[queue->first];
+        queue->first = (queue->first + 1) % QUEUE_SIZE;
+        queue->count--;
+        pthread_cond_signal(&queue->not_full);
+        pthread_mutex_unlock(&queue->lock);
+
+        handle_connection(w, fd);
+    }
+
+    return NULL;
+}
+
+/* runs the assembler server on a unix socket at socket_path with the given amount of worker threads, returns only on error */
+int serve(char* socket_path, int workers) {
+    int server_fd;
+    struct sockaddr_un address;
+    connection_queue queue;
+    worker* pool;
+    int i;
+
+    if (workers < 1)
+        workers = DEFAULT_WORKERS;
+
+    signal(SIGPIPE, SIG_IGN); /* a client that disconnects only ends its own connection */
+
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        printf("error: socket path is too long\n");
+        return 1;
+    }
+
+    server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server_fd < 0) {
+        perror("socket");
+        return 1;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socket_path);
+    unlink(socket_path); /* a socket left by a previous server */
+
+    if (bind(server_fd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(server_fd, 64) != 0) {
+        perror(socket_path);
+        close(server_fd);
+        return 1;
+    }
+
+    queue.first = 0;
+    queue.count = 0;
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.not_empty, NULL);
+    pthread_cond_init(&queue.not_full, NULL);
+
+    pool = (worker*)MALLOC(workers * sizeof(worker));
+    if (pool == NULL) {
+        printf("Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (i=0; i<workers; i++) {
+        asm_allocator allocator;
+
+        pool[i].queue = &queue;
+        pool[i].request_arena.chunks = NULL;
+        pool[i].buffer = NULL;
+        pool[i].buffer_size = 0;
+
+        allocator.allocate = arena_allocate;
+        allocator.release = arena_release;
+        allocator.data = &pool[i].request_arena;
+        pool[i].context = asm_create_context(&allocator);
+
+        if (pool[i].context == NULL || pthread_create(&pool[i].thread, NULL, worker_main, &pool[i]) != 0) {
+            printf("error: couldn't start worker %d\n", i);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    printf("serving on %s with %d workers\n", socket_path, workers);
+    fflush(stdout);
+
+    while (1) {
+        int fd = accept(server_fd, NULL, NULL);
+        if (fd < 0)
+            continue;
+
+        pthread_mutex_lock(&queue.lock);
+        while (queue.count == QUEUE_SIZE)
+            pthread_cond_wait(&queue.not_full, &queue.lock);
+        queue.fds[(queue.first + queue.count) % QUEUE_SIZE] = fd;
+        queue.count++;
+        pthread_cond_signal(&queue.not_empty);
+        pthread_mutex_unlock(&queue.lock);
+    }
+
+    return 0;
+}
+
+
+/* connects to the server, returns the socket or -1 */
+int connect_to_server(char* socket_path) {
+    int fd;
+    struct sockaddr_un address;
+
+    if (strlen(socket_path) >= sizeof(address.sun_path))
+        return -1;
+
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socket_path);
+
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* frees the sections of a response */
+void free_response(response* r) {
+    int i;
+    for (i=0; i<5; i++) {
+        FREE(r->sections[i]);
+        r->sections[i] = NULL;
+    }
+}
+
+/* receives the response to a request, returns FALSE if the connection broke */
+int receive_response(int fd, response* r) {
+    char name[FRAME_HEADER_SIZE];
+    long length;
+    int attached_fd;
+    int i;
+
+    for (i=0; i<5; i++)
+        r->sections[i] = NULL;
+
+    if (!receive_header(fd, name, &length, &attached_fd) || strcmp(name, "result") != 0)
+        return FALSE;
+    r->status = (int)length;
+
+    for (i=0; i<5; i++) {
+        if (!receive_header(fd, name, &length, &attached_fd) || strcmp(name, section_names[i]) != 0 || length < 0) {
+            free_response(r);
+            return FALSE;
+        }
+        r->lengths[i] = length;
+        if (length == 0)
+            continue;
+
+        r->sections[i] = (char*)MALLOC(length + 1);
+        if (r->sections[i] == NULL || !receive_all(fd, r->sections[i], length)) {
+            free_response(r);
+            return FALSE;
+        }
+        r->sections[i][length] = '\0';
+    }
+
+    return TRUE;
+}
+
+/* writes a section of the response to the file base_name.extension */
+void write_section_file(char* base_name, char* extension, char* text) {
+    char filename[110];
+    sprintf(filename, "%.100s.%s", base_name, extension);
+    write_file(filename, text);
+}
+
+/* compiles the given files on the server, it behaves like running the assembler on them directly.
+ * returns 1 if the server couldn't be reached */
+int run_client(char* socket_path, int filec, char* filenames[]) {
+    int server;
+    int i;
+
+    server = connect_to_server(socket_path);
+    if (server < 0) {
+        printf("error: no assembler server at %s\n", socket_path);
+        return 1;
+    }
+
+    for (i=0; i<filec; i++) {
+        char as_filename[110];
+        int source_fd;
+        response r;
+
+        printf("\ncompiling %s.as\n", filenames[i]);
+
+        sprintf(as_filename, "%.100s.as", filenames[i]);
+        source_fd = open(as_filename, O_RDONLY);
+        if (source_fd < 0) {
+            printf("%s.as not found\n\n", filenames[i]);
+            continue;
+        }
+
+        /* the server reads the file itself, only the descriptor is sent */
+        if (!send_header(server, "fd", 0, source_fd) || !receive_response(server, &r)) {
+            printf("error: the connection to the server was lost\n");
+            close(source_fd);
+            close(server);
+            return 1;
+        }
+        close(source_fd);
+
+        if (r.sections[0] != NULL) { /* the messages, every one of them is about the file */
+            char* message = r.sections[0];
+            while (*message != '\0') {
+                int length = strcspn(message, "\n");
+                printf("%s.as:%.*s\n", filenames[i], length, message);
+                message += length + (message[length] == '\n');
+            }
+        }
+
+        if (r.status == 0)
+            printf("an error in the preprocessor prevented creation of .am file\n\n");
+        else {
+            write_section_file(filenames[i], "am", r.sections[1] != NULL ? r.sections[1] : "");
+
+            if (r.status == 2) {
+                if (r.sections[3] != NULL)
+                    write_section_file(filenames[i], "ent", r.sections[3]);
+                if (r.sections[4] != NULL)
+                    write_section_file(filenames[i], "ext", r.sections[4]);
+                write_section_file(filenames[i], "ob", r.sections[2]);
+                printf("compilation succeeded!\n\n");
+            }
+            else
+                printf("compilation failed\n\n");
+        }
+
+        free_response(&r);
+    }
+
+    close(server);
+    return 0;
+}
+
+
+int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a;
+    double y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+/* sends the same source requests times, either inline or as a memfd (source_fd), and prints the latency percentiles */
+int benchmark_requests(int server, char* mode, source_file* source, int source_fd, int requests) {
+    double* latencies;
+    double total;
+    int i;
+
+    latencies = (double*)MALLOC(requests * sizeof(double));
+    if (latencies == NULL) {
+        printf("Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+
+    total = 0;
+    for (i=0; i<requests; i++) {
+        response r;
+        double start;
+        int sent;
+
+        start = now_in_microseconds();
+        if (source_fd != -1)
+            sent = send_header(server, "fd", 0, source_fd);
+        else
+            sent = send_header(server, "source", source->length, -1) && send_all(server, source->text, source->length);
+
+        if (!sent || !receive_response(server, &r)) {
+            printf("error: the connection to the server was lost\n");
+            FREE(latencies);
+            return FALSE;
+        }
+        latencies[i] = now_in_microseconds() - start;
+        total += latencies[i];
+        free_response(&r);
+    }
+
+    qsort(latencies, requests, sizeof(double), compare_doubles);
+    printf("%-6s %d requests: mean %.1f us, p50 %.1f us, p99 %.1f us, max %.1f us\n", mode, requests,
+           total / requests, latencies[requests / 2], latencies[(int)(requests * 0.99)], latencies[requests - 1]);
+
+    FREE(latencies);
+    return TRUE;
+}
+
+/* measures the latency of compiling the given .as file on the server, requests times with each way of sending the source */
+int run_client_benchmark(char* socket_path, char* filename, int requests) {
+    int server;
+    source_file source;
+    int succeeded;
+
+    if (requests < 1)
+        requests = 1000;
+
+    if (!read_file(filename, &source)) {
+        printf("%s not found\n", filename);
+        return 1;
+    }
+
+    server = connect_to_server(socket_path);
+    if (server < 0) {
+        printf("error: no assembler server at %s\n", socket_path);
+        close_file(&source);
+        return 1;
+    }
+
+    succeeded = benchmark_requests(server, "inline", &source, -1, requests);
+
+#ifdef MFD_ALLOW_SEALING
+    if (succeeded) { /* the source in a memfd, the way a build tool that generates it in memory would send it */
+        int memory_fd = memfd_create("asm-source", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (memory_fd >= 0 && write(memory_fd, source.text, source.length) == source.length &&
+            fcntl(memory_fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE) == 0) /* so the server maps it */
+            succeeded = benchmark_requests(server, "memfd", &source, memory_fd, requests);
+        if (memory_fd >= 0)
+            close(memory_fd);
+    }
+#endif
+
+    close(server);
+    close_file(&source);
+    return succeeded ? 0 : 1;
+}
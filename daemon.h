@@ -0,0 +1,42 @@
+/* the assembler server (all --serve) and its client.
+ *
+ * every message on the socket starts with a header of FRAME_HEADER_SIZE bytes: "<name> <length>" padded with spaces and ending with \n.
+ * a request is either
+ *   "source <length>" followed by length bytes of source, or
+ *   "fd 0" with a descriptor of the source (a regular file or a memfd) attached to it. the file is copied, only a memfd
+ *   sealed with F_SEAL_SHRINK, F_SEAL_GROW and F_SEAL_WRITE is mapped without a copy.
+ * the response is "result <status>" (0 - the preprocessor failed, 1 - the assembly failed, 2 - it succeeded)
+ * followed by the sections "messages", "am", "ob", "ent" and "ext" in that order (length 0 when missing).
+ * a connection can send any number of requests, each one is answered before the next one is read */
+
+#define FRAME_HEADER_SIZE 32
+
+/* the longest source the server accepts (inline or in a file), the connection of a longer one is closed */
+#define MAX_SOURCE_LENGTH (16L * 1024 * 1024)
+
+/* how many compilations run at the same time when the amount of workers isn't given */
+#define DEFAULT_WORKERS 4
+
+/* a response read by the client */
+typedef struct response {
+    int status;
+    char* sections[5]; /* messages, am, ob, ent, ext (null terminated, NULL when empty) */
+    long lengths[5];
+} response;
+
+int serve(char* socket_path, int workers);
+
+/* the client's side of the socket, also used by server_test.c */
+int connect_to_server(char* socket_path);
+
+int send_header(int fd, char* name, long length, int attached_fd);
+
+int send_all(int fd, char* data, long length);
+
+int receive_response(int fd, response* r);
+
+void free_response(response* r);
+
+int run_client(char* socket_path, int filec, char* filenames[]);
+
+int run_client_benchmark(char* socket_path, char* filename, int requests);
@@ -2,21 +2,168 @@
 #include <stdlib.h>
 #include <string.h>
 #include "sentences.h"
+#include "errors.h"
 #include "utils.h"
 #include "arguments.h"
 #include "data_nodes.h"
+#include "trace.h"
+#include "counters.h"
+#include "stats.h"
 #include "first_pass.h"
+#include "alloc.h"
+
+#define ALLOC_SUBSYSTEM ALLOC_DATA_NODES
+
+
+/* --- the lists of names ---
+ * the lists are searched from their first node, short lists are just walked.
+ * a long list has a hash index in its first node with every name once (the first node of that name in the list),
+ * so finding a name gives the same node as walking the list would */
+
+unsigned long name_hash(char* name) {
+    unsigned long hash = 5381;
+    while (*name != '\0')
+        hash = hash * 33 + (unsigned char)*name++;
+    return hash;
+}
+
+/* returns the place of the name in the index (an empty place if it isn't there) */
+list_node** index_place(name_index* index, char* name) {
+    unsigned long i = name_hash(name) & (index->size - 1);
+    while (index->nodes[i] != NULL && strcmp(index->nodes[i]->name, name) != 0)
+        i = (i + 1) & (index->size - 1);
+    return &index->nodes[i];
+}
+
+/* adds the node to the index, it replaces a node of the same name only when it comes before it in the list */
+void add_to_index(name_index* index, list_node* node, int comes_first) {
+    list_node** place;
+
+    if ((index->count + 1) * 2 > index->size) { /* keep the index at most half full */
+        list_node** old_nodes = index->nodes;
+        unsigned long old_size = index->size;
+        unsigned long i;
+
+        index->size *= 2;
+        index->nodes = (list_node**)CALLOC(index->size, sizeof(list_node*));
+        if (index->nodes == NULL) {
+            printf("Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        for (i=0; i<old_size; i++)
+            if (old_nodes[i] != NULL)
+                *index_place(index, old_nodes[i]->name) = old_nodes[i];
+        FREE(old_nodes);
+    }
+
+    place = index_place(index, node->name);
+    if (*place == NULL)
+        index->count++;
+    if (*place == NULL || comes_first)
+        *place = node;
+}
+
+/* creates the index of the list */
+name_index* index_list(list_node* head) {
+    name_index* index = (name_index*)MALLOC(sizeof(name_index));
+
+    if (index == NULL) {
+        printf("Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    index->size = 4 * INDEXED_LIST_LENGTH;
+    index->count = 0;
+    index->nodes = (list_node**)CALLOC(index->size, sizeof(list_node*));
+    if (index->nodes == NULL) {
+        printf("Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    for (; head != NULL; head = head->next) {
+        add_to_index(index, head, FALSE);
+        index->last = head;
+    }
+    return index;
+}
+
+/* returns the first node of the list with the name (NULL if there isn't one) */
+list_node* find_node(list_node* head, char* name) {
+    if (head != NULL && head->index != NULL)
+        return *index_place(head->index, name);
+
+    while (head != NULL && strcmp(head->name, name) != 0)
+        head = head->next;
+    return head;
+}
+
+/* adds the node to the end of the list */
+void append_node(list_node** head, list_node* node) {
+    list_node* last;
+    int length;
+
+    node->index = NULL;
+    node->next = NULL;
+    if (*head == NULL) {
+        *head = node;
+        return;
+    }
+
+    if ((*head)->index != NULL) {
+        (*head)->index->last->next = node;
+        (*head)->index->last = node;
+        add_to_index((*head)->index, node, FALSE);
+        return;
+    }
+
+    length = 1;
+    for (last = *head; last->next != NULL; last = last->next)
+        length++;
+    last->next = node;
+    if (length + 1 >= INDEXED_LIST_LENGTH)
+        (*head)->index = index_list(*head);
+}
+
+/* adds the node to the start of the list (the index moves to it) */
+void prepend_node(list_node** head, list_node* node) {
+    node->index = NULL;
+    node->next = *head;
+
+    if (*head != NULL && (*head)->index != NULL) {
+        node->index = (*head)->index;
+        (*head)->index = NULL;
+        add_to_index(node->index, node, TRUE);
+    }
+    else {
+        list_node* current;
+        int length = 1;
+
+        for (current = *head; current != NULL && length < INDEXED_LIST_LENGTH; current = current->next)
+            length++;
+        if (length >= INDEXED_LIST_LENGTH)
+            node->index = index_list(node);
+    }
+    *head = node;
+}
+
+/* frees the index of the list (the nodes are freed by their lists) */
+void free_node_index(list_node* head) {
+    if (head != NULL && head->index != NULL) {
+        FREE(head->index->nodes);
+        FREE(head->index);
+        head->index = NULL;
+    }
+}
+
 
 /* Function to create a new label_node */
 label_node* create_label_node(char* name, int line, operation_type type) {
-    label_node* new_node = (label_node*)malloc(sizeof(label_node)); /* allocate memory for the new node */
+    label_node* new_node = (label_node*)MALLOC(sizeof(label_node)); /* allocate memory for the new node */
     
     if (new_node == NULL) {
         printf("Memory allocation failed\n");
         exit(EXIT_FAILURE);
     }
     
-    new_node->name = strdup(name); /* dupe the name into new node (allocates new memory for it) */
+    new_node->name = STRDUP(name); /* dupe the name into new node (allocates new memory for it) */
     
     if (new_node->name == NULL) {
         printf("Memory allocation failed\n");
@@ -26,6 +173,7 @@ label_node* create_label_node(char* name, int line, operation_type type) {
     /* assign the appropriate values to the new node */
     new_node->line = line;
     new_node->type = type;
+    new_node->index = NULL;
     new_node->next = NULL;
     
     return new_node;
@@ -33,60 +181,46 @@ label_node* create_label_node(char* name, int line, operation_type type) {
 
 /* function to get the label_node by it's name (NULL if it doesn't exist) */
 label_node* get_label(label_node* head, char* name) {
-    label_node *current = head;
-    
-    while (current != NULL) { /* go through the list */
-        if (strcmp(current->name, name) == 0) /* if the name is found, return the current node */
-            return current;
-        
-        current = (label_node*)current->next;
-    }
-    return NULL; /* Label not found */
+    STATS_COUNT(symbol_lookups);
+    return (label_node*)find_node((list_node*)head, name);
 }
 
 /* Function to add a label to the linked list */
 void add_label(label_node **head, char *name, int line, operation_type type) {
     /* Create a new label node */
     label_node *new_node = create_label_node(name, line, type);
+    STATS_COUNT(symbols);
 
-    /* Add the new label to the end of the list */
-    if (*head == NULL) 
-        *head = new_node;
-
-    else {
-        label_node *current = *head;
-        while (current->next != NULL) /* go to the end of the list */
-            current = (label_node*)current->next;
-        
-        current->next = (struct label_node*)new_node; /* add the new node to the end of the list */
-    }
+    append_node((list_node**)head, (list_node*)new_node); /* Add the new label to the end of the list */
 }
 
 /* Function to free memory allocated for the linked list */
 void free_labels(label_node* head) {
     label_node* current = head;
+    free_node_index((list_node*)head);
     
     while (current != NULL) { /* go through each node in the list */
         label_node* temp = current;
         current = (label_node*)current->next;
         
         /* free the contents of the node */
-        free(temp->name);
-        free(temp);
+        FREE(temp->name);
+        FREE(temp);
     }
 }
 
 
 /* function to create a new extern_node */
 extern_node* create_extern_node(char* name) {
-    extern_node* new_node = (extern_node*)malloc(sizeof(extern_node)); /* allocate memory for the new node */
+    extern_node* new_node = (extern_node*)MALLOC(sizeof(extern_node)); /* allocate memory for the new node */
     
     if (new_node == NULL) {
         printf("Memory allocation failed\n");
         exit(EXIT_FAILURE);
     }
     /* assign the values to the new node */
-    new_node->name = strdup(name);
+    new_node->name = STRDUP(name);
+    new_node->index = NULL;
     new_node->next = NULL;
     
     return new_node; /* return the new node */
@@ -94,14 +228,15 @@ extern_node* create_extern_node(char* name) {
 
 /* function to create a new entry_node */
 entry_node* create_entry_node(char* name) {
-    entry_node* new_node = (entry_node*)malloc(sizeof(entry_node)); /* allocate memory for the new node */
+    entry_node* new_node = (entry_node*)MALLOC(sizeof(entry_node)); /* allocate memory for the new node */
     
     if (new_node == NULL) {
         printf("Memory allocation failed\n");
         exit(EXIT_FAILURE);
     }
     /* assign the values to the new node */
-    new_node->name = strdup(name);
+    new_node->name = STRDUP(name);
+    new_node->index = NULL;
     new_node->next = NULL;
     
     return new_node; /* return the new node */
@@ -109,82 +244,56 @@ entry_node* create_entry_node(char* name) {
 
 /* function to get the extern_node with the given name */
 extern_node* get_extern(extern_node* head, char* name) {
-    const extern_node* current = head;
-    
-    while (current != NULL) { /* go through every node in the list */
-        if (strcmp(current->name, name) == 0) /* if the name is found, return the node */
-            return (extern_node*)current;
-        current = current->next;
-    }
-    return NULL; /* Node with given name not found */
+    STATS_COUNT(symbol_lookups);
+    return (extern_node*)find_node((list_node*)head, name);
 }
 
 /* function to get the entry_node with the given name */
 entry_node* get_entry(entry_node* head, char* name) {
-    const entry_node* current = head;
-    
-    while (current != NULL) { /* go through every node in the list */
-        if (strcmp(current->name, name) == 0) /* if the name is found, return the node */
-            return (entry_node*)current;
-        
-        current = current->next;
-    }
-    return NULL; /* Node with given name not found */
+    STATS_COUNT(symbol_lookups);
+    return (entry_node*)find_node((list_node*)head, name);
 }
 
 /* function to add a new extern_node to the end of the given list */
 void add_extern(extern_node** head, char* name) {
     extern_node* new_node = create_extern_node(name); /* create new node */
+    STATS_COUNT(symbols);
     
-    if (*head == NULL) 
-        *head = new_node;
-    
-    else {
-        extern_node* last = *head;
-        while (last->next != NULL) {
-            last = last->next;
-        }
-        last->next = new_node;
-    }
+    append_node((list_node**)head, (list_node*)new_node);
 }
 
 
 /* function to add a new entry_node to the end of the given list */
 void add_entry(entry_node** head, char* name) {
     entry_node* new_node = create_entry_node(name); /* create new node */
+    STATS_COUNT(symbols);
     
-    if (*head == NULL) {
-        *head = new_node;
-    } else {
-        entry_node* last = *head;
-        while (last->next != NULL) {
-            last = last->next;
-        }
-        last->next = new_node;
-    }
+    append_node((list_node**)head, (list_node*)new_node);
 }
 
 /* function to free all of the allocated memory for an extern_node linked list */
 void free_externs(extern_node* head) {
+    free_node_index((list_node*)head);
     while (head != NULL) { /* go through every node in the list */
         extern_node* temp = head;
         head = head->next;
         
         /* free the name and the node */
-        free(temp->name);
-        free(temp);
+        FREE(temp->name);
+        FREE(temp);
     }
 }
 
 /* function to free all of the allocated memory for an entry_node linked list */
 void free_entrys(entry_node* head) {
+    free_node_index((list_node*)head);
     while (head != NULL) { /* go through every node in the list */
         entry_node* temp = head;
         head = head->next;
         
         /* free the name and the node */
-        free(temp->name);
-        free(temp);
+        FREE(temp->name);
+        FREE(temp);
     }
 }
 
@@ -192,12 +301,13 @@ void free_entrys(entry_node* head) {
 /* Function to create a new define_node */
 define_node* create_define_node(char* name, int value) {
     /* Allocate memory for new node */
-    define_node* new_node = (define_node*)malloc(sizeof(define_node));
+    define_node* new_node = (define_node*)MALLOC(sizeof(define_node));
     
     if (new_node != NULL) {
         /* Copy name and assign value */
-        new_node->name = strdup(name);
+        new_node->name = STRDUP(name);
         new_node->value = value;
+        new_node->index = NULL;
         new_node->next = NULL;
     }
     return new_node; /* return the new node */
@@ -205,40 +315,75 @@ define_node* create_define_node(char* name, int value) {
 
 /* Function to get a define_node with the given name */
 define_node* get_define(define_node* head, char* name) {
-    /* go through the list */
-    define_node* current = head;
-    while (current != NULL) {
-        /* compare names */
-        if (strcmp(current->name, name) == 0) 
-            return current; /* Return if found */
-        
-        current = current->next;
-    }
-    return NULL; /* Not found */
+    STATS_COUNT(symbol_lookups);
+    return (define_node*)find_node((list_node*)head, name);
 }
 
 /* function to add a new define_node to the list */
 void add_define(define_node** head, char* name, int value) {
     /* create a new node */
     define_node* new_node = create_define_node(name, value);
-    if (new_node != NULL) {
-        /* add to the beginning of the list */
-        new_node->next = *head;
-        *head = new_node;
-    }
+    STATS_COUNT(symbols);
+    if (new_node != NULL)
+        prepend_node((list_node**)head, (list_node*)new_node); /* add to the beginning of the list */
 }
 
 /* fnction to free the memory allocated for the list */
 void free_defines(define_node* head) {
     define_node* current = head;
+    free_node_index((list_node*)head);
     
     while (current != NULL) { /* go through each node in the list */
         define_node* next = current->next;
         
         /* free the allocated memory for the name and the node */
-        free(current->name);
-        free(current);
+        FREE(current->name);
+        FREE(current);
         
         current = next;
     }
 }
+
+
+/* function to get the first symbol_node with the given name */
+symbol_node* get_symbol_node(symbol_node* head, char* name) {
+    return (symbol_node*)find_node((list_node*)head, name);
+}
+
+/* function to add a new symbol_node to the end of the list (a name can be in it more than once) */
+void add_symbol_node(symbol_node** head, char* name, int address) {
+    symbol_node* new_node = (symbol_node*)MALLOC(sizeof(symbol_node));
+    
+    if (new_node == NULL) {
+        printf("Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    new_node->name = STRDUP(name);
+    if (new_node->name == NULL) {
+        printf("Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    new_node->address = address;
+    
+    append_node((list_node**)head, (list_node*)new_node);
+}
+
+/* returns the number of nodes in the list */
+int count_symbol_nodes(symbol_node* head) {
+    int count = 0;
+    for (; head != NULL; head = head->next)
+        count++;
+    return count;
+}
+
+/* function to free the memory allocated for the list */
+void free_symbol_nodes(symbol_node* head) {
+    free_node_index((list_node*)head);
+    while (head != NULL) {
+        symbol_node* temp = head;
+        head = head->next;
+        
+        FREE(temp->name);
+        FREE(temp);
+    }
+}
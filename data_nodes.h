@@ -1,35 +1,87 @@
 typedef enum {INSTRUCTION, DATA, STRING, EXTERN, ENTRY} operation_type;
 
 typedef struct second_pass_result {
-    char* machine_code;
     char* ent_file;
     char* ext_file;
+    int IC;
+    int DC;
+    int* words; /* only when collect_symbols is set (see pass_options), NULL otherwise */
+    struct symbol_node* entries;
+    struct symbol_node* externals;
 } second_pass_result;
 
+/* how the second pass encodes a source, every compile passes its own (NULL for all of them FALSE) */
+typedef struct pass_options {
+    /* the words are encoded by the reference engine (to_words, the binary strings that were always used) instead of
+     * encode_sentence (all --engine=reference). both have to give the same .ob file (see differential.c) */
+    int reference_engine;
+    /* the words, the entries and every word that refers to an external are also collected in the result
+     * (all --object, the binary object needs them) */
+    int collect_symbols;
+} pass_options;
+
+/* every kind of node starts like this, so that the lists can share the code that finds and adds names.
+ * once a list is long its first node has a hash index of the names (see data_nodes.c) */
+typedef struct list_node {
+    char* name;
+    struct name_index* index;
+    struct list_node* next;
+} list_node;
+
+/* a list gets its index when it has this many nodes */
+#define INDEXED_LIST_LENGTH 8
+
+typedef struct name_index {
+    list_node** nodes; /* by the hash of their names */
+    unsigned long size; /* a power of 2 */
+    unsigned long count;
+    list_node* last; /* the last node of the list */
+} name_index;
+
 typedef struct {
     char* name;
+    struct name_index* index;
+    struct label_node *next;
     int line;
     operation_type type;
-    struct label_node *next;
 } label_node;
 
 typedef struct extern_node {
     char* name;
+    struct name_index* index;
     struct extern_node* next;
 } extern_node;
 
 typedef struct entry_node {
     char* name;
+    struct name_index* index;
     struct entry_node* next;
 } entry_node;
 
 typedef struct define_node {
     char* name;
-    int value;
+    struct name_index* index;
     struct define_node* next;
+    int value;
 } define_node;
 
+/* an entry and its address, or an external and the address of a word that refers to it (for the binary object) */
+typedef struct symbol_node {
+    char* name;
+    struct name_index* index;
+    struct symbol_node* next;
+    int address;
+} symbol_node;
+
+
+
+list_node* find_node(list_node* head, char* name);
+
+void append_node(list_node** head, list_node* node);
+
+void prepend_node(list_node** head, list_node* node);
 
+void free_node_index(list_node* head);
 
 label_node* create_label_node(char* name, int line, operation_type type);
 
@@ -70,3 +122,11 @@ void add_define(define_node** head, char* name, int value);
 void free_defines(define_node* head);
 
 void print_defines(define_node* head);
+
+symbol_node* get_symbol_node(symbol_node* head, char* name);
+
+void add_symbol_node(symbol_node** head, char* name, int address);
+
+int count_symbol_nodes(symbol_node* head);
+
+void free_symbol_nodes(symbol_node* head);
@@ -0,0 +1,190 @@
+/* the differential check of the two engines (make differential):
+ *
+ *     differential [--seeds=N] [--lines=N] [files.as]
+ *
+ * every given file, the sources in known_sources and N generated ones (see corpus.c, every other one has error lines)
+ * are assembled in memory by the fast engine and by the reference engine (see pass_options in data_nodes.h).
+ * their .am, .ob, .ent and .ext texts and their messages must be the same, the first line that isn't is printed.
+ * returns 1 if the engines gave different outputs */
+
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sentences.h"
+#include "errors.h"
+#include "utils.h"
+#include "arguments.h"
+#include "data_nodes.h"
+#include "preprocessor.h"
+#include "assembler.h"
+#include "ob_file.h"
+#include "second_pass.h"
+#include "alloc.h"
+
+#define ALLOC_SUBSYSTEM ALLOC_DRIVER
+
+
+#define DEFAULT_SEEDS 20
+#define DEFAULT_LINES 2000
+
+/* where the generated files go */
+#define DIFFERENTIAL_DIR "differential_corpus"
+
+/* the outputs that are compared, in this order */
+#define OUTPUT_COUNT 5
+
+char* output_names[OUTPUT_COUNT] = {".am", ".ob", ".ent", ".ext", "messages"};
+
+/* sources that the engines didn't agree on once */
+#define KNOWN_SOURCES 4
+
+char* known_sources[KNOWN_SOURCES] = {
+    ".extern EXT\nMAIN: mov EXT, NOPE\n    hlt\n", /* an unknown label after an external one */
+    ".extern EXT\nMAIN: mov EXT, ARR[k]\nARR: .data 1, 2\n    hlt\n", /* an unknown index after an external */
+    ".extern EXT\n.extern EXT2\nMAIN: mov EXT, EXT2\n    hlt\n", /* two externals, the .ext text has the first one */
+    "MAIN: mov r1, r2\n.entry\n    hlt\n"
+};
+
+
+/* assembles the text in memory with one of the engines, every output is NULL if it wasn't created */
+void assemble_with(char* filename, char* text, int reference, char* outputs[OUTPUT_COUNT]) {
+    diagnostics diag;
+    second_pass_result* result;
+    pass_options options;
+
+    memset(&options, 0, sizeof(pass_options));
+    options.reference_engine = reference;
+    memset(outputs, 0, OUTPUT_COUNT * sizeof(char*));
+    start_diagnostics(&diag, filename, 0);
+
+    outputs[0] = create_am_file(text, &diag);
+    if (outputs[0] != NULL) {
+        result = assemble(text, outputs[0], NULL, &outputs[1], NULL, &options, &diag);
+        if (result != NULL) {
+            outputs[2] = result->ent_file;
+            outputs[3] = result->ext_file;
+            FREE(result);
+        } /* otherwise assemble threw the .ob file away */
+    }
+    outputs[4] = diagnostics_text(&diag);
+    free_diagnostics(&diag);
+}
+
+/* prints the first line where the texts are different, returns whether they are the same */
+int same_text(char* filename, char* output, char* fast, char* reference) {
+    int line;
+
+    if (fast == NULL || reference == NULL) {
+        if (fast == reference)
+            return TRUE;
+        printf("%s: only the %s engine created the %s output\n", filename, fast != NULL ? "fast" : "reference", output);
+        return FALSE;
+    }
+
+    for (line = 1; ; line++) {
+        char* fast_end = strchr(fast, '\n');
+        char* reference_end = strchr(reference, '\n');
+        int fast_length = (fast_end != NULL) ? fast_end - fast : (int)strlen(fast);
+        int reference_length = (reference_end != NULL) ? reference_end - reference : (int)strlen(reference);
+
+        if (fast_length != reference_length || strncmp(fast, reference, fast_length) != 0 ||
+            (fast_end == NULL) != (reference_end == NULL)) {
+            printf("%s: the %s output is different at line %d\n  fast:      %.*s\n  reference: %.*s\n",
+                   filename, output, line, fast_length, fast, reference_length, reference);
+            return FALSE;
+        }
+        if (fast_end == NULL)
+            return TRUE;
+        fast = fast_end + 1;
+        reference = reference_end + 1;
+    }
+}
+
+/* assembles the text with both engines and compares the outputs, returns whether they are the same */
+int compare_texts(char* filename, char* text) {
+    char* fast[OUTPUT_COUNT];
+    char* reference[OUTPUT_COUNT];
+    int same;
+    int i;
+
+    assemble_with(filename, text, FALSE, fast);
+    assemble_with(filename, text, TRUE, reference);
+
+    same = TRUE;
+    for (i=0; i<OUTPUT_COUNT; i++) {
+        if (same)
+            same = same_text(filename, output_names[i], fast[i], reference[i]);
+        FREE(fast[i]);
+        FREE(reference[i]);
+    }
+    return same;
+}
+
+/* assembles the file with both engines and compares the outputs, returns whether they are the same */
+int compare_engines(char* filename) {
+    source_file source;
+    int same;
+
+    if (!read_file(filename, &source)) {
+        printf("error: can't read %s\n", filename);
+        return FALSE;
+    }
+    same = compare_texts(filename, source.text);
+    close_file(&source);
+    return same;
+}
+
+int main(int argc, char* argv[]) {
+    long lines;
+    int seeds;
+    int failed;
+    int checked;
+    int i;
+
+    seeds = DEFAULT_SEEDS;
+    lines = DEFAULT_LINES;
+    for (i = 1; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+        if (strncmp(argv[i], "--seeds=", 8) == 0 && atoi(argv[i] + 8) >= 0)
+            seeds = atoi(argv[i] + 8);
+        else if (strncmp(argv[i], "--lines=", 8) == 0 && atol(argv[i] + 8) > 0)
+            lines = atol(argv[i] + 8);
+        else {
+            printf("error: unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    failed = 0;
+    checked = 0;
+    for (; i < argc; i++, checked++)
+        if (!compare_engines(argv[i]))
+            failed++;
+
+    for (i = 0; i < KNOWN_SOURCES; i++, checked++) {
+        char filename[32];
+
+        sprintf(filename, "known%d.as", i + 1);
+        if (!compare_texts(filename, known_sources[i]))
+            failed++;
+    }
+
+    for (i = 1; i <= seeds; i++, checked++) {
+        char filename[128];
+        char command[256];
+
+        sprintf(filename, "%s/seed%d.as", DIFFERENTIAL_DIR, i);
+        sprintf(command, "./corpus --seed=%d%s %ld %s", i, (i % 2 == 0) ? " --mix=error:3" : "", lines, filename);
+        if (system(command) != 0) {
+            printf("error: can't generate %s (was corpus built?)\n", filename);
+            return 1;
+        }
+        if (!compare_engines(filename))
+            failed++;
+        else
+            remove(filename);
+    }
+
+    printf("%d of %d files are the same with both engines\n", checked - failed, checked);
+    return failed > 0;
+}
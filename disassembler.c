@@ -0,0 +1,544 @@
+/* the disassembler (make disassembler), it turns .ob files (or binary objects) back into instructions and data:
+ *
+ *     disassembler [--source | --check] <files.ob | files.obj>
+ *
+ * the words are decoded with ob_decoder.c and the instructions with the tables the assembler encodes them with
+ * (opcode_list, addressing_mode and register_list in second_pass.c, valid_argc in errors.c).
+ * the first IC words are the code and the rest are the data, like the addresses of the labels say (a .ob file of a
+ * source that has data before code has them mixed, its .obj doesn't). the names come from <name>.ent and <name>.ext
+ * when they are there (a .ext line only names the first external of its instruction), or from the tables of the .obj,
+ * and every other address that is used gets a label of its own (L and the address).
+ *
+ * the listing has the address, the symbols and the instruction of every word. --source prints assembly that assembles
+ * back to the same words (when every external has a name), and --check only decodes and checks every word and
+ * prints how fast it went. returns 1 if a file can't be read or has words that aren't valid */
+
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sentences.h"
+#include "errors.h"
+#include "utils.h"
+#include "arguments.h"
+#include "data_nodes.h"
+#include "ob_file.h"
+#include "second_pass.h"
+#include "object_file.h"
+#include "ob_decoder.h"
+#include "alloc.h"
+
+#define ALLOC_SUBSYSTEM ALLOC_DRIVER
+
+
+typedef enum {LISTING, SOURCE, CHECK} output_mode;
+
+/* the tables of the encoding by the values of the fields (filled from the tables of the assembler) */
+char* opcode_name[16];
+int operand_count[16];
+arg_type mode_type[4];
+char* register_name[8];
+
+/* an instruction decoded from its first word */
+typedef struct instruction {
+    int opcode;
+    int argc;
+    arg_type types[2];
+    int operand_words[2]; /* the index of the first word of every operand */
+    int length;
+    int valid;
+} instruction;
+
+/* a decoded program and its names */
+typedef struct program {
+    int IC;
+    int DC;
+    int first_address;
+    int* words;
+    char** labels; /* the name of every address (NULL if it has none) */
+    char** externals; /* the external every word refers to (NULL if it isn't known) */
+    char* starts; /* whether a line starts at every word (an instruction, a data word or a word that isn't valid) */
+    symbol_node* names; /* the nodes every name belongs to */
+    int invalid; /* how many words aren't valid */
+} program;
+
+
+/* fills the tables of the encoding from the tables the assembler encodes with */
+void build_tables() {
+    int i;
+    int j;
+
+    for (i=0; i<16; i++) {
+        int opcode = (int)strtol(opcode_list[i].opcode, NULL, 2);
+        opcode_name[opcode] = opcode_list[i].name;
+        for (j=0; j<19; j++)
+            if (strcmp(valid_argc[j].name, opcode_list[i].name) == 0)
+                operand_count[opcode] = valid_argc[j].argc;
+    }
+    for (i=0; i<4; i++)
+        mode_type[strtol(addressing_mode[i].num, NULL, 2)] = addressing_mode[i].type;
+    for (i=0; i<8; i++)
+        register_name[strtol(register_list[i].str, NULL, 2)] = register_list[i].name;
+}
+
+/* the signed 12 bit number above the A,R,E bits of the word */
+int word_number(int word) {
+    word >>= 2;
+    return word >= 2048 ? word - 4096 : word;
+}
+
+/* the signed 14 bit value of a data word */
+int data_number(int word) {
+    return word >= 8192 ? word - 16384 : word;
+}
+
+/* returns whether the operand word has the A,R,E bits its addressing mode must have */
+int valid_operand_word(int word, arg_type type) {
+    if (type == VARIABLE || type == ARRAY_AND_INDEX)
+        return word == EXTERNAL_ARE || (word & 3) == RELOCATABLE_ARE;
+    return (word & 3) == ABSOLUTE_ARE;
+}
+
+/* decodes the instruction at words[i] (the code ends at IC) */
+void decode_instruction(program* p, int i, instruction* in) {
+    int word = p->words[i];
+    int modes[2];
+    int k;
+
+    in->opcode = (word >> 6) & 15;
+    in->argc = operand_count[in->opcode];
+    in->length = 1;
+    in->valid = (word >> 10) == 0 && (word & 3) == ABSOLUTE_ARE;
+
+    modes[0] = (in->argc == 2) ? (word >> 4) & 3 : (word >> 2) & 3;
+    modes[1] = (word >> 2) & 3;
+    if (in->argc < 2 && ((word >> 4) & 3) != 0)
+        in->valid = FALSE; /* no origin operand */
+    if (in->argc == 0 && ((word >> 2) & 3) != 0)
+        in->valid = FALSE;
+
+    for (k=0; k<in->argc; k++)
+        in->types[k] = mode_type[modes[k]];
+
+    if (in->argc == 2 && in->types[0] == REGISTER && in->types[1] == REGISTER) {
+        in->operand_words[0] = in->operand_words[1] = i + 1; /* they share a word */
+        in->length = 2;
+    }
+    else
+        for (k=0; k<in->argc; k++) {
+            in->operand_words[k] = i + in->length;
+            in->length += (in->types[k] == ARRAY_AND_INDEX) ? 2 : 1;
+        }
+
+    if (i + in->length > p->IC) {
+        in->valid = FALSE;
+        return;
+    }
+    for (k=0; k<in->argc && in->valid; k++) {
+        int operand = in->operand_words[k];
+        in->valid = valid_operand_word(p->words[operand], in->types[k]);
+        if (in->types[k] == ARRAY_AND_INDEX)
+            in->valid = in->valid && (p->words[operand + 1] & 3) == ABSOLUTE_ARE;
+    }
+}
+
+/* returns the index of the line an address of an operand refers to, or -1 if there is no such line.
+ * a word only has 12 bits for the address, so in a program that goes above that the address is the first of
+ * address, address + 4096, ... that starts a line */
+int address_index(program* p, int address) {
+    int i;
+
+    for (i = address - p->first_address; i < p->IC + p->DC; i += 4096)
+        if (i >= 0 && p->starts[i])
+            return i;
+    return -1;
+}
+
+/* gives the address a label of its own if it is in the program and has no name */
+void name_address(program* p, int address) {
+    int i = address_index(p, address);
+    char name[16];
+
+    if (i < 0 || p->labels[i] != NULL)
+        return;
+    address = p->first_address + i;
+    sprintf(name, "L%04d", address);
+    add_symbol_node(&p->names, name, address);
+    p->labels[i] = get_symbol_node(p->names, name)->name;
+}
+
+/* goes through the code: finds where the lines start, counts the invalid words, names the addresses that are used
+ * and, when ext_records isn't NULL, gives the first external of every instruction the name of its .ext line
+ * (which is at the address after the words of the first operand, see second_pass.c) */
+void analyze_code(program* p, char** ext_records) {
+    int i;
+
+    for (i = p->IC; i < p->IC + p->DC; i++)
+        p->starts[i] = TRUE;
+    i = 0;
+    while (i < p->IC) {
+        instruction in;
+
+        decode_instruction(p, i, &in);
+        p->starts[i] = TRUE;
+        if (!in.valid)
+            p->invalid++;
+        i += in.valid ? in.length : 1;
+    }
+
+    i = 0;
+    while (i < p->IC) {
+        instruction in;
+        int named;
+        int k;
+
+        decode_instruction(p, i, &in);
+        if (!in.valid) {
+            i++;
+            continue;
+        }
+
+        named = (ext_records == NULL);
+        for (k=0; k<in.argc; k++) {
+            int word = p->words[in.operand_words[k]];
+
+            if (in.types[k] != VARIABLE && in.types[k] != ARRAY_AND_INDEX)
+                continue;
+            if (word == EXTERNAL_ARE && !named) {
+                int record = i + (in.types[0] == ARRAY_AND_INDEX ? 2 : 1);
+                p->externals[in.operand_words[k]] = ext_records[record];
+                named = TRUE;
+            }
+            else if (word != EXTERNAL_ARE)
+                name_address(p, word >> 2);
+        }
+        i += in.length;
+    }
+}
+
+/* writes the text of operand k of the instruction into text */
+void operand_text(program* p, instruction* in, int k, char* text) {
+    int word = p->words[in->operand_words[k]];
+    char* name;
+
+    switch (in->types[k]) {
+        case NUMBER:
+            sprintf(text, "#%d", word_number(word));
+            return;
+        case REGISTER: /* the origin register is above the destination register */
+            sprintf(text, "%s", register_name[(k == 0 && in->argc == 2) ? (word >> 5) & 7 : (word >> 2) & 7]);
+            return;
+        default:
+            if (word == EXTERNAL_ARE)
+                name = p->externals[in->operand_words[k]] != NULL ? p->externals[in->operand_words[k]] : "?external";
+            else {
+                int i = address_index(p, word >> 2);
+                name = (i >= 0) ? p->labels[i] : "?address";
+            }
+            if (in->types[k] == ARRAY_AND_INDEX)
+                sprintf(text, "%.60s[%d]", name, word_number(p->words[in->operand_words[k] + 1]));
+            else
+                sprintf(text, "%.60s", name);
+    }
+}
+
+/* prints a line of the listing (or of the source), line is the text of the word (NULL for an operand word) */
+void print_line(program* p, output_mode mode, int i, char* line) {
+    char symbols[8];
+    char label[80];
+
+    label[0] = '\0';
+    if (line != NULL && p->labels[i] != NULL)
+        sprintf(label, "%.70s:", p->labels[i]);
+
+    if (mode == SOURCE) {
+        if (line != NULL)
+            printf("%s\t%s\n", label, line);
+        return;
+    }
+    encode_ob_symbols(p->words[i], symbols);
+    symbols[7] = '\0';
+    if (line == NULL)
+        printf("%04d %s\n", p->first_address + i, symbols);
+    else
+        printf("%04d %s  %-12s %s\n", p->first_address + i, symbols, label, line);
+}
+
+void print_program(program* p, output_mode mode) {
+    char line[256];
+    int i;
+
+    if (mode == SOURCE) { /* the entries and the externals the source needs */
+        symbol_node* declared = NULL;
+        symbol_node* node;
+
+        for (node = p->names; node != NULL; node = node->next)
+            if (node->address < 0)
+                printf(".entry %s\n", node->name);
+        for (i=0; i<p->IC; i++)
+            if (p->externals[i] != NULL && get_symbol_node(declared, p->externals[i]) == NULL) {
+                printf(".extern %s\n", p->externals[i]);
+                add_symbol_node(&declared, p->externals[i], 0);
+            }
+        free_symbol_nodes(declared);
+    }
+
+    i = 0;
+    while (i < p->IC) {
+        instruction in;
+        int k;
+
+        decode_instruction(p, i, &in);
+        if (!in.valid) {
+            sprintf(line, mode == SOURCE ? ".data %d" : ".data %d ; not an instruction", data_number(p->words[i]));
+            print_line(p, mode, i++, line);
+            continue;
+        }
+        strcpy(line, opcode_name[in.opcode]);
+        for (k=0; k<in.argc; k++) {
+            strcat(line, k == 0 ? " " : ", ");
+            operand_text(p, &in, k, line + strlen(line));
+        }
+        print_line(p, mode, i, line);
+        for (k=1; k<in.length; k++)
+            print_line(p, mode, i + k, NULL);
+        i += in.length;
+    }
+
+    for (; i < p->IC + p->DC; i++) {
+        int value = data_number(p->words[i]);
+        if (mode != SOURCE && value >= 32 && value < 127)
+            sprintf(line, ".data %d ; '%c'", value, value);
+        else
+            sprintf(line, ".data %d", value);
+        print_line(p, mode, i, line);
+    }
+}
+
+/* reads the "name address" lines of a .ent or .ext file into the list, returns FALSE if there is no such file */
+int read_symbols(char* filename, symbol_node** symbols) {
+    source_file file;
+    line_reader reader;
+    char* line;
+
+    if (!read_file(filename, &file))
+        return FALSE;
+    start_lines(&reader, file.text);
+    while ((line = next_line(&reader)) != NULL) {
+        char name[128];
+        int address;
+
+        if (sscanf(line, "%127s %d", name, &address) == 2)
+            add_symbol_node(symbols, name, address);
+    }
+    end_lines(&reader);
+    close_file(&file);
+    return TRUE;
+}
+
+/* allocates the name tables of the program */
+void start_program(program* p) {
+    p->labels = (char**)CALLOC(p->IC + p->DC + 1, sizeof(char*));
+    p->externals = (char**)CALLOC(p->IC + p->DC + 1, sizeof(char*));
+    p->starts = (char*)CALLOC(p->IC + p->DC + 1, 1);
+    if (p->labels == NULL || p->externals == NULL || p->starts == NULL) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    p->names = NULL;
+    p->invalid = 0;
+}
+
+/* names the entries (their nodes get a negative address so --source can find them) */
+void add_entry_label(program* p, char* name, int address) {
+    int i = address - p->first_address;
+    if (i < 0 || i >= p->IC + p->DC || p->labels[i] != NULL)
+        return;
+    add_symbol_node(&p->names, name, -1);
+    p->labels[i] = get_symbol_node(p->names, name)->name;
+}
+
+/* loads a .ob file and the .ent and .ext files next to it, returns FALSE if it can't be read */
+int load_ob(char* filename, program* p) {
+    source_file file;
+    decoded_ob ob;
+    char* other; /* the name of the .ent and of the .ext */
+    symbol_node* records;
+    symbol_node* node;
+    char** ext_records;
+    int i;
+
+    if (!read_file(filename, &file)) {
+        printf("error: can't read %s\n", filename);
+        return FALSE;
+    }
+    if (!decode_ob(file.text, file.length, &ob)) {
+        printf("error: %s:%ld: %s\n", filename, ob.error_line, ob.error);
+        close_file(&file);
+        return FALSE;
+    }
+    close_file(&file);
+    p->IC = ob.IC;
+    p->DC = ob.DC;
+    p->first_address = ob.first_address;
+    p->words = ob.words;
+    start_program(p);
+
+    other = (char*)MALLOC(strlen(filename) + 2); /* .ob -> .ent */
+    if (other == NULL) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    records = NULL;
+    sprintf(other, "%.*s.ent", (int)strlen(filename) - 3, filename);
+    read_symbols(other, &records);
+    for (node = records; node != NULL; node = node->next)
+        add_entry_label(p, node->name, node->address);
+    free_symbol_nodes(records);
+
+    records = NULL;
+    ext_records = NULL;
+    sprintf(other, "%.*s.ext", (int)strlen(filename) - 3, filename);
+    if (read_symbols(other, &records)) {
+        ext_records = (char**)CALLOC(p->IC + p->DC + 1, sizeof(char*));
+        if (ext_records == NULL) {
+            printf("Memory allocation failed\n");
+            exit(1);
+        }
+        for (node = records; node != NULL; node = node->next) {
+            i = node->address - p->first_address;
+            if (i >= 0 && i < p->IC)
+                ext_records[i] = node->name;
+        }
+    }
+    analyze_code(p, ext_records);
+
+    /* the names of the externals move to the names of the program */
+    for (i=0; i<p->IC; i++)
+        if (p->externals[i] != NULL) {
+            if (get_symbol_node(p->names, p->externals[i]) == NULL)
+                add_symbol_node(&p->names, p->externals[i], 0);
+            p->externals[i] = get_symbol_node(p->names, p->externals[i])->name;
+        }
+    FREE(ext_records);
+    FREE(other);
+    free_symbol_nodes(records);
+    return TRUE;
+}
+
+/* loads a binary object, returns FALSE if it can't be read */
+int load_obj(char* filename, program* p) {
+    object_file object;
+    unsigned int i;
+
+    if (!open_object(filename, &object)) {
+        printf("error: %s: %s\n", filename, object.error);
+        return FALSE;
+    }
+    p->IC = object.header->code_words;
+    p->DC = object.header->data_words;
+    p->first_address = object.header->base_address;
+    p->words = (int*)MALLOC((p->IC + p->DC + 1) * sizeof(int));
+    if (p->words == NULL) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    for (i=0; i<(unsigned int)(p->IC + p->DC); i++)
+        p->words[i] = object.words[i];
+    start_program(p);
+
+    for (i=0; i<object.header->entry_count; i++)
+        add_entry_label(p, object_symbol_name(&object, &object.entries[i]), object.entries[i].address);
+    for (i=0; i<object.header->relocation_count; i++) {
+        char* name = object_symbol_name(&object, &object.relocations[i]);
+        int word = object.relocations[i].address - p->first_address;
+
+        if (word < 0 || word >= p->IC)
+            continue;
+        if (get_symbol_node(p->names, name) == NULL)
+            add_symbol_node(&p->names, name, 0);
+        p->externals[word] = get_symbol_node(p->names, name)->name;
+    }
+    close_object(&object);
+
+    analyze_code(p, NULL);
+    return TRUE;
+}
+
+void free_program(program* p) {
+    FREE(p->labels);
+    FREE(p->externals);
+    FREE(p->starts);
+    free_symbol_nodes(p->names);
+    if (p->words != NULL)
+        free(p->words); /* decode_ob doesn't use the assembler's allocator */
+}
+
+double now_in_milliseconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+}
+
+int main(int argc, char* argv[]) {
+    output_mode mode;
+    int failed;
+    int i;
+
+    mode = LISTING;
+    for (i = 1; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+        if (strcmp(argv[i], "--source") == 0)
+            mode = SOURCE;
+        else if (strcmp(argv[i], "--check") == 0)
+            mode = CHECK;
+        else {
+            printf("error: unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (i == argc) {
+        printf("usage: disassembler [--source | --check] <files.ob | files.obj>\n");
+        return 1;
+    }
+
+    build_tables();
+    failed = 0;
+    for (; i < argc; i++) {
+        char* filename = argv[i];
+        int length = strlen(filename);
+        double start = now_in_milliseconds();
+        int loaded;
+        program p;
+
+        p.words = NULL;
+        if (length > 4 && strcmp(filename + length - 4, ".obj") == 0)
+            loaded = load_obj(filename, &p);
+        else if (length > 3 && strcmp(filename + length - 3, ".ob") == 0)
+            loaded = load_ob(filename, &p);
+        else {
+            printf("error: %s isn't a .ob or .obj file\n", filename);
+            loaded = FALSE;
+        }
+        if (!loaded) {
+            failed++;
+            continue;
+        }
+
+        if (mode == CHECK) {
+            double milliseconds = now_in_milliseconds() - start;
+            printf("%s: %d code words, %d data words, %d invalid, decoded in %.2f ms (%.0f words per second)\n",
+                   filename, p.IC, p.DC, p.invalid, milliseconds,
+                   (p.IC + p.DC) / (milliseconds > 0 ? milliseconds / 1000 : 1e-9));
+        }
+        else {
+            if (mode == LISTING)
+                printf("; %s: %d code words, %d data words\n", filename, p.IC, p.DC);
+            print_program(&p, mode);
+        }
+        if (p.invalid > 0)
+            failed++;
+        free_program(&p);
+    }
+    return failed > 0;
+}
@@ -0,0 +1,699 @@
+/* the emulator (make emulator), it runs assembled programs on the 14 bit machine they are assembled for:
+ *
+ *     emulator [--limit=N] [--profile] <image.ob | image.obj>
+ *     emulator --batch [--jobs=N] [--limit=N] [--profile] <images>
+ *
+ * the image is loaded at FIRST_ADDRESS and runs from there until hlt. the machine has 4096 words of memory (the
+ * addresses are 12 bits), 8 registers, the Z flag of the PSW (set by cmp, used by bne) and a stack for jst and rts.
+ * prn prints the signed value of its operand and red reads a character (-1 at the end of the input).
+ * a .ob file has the words in the order of the source, so a program that has data between its instructions only
+ * runs right from its .obj (all --object), which has the code first like the addresses of the labels.
+ *
+ * every instruction is decoded once into the code array (the operands become pointers to their register, memory word
+ * or constant) and the loop jumps straight from one handler to the next (a switch without gcc). writing to a word of
+ * the memory makes the instructions that might use it decode again, so programs that change their code still work.
+ * the run stops at hlt, after the limit of instructions, or at a word that can't run (that is an error).
+ *
+ * a single image uses the standard input and output and prints the instructions per second to stderr, with --profile
+ * also how many times every opcode ran and the addresses that ran the most.
+ * --batch runs the images in N threads, every one reads <name>.in (if it is there) and prints into <name>.out, and
+ * a line for every image and the total go to the standard output.
+ * returns 1 if an image can't be loaded, or doesn't stop at hlt */
+
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "sentences.h"
+#include "errors.h"
+#include "utils.h"
+#include "arguments.h"
+#include "data_nodes.h"
+#include "ob_file.h"
+#include "second_pass.h"
+#include "object_file.h"
+#include "ob_decoder.h"
+#include "alloc.h"
+
+#define ALLOC_SUBSYSTEM ALLOC_DRIVER
+
+
+#define MEMORY_SIZE 4096
+#define ADDRESS_MASK 0xFFF
+#define WORD_MASK 0x3FFF
+#define STACK_SIZE 1024
+#define MAX_INSTRUCTION_LENGTH 5 /* the first word and two operands with an index */
+#define DEFAULT_LIMIT 1000000000L
+#define MAX_JOBS 64
+#define HOTSPOTS 10
+
+/* the code jumps from handler to handler with gcc's labels as values (the switch is the same code without them) */
+#if defined(__GNUC__) && !defined(NO_THREADED_DISPATCH)
+#define THREADED_DISPATCH
+#endif
+
+/* what the decoded instruction does (the order of handlers in run) */
+typedef enum {
+    H_DECODE, H_INVALID, H_EXTERNAL, H_OUTSIDE,
+    H_MOV, H_CMP, H_ADD, H_SUB, H_NOT, H_CLR, H_LEA, H_INC, H_DEC, H_JMP, H_BNE, H_RED, H_PRN, H_JST, H_RTS, H_HLT
+} handler;
+
+/* the instructions of the handlers from H_MOV, by the name they have in opcode_list */
+char* instruction_names[] = {
+    "mov", "cmp", "add", "sub", "not", "clr", "lea", "inc", "dec", "jmp", "bne", "red", "prn", "jst", "rts", "hlt"
+};
+
+#define INVALID_OPCODE 16 /* the opcode of the words that aren't instructions in the counts */
+
+/* the tables of the encoding by the values of the fields (filled from the tables of the assembler) */
+char* opcode_name[INVALID_OPCODE + 1];
+int operand_count[16];
+handler opcode_handler[16];
+arg_type mode_type[4];
+
+typedef enum {RUNNING, HALTED, LIMIT, FAULT} run_status;
+
+/* an instruction decoded for the address it is at */
+typedef struct decoded {
+    int* source; /* the operands, a register, a word of the memory or one of the constants */
+    int* target;
+    int constants[2]; /* the immediates, and the addresses of the labels the instruction uses as values */
+    long count; /* how many times it ran since it was decoded */
+    unsigned char handler;
+    unsigned char opcode;
+    unsigned char length;
+    unsigned char watch; /* whether it writes to the memory (which might change the code) */
+} decoded;
+
+typedef struct machine {
+    int memory[MEMORY_SIZE];
+    int registers[8];
+    int zero; /* the Z flag */
+    int stack[STACK_SIZE];
+    int stack_size;
+    int pc;
+    decoded code[MEMORY_SIZE + MAX_INSTRUCTION_LENGTH]; /* the ones after the memory are for running past its end */
+    long limit;
+    run_status status;
+    char* error;
+    FILE* input;
+    FILE* output;
+    long executed;
+    long opcode_counts[INVALID_OPCODE + 1];
+    long address_counts[MEMORY_SIZE + MAX_INSTRUCTION_LENGTH];
+} machine;
+
+
+/* fills the tables of the encoding from the tables the assembler encodes with */
+void build_tables() {
+    int i;
+    int j;
+
+    for (i=0; i<16; i++) {
+        int opcode = (int)strtol(opcode_list[i].opcode, NULL, 2);
+        opcode_name[opcode] = opcode_list[i].name;
+        opcode_handler[opcode] = H_INVALID;
+        for (j=0; j<16; j++)
+            if (strcmp(instruction_names[j], opcode_list[i].name) == 0)
+                opcode_handler[opcode] = H_MOV + j;
+        for (j=0; j<19; j++)
+            if (strcmp(valid_argc[j].name, opcode_list[i].name) == 0)
+                operand_count[opcode] = valid_argc[j].argc;
+    }
+    opcode_name[INVALID_OPCODE] = "(invalid)";
+    for (i=0; i<4; i++)
+        mode_type[strtol(addressing_mode[i].num, NULL, 2)] = addressing_mode[i].type;
+}
+
+/* the signed 12 bit number above the A,R,E bits of the word */
+int word_number(int word) {
+    word >>= 2;
+    return word >= 2048 ? word - 4096 : word;
+}
+
+/* the signed value of a word */
+int signed_value(int value) {
+    return value >= 8192 ? value - 16384 : value;
+}
+
+/* decodes the word at the address as the first word of an instruction. the operands are resolved as far as they can
+ * be before running: a label (with its index) becomes the word it is at, or its address for lea and the jumps */
+void decode_at(machine* m, int address) {
+    decoded* d = &m->code[address];
+    int word = m->memory[address];
+    int* operands[2];
+    arg_type types[2];
+    int modes[2];
+    int shared;
+    int external;
+    int argc;
+    int opcode;
+    handler h;
+    int k;
+
+    d->handler = H_INVALID;
+    d->opcode = INVALID_OPCODE;
+    d->length = 1;
+    d->watch = FALSE;
+    if ((word >> 10) != 0 || (word & 3) != ABSOLUTE_ARE)
+        return;
+
+    opcode = (word >> 6) & 15;
+    argc = operand_count[opcode];
+    h = opcode_handler[opcode];
+    modes[0] = (argc == 2) ? (word >> 4) & 3 : (word >> 2) & 3;
+    modes[1] = (word >> 2) & 3;
+    if ((argc < 2 && ((word >> 4) & 3) != 0) || (argc == 0 && ((word >> 2) & 3) != 0))
+        return;
+    for (k=0; k<argc; k++)
+        types[k] = mode_type[modes[k]];
+    shared = (argc == 2 && types[0] == REGISTER && types[1] == REGISTER); /* two registers share a word */
+
+    external = FALSE;
+    for (k=0; k<argc; k++) {
+        int at = shared ? address + 1 : address + d->length;
+        int is_target = (k == argc - 1);
+        int value;
+
+        if (at + (types[k] == ARRAY_AND_INDEX) >= MEMORY_SIZE)
+            return;
+        value = m->memory[at];
+
+        switch (types[k]) {
+            case NUMBER: /* only cmp and prn can have an immediate target */
+                if ((value & 3) != ABSOLUTE_ARE || h == H_LEA || (is_target && h != H_CMP && h != H_PRN))
+                    return;
+                d->constants[k] = word_number(value) & WORD_MASK;
+                operands[k] = &d->constants[k];
+                break;
+            case REGISTER: /* the origin register is above the destination register */
+                if ((value & 3) != ABSOLUTE_ARE || (h == H_LEA && !is_target))
+                    return;
+                operands[k] = &m->registers[(k == 0 && argc == 2) ? (value >> 5) & 7 : (value >> 2) & 7];
+                break;
+            default: /* a label, maybe with an index */
+                if (value == EXTERNAL_ARE) {
+                    external = TRUE;
+                    operands[k] = NULL;
+                    break;
+                }
+                if ((value & 3) != RELOCATABLE_ARE)
+                    return;
+                value >>= 2;
+                if (types[k] == ARRAY_AND_INDEX) {
+                    if ((m->memory[at + 1] & 3) != ABSOLUTE_ARE)
+                        return;
+                    value += word_number(m->memory[at + 1]);
+                }
+                value &= ADDRESS_MASK;
+                if ((h == H_LEA && !is_target) || h == H_JMP || h == H_BNE || h == H_JST) {
+                    d->constants[k] = value;
+                    operands[k] = &d->constants[k];
+                }
+                else
+                    operands[k] = &m->memory[value];
+        }
+        if (!shared || k == 1)
+            d->length += (types[k] == ARRAY_AND_INDEX) ? 2 : 1;
+    }
+
+    d->opcode = opcode;
+    d->handler = external ? H_EXTERNAL : h;
+    d->source = (argc == 2) ? operands[0] : NULL;
+    d->target = (argc > 0) ? operands[argc - 1] : NULL;
+    d->watch = (argc > 0 && d->target >= m->memory && d->target < m->memory + MEMORY_SIZE &&
+                h != H_CMP && h != H_PRN && h != H_JMP && h != H_BNE && h != H_JST);
+}
+
+/* adds the count of the decoded instruction to the counts of the machine */
+void flush_count(machine* m, int address) {
+    decoded* d = &m->code[address];
+    m->opcode_counts[d->opcode] += d->count;
+    m->address_counts[address] += d->count;
+    m->executed += d->count;
+    d->count = 0;
+}
+
+/* the word at the address changed, so every instruction that might have it decodes again when it runs */
+void invalidate(machine* m, int address) {
+    int i;
+    for (i = address; i >= 0 && i > address - MAX_INSTRUCTION_LENGTH; i--)
+        if (m->code[i].handler != H_DECODE) {
+            flush_count(m, i);
+            m->code[i].handler = H_DECODE;
+        }
+}
+
+/* the handlers end with one of these, NEXT runs the instruction at pc (if the limit allows it) */
+#ifdef THREADED_DISPATCH
+#define HANDLER(name) name:
+#define DISPATCH() __extension__ ({ goto *handlers[d->handler]; })
+#define NEXT() do { d = &m->code[pc]; if (budget-- == 0) goto limit; d->count++; DISPATCH(); } while (0)
+#else
+#define HANDLER(name) case name:
+#define DISPATCH() goto dispatch
+#define NEXT() continue
+#endif
+
+/* the memory word the handler wrote to might be code */
+#define WROTE() if (d->watch) invalidate(m, (int)(d->target - m->memory))
+
+#define FAIL(message) do { m->error = message; goto fault; } while (0)
+
+/* runs the machine from its pc until it stops */
+void run(machine* m) {
+#ifdef THREADED_DISPATCH
+    __extension__ static void* handlers[] = {
+        &&H_DECODE, &&H_INVALID, &&H_EXTERNAL, &&H_OUTSIDE,
+        &&H_MOV, &&H_CMP, &&H_ADD, &&H_SUB, &&H_NOT, &&H_CLR, &&H_LEA, &&H_INC, &&H_DEC, &&H_JMP, &&H_BNE,
+        &&H_RED, &&H_PRN, &&H_JST, &&H_RTS, &&H_HLT
+    };
+#endif
+    decoded* d;
+    long budget = m->limit;
+    int pc = m->pc;
+    int c;
+
+#ifdef THREADED_DISPATCH
+    NEXT();
+#else
+    while (1) {
+        d = &m->code[pc];
+        if (budget-- == 0)
+            goto limit;
+        d->count++;
+    dispatch:
+        switch (d->handler) {
+#endif
+
+    HANDLER(H_DECODE)
+        decode_at(m, pc);
+        DISPATCH();
+    HANDLER(H_INVALID)
+        FAIL("the word isn't an instruction");
+    HANDLER(H_EXTERNAL)
+        FAIL("the instruction uses an external that wasn't linked");
+    HANDLER(H_OUTSIDE)
+        FAIL("the program ran past the end of the memory");
+
+    HANDLER(H_MOV)
+    HANDLER(H_LEA) /* the source of lea is the address */
+        *d->target = *d->source;
+        pc += d->length;
+        WROTE();
+        NEXT();
+    HANDLER(H_CMP)
+        m->zero = (*d->source == *d->target);
+        pc += d->length;
+        NEXT();
+    HANDLER(H_ADD)
+        *d->target = (*d->target + *d->source) & WORD_MASK;
+        pc += d->length;
+        WROTE();
+        NEXT();
+    HANDLER(H_SUB)
+        *d->target = (*d->target - *d->source) & WORD_MASK;
+        pc += d->length;
+        WROTE();
+        NEXT();
+    HANDLER(H_NOT)
+        *d->target = ~*d->target & WORD_MASK;
+        pc += d->length;
+        WROTE();
+        NEXT();
+    HANDLER(H_CLR)
+        *d->target = 0;
+        pc += d->length;
+        WROTE();
+        NEXT();
+    HANDLER(H_INC)
+        *d->target = (*d->target + 1) & WORD_MASK;
+        pc += d->length;
+        WROTE();
+        NEXT();
+    HANDLER(H_DEC)
+        *d->target = (*d->target - 1) & WORD_MASK;
+        pc += d->length;
+        WROTE();
+        NEXT();
+    HANDLER(H_JMP)
+        pc = *d->target & ADDRESS_MASK;
+        NEXT();
+    HANDLER(H_BNE)
+        pc = m->zero ? pc + d->length : *d->target & ADDRESS_MASK;
+        NEXT();
+    HANDLER(H_RED)
+        c = (m->input != NULL) ? getc(m->input) : EOF;
+        *d->target = (c == EOF ? -1 : c) & WORD_MASK;
+        pc += d->length;
+        WROTE();
+        NEXT();
+    HANDLER(H_PRN)
+        fprintf(m->output, "%d\n", signed_value(*d->target));
+        pc += d->length;
+        NEXT();
+    HANDLER(H_JST)
+        if (m->stack_size == STACK_SIZE)
+            FAIL("the stack is full");
+        m->stack[m->stack_size++] = pc + d->length;
+        pc = *d->target & ADDRESS_MASK;
+        NEXT();
+    HANDLER(H_RTS)
+        if (m->stack_size == 0)
+            FAIL("rts without jst");
+        pc = m->stack[--m->stack_size];
+        NEXT();
+    HANDLER(H_HLT)
+        m->status = HALTED;
+        m->pc = pc;
+        return;
+
+#ifndef THREADED_DISPATCH
+        }
+    }
+#endif
+
+limit:
+    m->status = LIMIT;
+    m->pc = pc;
+    return;
+fault:
+    m->status = FAULT;
+    m->pc = pc;
+}
+
+/* loads the words of the image into a new machine, returns NULL (and prints why) if it can't be loaded */
+machine* load_machine(char* filename, long limit) {
+    machine* m;
+    int* words;
+    int count;
+    int length = strlen(filename);
+    int i;
+
+    words = NULL;
+    count = 0;
+    if (length > 4 && strcmp(filename + length - 4, ".obj") == 0) {
+        object_file object;
+        if (!open_object(filename, &object)) {
+            printf("error: %s: %s\n", filename, object.error);
+            return NULL;
+        }
+        count = object.header->code_words + object.header->data_words;
+        words = (int*)malloc((count + 1) * sizeof(int));
+        if (words == NULL) {
+            printf("Memory allocation failed\n");
+            exit(1);
+        }
+        for (i=0; i<count; i++)
+            words[i] = object.words[i];
+        close_object(&object);
+    }
+    else if (length > 3 && strcmp(filename + length - 3, ".ob") == 0) {
+        source_file file;
+        decoded_ob ob;
+
+        if (!read_file(filename, &file)) {
+            printf("error: can't read %s\n", filename);
+            return NULL;
+        }
+        if (!decode_ob(file.text, file.length, &ob)) {
+            printf("error: %s:%ld: %s\n", filename, ob.error_line, ob.error);
+            close_file(&file);
+            return NULL;
+        }
+        close_file(&file);
+        words = ob.words; /* it doesn't use the assembler's allocator either */
+        count = ob.IC + ob.DC;
+    }
+    else {
+        printf("error: %s isn't a .ob or .obj file\n", filename);
+        return NULL;
+    }
+    if (FIRST_ADDRESS + count > MEMORY_SIZE) {
+        printf("error: %s has %d words, they don't fit in the memory\n", filename, count);
+        free(words);
+        return NULL;
+    }
+
+    m = (machine*)CALLOC(1, sizeof(machine));
+    if (m == NULL) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    for (i=0; i<count; i++)
+        m->memory[FIRST_ADDRESS + i] = words[i] & WORD_MASK;
+    free(words);
+
+    /* the code is decoded before the run, the rest of the memory when something jumps into it */
+    for (i=0; i<MEMORY_SIZE; i++)
+        m->code[i].handler = H_DECODE;
+    for (i=MEMORY_SIZE; i<MEMORY_SIZE+MAX_INSTRUCTION_LENGTH; i++) {
+        m->code[i].handler = H_OUTSIDE;
+        m->code[i].opcode = INVALID_OPCODE;
+    }
+    for (i=FIRST_ADDRESS; i<FIRST_ADDRESS+count; i++)
+        decode_at(m, i);
+
+    m->pc = FIRST_ADDRESS;
+    m->limit = limit;
+    m->status = RUNNING;
+    return m;
+}
+
+/* runs the machine and adds up its counts */
+void run_machine(machine* m) {
+    int i;
+
+    run(m);
+    for (i=0; i<MEMORY_SIZE+MAX_INSTRUCTION_LENGTH; i++)
+        if (m->code[i].count > 0)
+            flush_count(m, i);
+}
+
+/* a line that says how the run ended */
+void print_status(FILE* out, char* filename, machine* m) {
+    switch (m->status) {
+        case HALTED:
+            fprintf(out, "%s: halted after %ld instructions", filename, m->executed);
+            break;
+        case LIMIT:
+            fprintf(out, "%s: stopped at the limit of %ld instructions", filename, m->limit);
+            break;
+        default:
+            fprintf(out, "%s: error at %04d after %ld instructions: %s", filename, m->pc, m->executed, m->error);
+    }
+}
+
+/* how many times every opcode ran and the addresses that ran the most */
+void print_profile(FILE* out, machine* m) {
+    int hotspots[HOTSPOTS];
+    int count;
+    int i;
+    int j;
+
+    fprintf(out, "opcode      executed\n");
+    for (i=0; i<=INVALID_OPCODE; i++)
+        if (m->opcode_counts[i] > 0)
+            fprintf(out, "%-10s  %ld\n", opcode_name[i], m->opcode_counts[i]);
+
+    count = 0;
+    for (i=0; i<MEMORY_SIZE; i++) { /* keeps the hottest addresses sorted */
+        if (m->address_counts[i] == 0 || (count == HOTSPOTS && m->address_counts[i] <= m->address_counts[hotspots[count-1]]))
+            continue;
+        if (count < HOTSPOTS)
+            count++;
+        for (j = count - 1; j > 0 && m->address_counts[hotspots[j-1]] < m->address_counts[i]; j--)
+            hotspots[j] = hotspots[j-1];
+        hotspots[j] = i;
+    }
+    fprintf(out, "address     executed   share   opcode\n");
+    for (i=0; i<count; i++)
+        fprintf(out, "%04d        %-10ld %5.1f%%  %s\n", hotspots[i], m->address_counts[hotspots[i]],
+                100.0 * m->address_counts[hotspots[i]] / m->executed, opcode_name[m->code[hotspots[i]].opcode]);
+}
+
+double now_in_milliseconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000.0 + now.tv_nsec / 1e6;
+}
+
+/* the images of a batch and what the threads share */
+typedef struct batch {
+    char** filenames;
+    machine** machines;
+    int count;
+    int next; /* the next image a thread takes */
+    long limit;
+    pthread_mutex_t lock;
+} batch;
+
+/* runs an image of the batch with <name>.in as its input and <name>.out as its output */
+void run_image(batch* b, int i) {
+    char* filename = b->filenames[i];
+    char other[256];
+    machine* m;
+    int length;
+
+    m = load_machine(filename, b->limit);
+    b->machines[i] = m;
+    if (m == NULL)
+        return;
+    length = strrchr(filename, '.') - filename; /* without the .ob or .obj */
+    sprintf(other, "%.*s.in", length > 200 ? 200 : length, filename);
+    m->input = fopen(other, "r");
+    sprintf(other, "%.*s.out", length > 200 ? 200 : length, filename);
+    m->output = fopen(other, "w");
+    if (m->output == NULL) {
+        m->status = FAULT;
+        m->error = "can't write the output";
+    }
+    else
+        run_machine(m);
+    if (m->input != NULL)
+        fclose(m->input);
+    if (m->output != NULL)
+        fclose(m->output);
+}
+
+void* batch_worker(void* argument) {
+    batch* b = (batch*)argument;
+
+    while (1) {
+        int i;
+
+        pthread_mutex_lock(&b->lock);
+        i = b->next++;
+        pthread_mutex_unlock(&b->lock);
+        if (i >= b->count)
+            return NULL;
+        run_image(b, i);
+    }
+}
+
+/* runs every image in the given amount of threads, returns how many of them failed */
+int run_batch(char** filenames, int count, int jobs, long limit, int profile) {
+    pthread_t threads[MAX_JOBS];
+    double start;
+    double milliseconds;
+    long executed;
+    int failed;
+    batch b;
+    int i;
+
+    b.filenames = filenames;
+    b.count = count;
+    b.next = 0;
+    b.limit = limit;
+    b.machines = (machine**)CALLOC(count, sizeof(machine*));
+    if (b.machines == NULL) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    pthread_mutex_init(&b.lock, NULL);
+
+    start = now_in_milliseconds();
+    if (jobs > count)
+        jobs = count;
+    for (i=1; i<jobs; i++)
+        if (pthread_create(&threads[i], NULL, batch_worker, &b) != 0) {
+            printf("error: can't start a thread\n");
+            exit(1);
+        }
+    batch_worker(&b); /* this thread is one of them */
+    for (i=1; i<jobs; i++)
+        pthread_join(threads[i], NULL);
+    milliseconds = now_in_milliseconds() - start;
+
+    failed = 0;
+    executed = 0;
+    for (i=0; i<count; i++) {
+        machine* m = b.machines[i];
+
+        if (m == NULL) { /* the error is already printed */
+            failed++;
+            continue;
+        }
+        print_status(stdout, filenames[i], m);
+        printf("\n");
+        if (profile)
+            print_profile(stdout, m);
+        if (m->status != HALTED)
+            failed++;
+        executed += m->executed;
+        FREE(m);
+    }
+    printf("ran %d images in %d %s: %ld instructions in %.2f ms (%.1f million instructions per second), %d failed\n",
+           count, jobs, jobs == 1 ? "thread" : "threads", executed, milliseconds, executed / (milliseconds > 0 ? milliseconds : 1e-6) / 1000, failed);
+
+    FREE(b.machines);
+    pthread_mutex_destroy(&b.lock);
+    return failed;
+}
+
+int main(int argc, char* argv[]) {
+    machine* m;
+    long limit;
+    int batch_mode;
+    int profile;
+    int jobs;
+    int failed;
+    int i;
+
+    limit = DEFAULT_LIMIT;
+    batch_mode = FALSE;
+    profile = FALSE;
+    jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    for (i = 1; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+        if (strcmp(argv[i], "--batch") == 0)
+            batch_mode = TRUE;
+        else if (strcmp(argv[i], "--profile") == 0)
+            profile = TRUE;
+        else if (strncmp(argv[i], "--jobs=", 7) == 0 && atoi(argv[i] + 7) > 0)
+            jobs = atoi(argv[i] + 7);
+        else if (strncmp(argv[i], "--limit=", 8) == 0 && atol(argv[i] + 8) > 0)
+            limit = atol(argv[i] + 8);
+        else {
+            printf("error: unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (i == argc || (!batch_mode && argc - i > 1)) {
+        printf("usage: emulator [--limit=N] [--profile] <image.ob | image.obj>\n");
+        printf("       emulator --batch [--jobs=N] [--limit=N] [--profile] <images>\n");
+        return 1;
+    }
+    if (jobs < 1)
+        jobs = 1;
+    if (jobs > MAX_JOBS)
+        jobs = MAX_JOBS;
+
+    build_tables();
+    if (batch_mode)
+        return run_batch(argv + i, argc - i, jobs, limit, profile) > 0;
+
+    m = load_machine(argv[i], limit);
+    if (m == NULL)
+        return 1;
+    m->input = stdin;
+    m->output = stdout;
+    {
+        double start = now_in_milliseconds();
+        double milliseconds;
+
+        run_machine(m);
+        milliseconds = now_in_milliseconds() - start;
+        fflush(stdout);
+        print_status(stderr, argv[i], m);
+        fprintf(stderr, " in %.2f ms (%.1f million instructions per second)\n",
+                milliseconds, m->executed / (milliseconds > 0 ? milliseconds : 1e-6) / 1000);
+    }
+    if (profile)
+        print_profile(stderr, m);
+    failed = (m->status != HALTED);
+    FREE(m);
+    return failed;
+}
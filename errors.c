@@ -1,12 +1,16 @@
+#define _POSIX_C_SOURCE 200112L
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include "data_nodes.h"
 #include "sentences.h"
+#include "errors.h"
 #include "utils.h"
 #include "arguments.h"
 #include "first_pass.h"
-#include "errors.h"
+#include "alloc.h"
+
+#define ALLOC_SUBSYSTEM ALLOC_ERRORS
 
 
 /* an array containing all of the conserved words */
@@ -127,63 +131,66 @@ int is_valid_argc(sentence s) {
 }
 
 
-/* returns weather the given sentence has the correct types of arguments for its operation */
-int valid_arg_types(sentence s) {
+/* returns weather the argument i of the sentence (which has the right amount of arguments) has a correct type for its operation */
+int valid_arg_type(sentence s, int i) {
     char* op;
+    arg_type type;
     op = s.operation;
+    type = get_arg_type(s.argv[i]);
 	
 	/* if the operation is - mov, add or sub */
     if (strcmp(op,"mov")==0 || strcmp(op,"add")==0 || strcmp(op,"sub")==0) {
-        arg_type origin = get_arg_type(s.argv[0]);
-        arg_type destination = get_arg_type(s.argv[1]);
         /* the origin operand can be 1, 2, 3 or 4 and the destination type can be 1, 2 or 3*/
-        return (origin==0 || origin==1 || origin==2 || origin==3) && 
-               (destination==1 || destination==2 || destination==3);
+        if (i == 0)
+            return type==0 || type==1 || type==2 || type==3;
+        return type==1 || type==2 || type==3;
     }
 	
 	/* if the operation is - cmp */
     if (strcmp(op,"cmp")==0) {
-        arg_type origin = get_arg_type(s.argv[0]);
-        arg_type destination = get_arg_type(s.argv[1]);
         /* both operands can be 1, 2, 3 or 4*/
-        return (origin==0 || origin==1 || origin==2 || origin==3) && 
-               (destination==0 || destination==1 || destination==2 || destination==3);
+        return type==0 || type==1 || type==2 || type==3;
     }
 	
 	/* if the operation is - not, clr, inc, dec or red */
     if (strcmp(op,"not")==0 || strcmp(op,"clr")==0 || strcmp(op,"inc")==0 || strcmp(op,"dec")==0 || strcmp(op,"red")==0) {
-        arg_type destination = get_arg_type(s.argv[0]);
         /* the destination type can be 1, 2 or 3*/
-        return destination==1 || destination==2 || destination==3;
+        return type==1 || type==2 || type==3;
     }
     
     /* if the operation is - lea */
     if (strcmp(op,"lea")==0) {
-        arg_type origin = get_arg_type(s.argv[0]);
-        arg_type destination = get_arg_type(s.argv[1]);
-        /* both operands can be 1, 2, 3 or 4*/
-        return (origin==1 || origin==2) &&
-               (destination==1 || destination==2 || destination==3);
+        /* the origin can be 1 or 2 and the destination 1, 2 or 3 */
+        if (i == 0)
+            return type==1 || type==2;
+        return type==1 || type==2 || type==3;
     }
 
 	/* if the operation is - jmp, bne or jsr */
     if (strcmp(op,"jmp")==0 || strcmp(op,"bne")==0 || strcmp(op,"jsr")==0) {
-        arg_type destination = get_arg_type(s.argv[0]);
-        /* both operands can be 1, 2, 3 or 4*/
-        return destination==1 || destination==3;
+        /* the destination can be 1 or 3 */
+        return type==1 || type==3;
     }
 	
 	/* if the operation is - prn */
     if (strcmp(op,"prn")==0) {
-        arg_type destination = get_arg_type(s.argv[0]);
-        /* both operands can be 1, 2, 3 or 4*/
-        return destination==0 || destination==1 || destination==2 || destination==3;
+        /* the destination can be 1, 2, 3 or 4*/
+        return type==0 || type==1 || type==2 || type==3;
     }
 
-    /* the remaining operations are rts and hlt which can not have wrong arg types because they have no args */
+    /* the remaining operations are the directives, and rts and hlt which can not have wrong arg types because they have no args */
     return TRUE;
 }
 
+/* returns the first argument of the sentence that has a wrong type for its operation, or -1 if they are all correct */
+int invalid_arg(sentence s) {
+    unsigned int i;
+    for (i=0; i<s.argc; i++)
+        if (!valid_arg_type(s, i))
+            return i;
+    return -1;
+}
+
 
 
 /* the find_errors function only find errors in the composition of the sentence,
@@ -205,8 +212,310 @@ char* find_error(sentence s) {
     /* finds errors in the amount of arguments and their types */
     if (!is_valid_argc(s))
         return "Incorrect Amount Of Arguments For This Operation";
-    if (!valid_arg_types(s))
+    if (invalid_arg(s) >= 0)
         return "Invalid Argument Types For This Operation";
     
     return NULL; /* return null if no error was found */
 }
+
+
+
+/* the code, severity and text of every kind of message (in the order of diagnostic_code).
+ * the codes start with E for errors and W for warnings, then the stage: 0 the driver, 1 the preprocessor, 2 the first pass and 3 the second pass */
+struct diagnostic_kind {
+    char* code;
+    char* severity;
+    char* format; /* has at most one %s, for the argument */
+} diagnostic_kinds[] = {
+    {"E001", "error", "file not found"},
+    {"E002", "error", "too many errors, stopping"},
+    {"E101", "error", "line length exceeds 80 chars"},
+    {"W101", "warning", "Label Ignored When Put On %s Lines."},
+    {"E102", "error", "Too Many Arguments (0 Argument Expected)"},
+    {"E103", "error", "Missing Macro Name"},
+    {"E104", "error", "Too Many Arguments (1 Argument Expected)"},
+    /* E201 and E202 were every error of to_sentence and of find_error, before each one had its own code */
+    {"E203", "error", "\"%s\" can't be both extern and entry"},
+    {"E204", "error", "\"%s\" can't be both extern and label"},
+    {"E205", "error", "Label Already Exists"},
+    {"E206", "error", "':' Must Be Attached To The End Of The Label"},
+    {"E207", "error", "Missing Comma Between Arguments"},
+    {"E208", "error", "Unclosed Square Brackets"},
+    {"E209", "error", "Unclosed Quotes"},
+    {"E210", "error", "Label Is a Conserved Word"},
+    {"E211", "error", "Name Must Strart With A Latin Letter And Consist Of Only Latin Letters Or Numbers"},
+    {"E212", "error", "Unknown Operation"},
+    {"E213", "error", "Incorrect Amount Of Arguments For This Operation"},
+    {"E214", "error", "Invalid Argument Types For This Operation"},
+    {"E215", "error", "Invalid .define statement, Expected: \".define <name> = <value>\""},
+    {"E301", "error", "labels can't be put on define statements"},
+    {"E302", "error", "define statement should be structured as such: \".define <name>=<value>\""},
+    {"E303", "error", "Name Must Strart With A Latin Letter And Consist Of Only Latin Letters Or Numbers"},
+    {"E304", "error", "instructions, operations, registers and other conserved words can't be defined"},
+    {"E305", "error", "the defined value must be an integer"},
+    {"E306", "error", "cannot use .entry on a non existent label"},
+    {"E307", "error", "invalid integer"},
+    {"E308", "error", "unknown variable: %s"},
+    {"E309", "error", "invalid index"}
+};
+
+
+/* returns the code of an error of to_sentence or find_error, they are the only messages with the same text.
+ * every one of them has its own code, WRONG_ARGUMENT_TYPES is only what a new message gets until it has one */
+diagnostic_code sentence_error_code(char* error) {
+    int code;
+    for (code=DETACHED_LABEL_COLON; code<=INVALID_DEFINE_SENTENCE; code++)
+        if (strcmp(diagnostic_kinds[code].format, error) == 0)
+            return (diagnostic_code)code;
+    return WRONG_ARGUMENT_TYPES;
+}
+
+/* returns the part of the line the error of the sentence is about (see report), NULL for the whole line */
+char* sentence_error_token(sentence s, diagnostic_code code) {
+    int i;
+
+    switch (code) {
+        case LABEL_CONSERVED_WORD:
+        case LABEL_INVALID_NAME:
+            return s.label;
+        case UNKNOWN_OPERATION:
+            return s.operation;
+        case WRONG_ARGUMENT_COUNT: /* the first argument that is too many, or the operation when some are missing */
+            for (i=0; i<19; i++)
+                if (strcmp(s.operation, valid_argc[i].name)==0 && s.argc > (unsigned int)valid_argc[i].argc)
+                    return s.argv[valid_argc[i].argc];
+            return s.operation;
+        case WRONG_ARGUMENT_TYPES: /* the operation when it isn't about an argument (see sentence_error_code) */
+            i = invalid_arg(s);
+            return (i >= 0) ? s.argv[i] : s.operation;
+        default: /* to_sentence found it and kept its token */
+            return s.err_token;
+    }
+}
+
+/* prepares an empty list of diagnostics for the file (filename can be NULL), max_errors is 0 for no limit */
+void start_diagnostics(diagnostics* diag, char* filename, int max_errors) {
+    diag->filename = filename;
+    diag->max_errors = max_errors;
+    diag->error_count = 0;
+    diag->stopped = FALSE;
+    diag->list = NULL;
+    diag->count = 0;
+    diag->capacity = 0;
+}
+
+/* removes all of the collected messages but keeps the list allocated so it can be reused */
+void clear_diagnostics(diagnostics* diag) {
+    int i;
+    for (i=0; i<diag->count; i++)
+        FREE(diag->list[i].argument);
+    diag->count = 0;
+    diag->error_count = 0;
+    diag->stopped = FALSE;
+}
+
+/* frees all of the memory of the diagnostics */
+void free_diagnostics(diagnostics* diag) {
+    clear_diagnostics(diag);
+    FREE(diag->list);
+    diag->list = NULL;
+    diag->capacity = 0;
+}
+
+/* returns whether c can be a part of a name */
+int is_name_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == '.';
+}
+
+/* sets the column and span of the token in the line's text (the whole line when token is NULL).
+ * the token is usually a copy from the sentence, so it is looked up as a whole word in the text */
+void locate(char* text, char* token, int* column, int* span) {
+    char* found;
+    int length;
+
+    *column = 0;
+    *span = 0;
+    if (text == NULL)
+        return;
+
+    if (token == NULL || token[0] == '\0') { /* the whole line without the spaces around it */
+        length = strlen(text);
+        while (length > 0 && (text[length-1] == '\n' || text[length-1] == ' ' || text[length-1] == '\t'))
+            length--;
+        for (found = text; found < text + length && (*found == ' ' || *found == '\t'); found++)
+            ;
+        *column = found - text + 1;
+        *span = text + length - found;
+        return;
+    }
+
+    length = strlen(token);
+    for (found = strstr(text, token); found != NULL; found = strstr(found + 1, token))
+        if ((found == text || !is_name_char(found[-1])) && !is_name_char(found[length]))
+            break;
+    if (found == NULL)
+        found = strstr(text, token); /* not a whole word, a part of it is better than nothing */
+    if (found == NULL)
+        return;
+    *column = found - text + 1;
+    *span = length;
+}
+
+/* adds a message to the list */
+void add_diagnostic(diagnostics* diag, diagnostic_code code, int line, char* text, char* token, char* argument) {
+    diagnostic* d;
+
+    if (diag->count == diag->capacity) {
+        diagnostic* bigger;
+        diag->capacity = (diag->capacity == 0) ? 16 : diag->capacity * 2;
+        bigger = (diagnostic*)REALLOC(diag->list, diag->capacity * sizeof(diagnostic));
+        if (bigger == NULL) {
+            printf("Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+        diag->list = bigger;
+    }
+
+    d = &diag->list[diag->count++];
+    d->code = code;
+    d->line = line;
+    locate(text, token, &d->column, &d->span);
+    d->argument = (argument != NULL) ? STRDUP(argument) : NULL;
+}
+
+/* reports a message about the given line.
+ * text is the line itself and token the part of it the message is about (NULL for the whole line),
+ * argument goes into the message's text (NULL if it has none).
+ * nothing is reported after max_errors errors, and the passes stop when too_many_errors says so */
+void report(diagnostics* diag, diagnostic_code code, int line, char* text, char* token, char* argument) {
+    if (diag->stopped)
+        return;
+
+    add_diagnostic(diag, code, line, text, token, argument);
+
+    if (strcmp(diagnostic_kinds[code].severity, "error") == 0) {
+        diag->error_count++;
+        if (diag->max_errors > 0 && diag->error_count >= diag->max_errors) {
+            add_diagnostic(diag, TOO_MANY_ERRORS, line, NULL, NULL, NULL);
+            diag->stopped = TRUE;
+        }
+    }
+}
+
+/* returns whether the compilation should stop because there are already max_errors errors */
+int too_many_errors(diagnostics* diag) {
+    return diag->stopped;
+}
+
+char* diagnostic_code_name(diagnostic_code code) {
+    return diagnostic_kinds[code].code;
+}
+
+char* diagnostic_severity(diagnostic_code code) {
+    return diagnostic_kinds[code].severity;
+}
+
+/* returns the text of the message (allocated) */
+char* diagnostic_message(diagnostic* d) {
+    char* format = diagnostic_kinds[d->code].format;
+    char* argument = (d->argument != NULL) ? d->argument : "";
+    char* message;
+
+    message = (char*)MALLOC(strlen(format) + strlen(argument) + 1);
+    if (message == NULL) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    sprintf(message, format, argument);
+    return message;
+}
+
+
+/* adds the string to the buffer as a json string */
+void add_json_string(text_buffer* buffer, char* string) {
+    char* out = reserve_text(buffer, strlen(string) * 6 + 2);
+
+    *out++ = '"';
+    for (; *string != '\0'; string++) {
+        unsigned char c = (unsigned char)*string;
+        if (c == '"' || c == '\\') {
+            *out++ = '\\';
+            *out++ = c;
+        }
+        else if (c < 0x20)
+            out += sprintf(out, "\\u%04x", c);
+        else
+            *out++ = c;
+    }
+    *out++ = '"';
+    *out = '\0';
+    buffer->length = out - buffer->text;
+}
+
+/* returns all of the collected messages as text (see DIAGNOSTIC_FORMAT), or NULL if there are none */
+char* diagnostics_text(diagnostics* diag) {
+    text_buffer buffer;
+    char* filename = (diag->filename != NULL) ? diag->filename : "<source>";
+    int i;
+
+    if (diag->count == 0)
+        return NULL;
+
+    start_text(&buffer);
+    for (i=0; i<diag->count; i++) {
+        diagnostic* d = &diag->list[i];
+        char* message = diagnostic_message(d);
+
+        reserve_text(&buffer, strlen(filename) + strlen(message) + 64);
+        buffer.length += sprintf(buffer.text + buffer.length, DIAGNOSTIC_FORMAT, filename, d->line, d->column,
+                                 diagnostic_severity(d->code), message, diagnostic_code_name(d->code));
+        FREE(message);
+    }
+    return buffer.text;
+}
+
+/* returns all of the collected messages as one line of json:
+ * {"file": ..., "errors": <count>, "diagnostics": [{"code", "severity", "line", "column", "span", "message"}, ...]} */
+char* diagnostics_json(diagnostics* diag) {
+    text_buffer buffer;
+    int i;
+
+    start_text(&buffer);
+    reserve_text(&buffer, 16);
+    buffer.length += sprintf(buffer.text + buffer.length, "{\"file\": ");
+    if (diag->filename != NULL)
+        add_json_string(&buffer, diag->filename);
+    else {
+        reserve_text(&buffer, 4);
+        buffer.length += sprintf(buffer.text + buffer.length, "null");
+    }
+    reserve_text(&buffer, 64);
+    buffer.length += sprintf(buffer.text + buffer.length, ", \"errors\": %d, \"diagnostics\": [", diag->error_count);
+
+    for (i=0; i<diag->count; i++) {
+        diagnostic* d = &diag->list[i];
+        char* message = diagnostic_message(d);
+
+        reserve_text(&buffer, 128);
+        buffer.length += sprintf(buffer.text + buffer.length,
+                                 "%s{\"code\": \"%s\", \"severity\": \"%s\", \"line\": %d, \"column\": %d, \"span\": %d, \"message\": ",
+                                 i > 0 ? ", " : "", diagnostic_code_name(d->code), diagnostic_severity(d->code), d->line, d->column, d->span);
+        add_json_string(&buffer, message);
+        reserve_text(&buffer, 1);
+        buffer.text[buffer.length++] = '}';
+        FREE(message);
+    }
+
+    reserve_text(&buffer, 3);
+    buffer.length += sprintf(buffer.text + buffer.length, "]}\n");
+    return buffer.text;
+}
+
+/* writes the collected messages to the stream in one write, as text or as json */
+void write_diagnostics(diagnostics* diag, int json, FILE* stream) {
+    char* text = json ? diagnostics_json(diag) : diagnostics_text(diag);
+
+    if (text != NULL)
+        fwrite(text, 1, strlen(text), stream);
+    FREE(text);
+}
@@ -1,3 +1,65 @@
+/* every kind of message the assembler reports, the code, severity and text of each one are in diagnostic_kinds (errors.c) */
+typedef enum {
+    FILE_NOT_FOUND,
+    TOO_MANY_ERRORS,
+    /* preprocessor */
+    LINE_TOO_LONG,
+    LABEL_IGNORED,
+    ENDMCR_ARGUMENTS,
+    MISSING_MACRO_NAME,
+    MCR_ARGUMENTS,
+    /* first pass */
+    EXTERN_AND_ENTRY,
+    EXTERN_AND_LABEL,
+    LABEL_EXISTS,
+    /* the errors of to_sentence */
+    DETACHED_LABEL_COLON,
+    MISSING_COMMA,
+    UNCLOSED_BRACKETS,
+    UNCLOSED_QUOTES,
+    /* the errors of find_error */
+    LABEL_CONSERVED_WORD,
+    LABEL_INVALID_NAME,
+    UNKNOWN_OPERATION,
+    WRONG_ARGUMENT_COUNT,
+    WRONG_ARGUMENT_TYPES,
+    INVALID_DEFINE_SENTENCE, /* the .define error of to_sentence */
+    /* second pass */
+    DEFINE_WITH_LABEL,
+    DEFINE_STRUCTURE,
+    DEFINE_INVALID_NAME,
+    DEFINE_CONSERVED_WORD,
+    DEFINE_NOT_INTEGER,
+    UNKNOWN_ENTRY,
+    INVALID_INTEGER,
+    UNKNOWN_VARIABLE,
+    INVALID_INDEX
+} diagnostic_code;
+
+/* one message about a problem in the source.
+ * only what it is about is recorded, the text is put together when the messages are written */
+typedef struct diagnostic {
+    diagnostic_code code;
+    int line;
+    int column; /* where in the line the problem is (starting from 1), 0 when it isn't known */
+    int span; /* how many characters it covers */
+    char* argument; /* the argument of the message's text (a name or an error), NULL if it has none */
+} diagnostic;
+
+/* the messages of one compilation, they are written all at once when it is over */
+typedef struct diagnostics {
+    char* filename; /* the file the messages are about (NULL when there isn't one) */
+    int max_errors; /* the compilation stops after this many errors, 0 when there is no limit */
+    int error_count;
+    int stopped; /* max_errors was reached */
+    diagnostic* list;
+    int count;
+    int capacity;
+} diagnostics;
+
+/* how a message is written as text: "<file>:<line>:<column>: <severity>: <message> [<code>]" */
+#define DIAGNOSTIC_FORMAT "%s:%d:%d: %s: %s [%s]\n"
+
 extern char* conserved_words[28];
 
 extern char* valid_operations[21];
@@ -10,4 +72,30 @@ extern struct valid_argc_struct {
 
 char* find_error(sentence s);
 
+diagnostic_code sentence_error_code(char* error);
+
+char* sentence_error_token(sentence s, diagnostic_code code);
+
 int is_conserved_word(char* word);
+
+void start_diagnostics(diagnostics* diag, char* filename, int max_errors);
+
+void clear_diagnostics(diagnostics* diag);
+
+void free_diagnostics(diagnostics* diag);
+
+void report(diagnostics* diag, diagnostic_code code, int line, char* text, char* token, char* argument);
+
+int too_many_errors(diagnostics* diag);
+
+char* diagnostic_code_name(diagnostic_code code);
+
+char* diagnostic_severity(diagnostic_code code);
+
+char* diagnostic_message(diagnostic* d);
+
+char* diagnostics_text(diagnostics* diag);
+
+char* diagnostics_json(diagnostics* diag);
+
+void write_diagnostics(diagnostics* diag, int json, FILE* stream);
@@ -2,12 +2,15 @@
 #include <stdlib.h>
 #include <string.h>
 #include "sentences.h"
+#include "errors.h"
 #include "utils.h"
 #include "arguments.h"
 #include "data_nodes.h"
 #include "first_pass.h"
 #include "preprocessor.h"
-#include "errors.h"
+
+/* the line number of the current line, it is only looked up (once) when a message is reported */
+#define LINE_NUMBER (line_num != 0 ? line_num : (line_num = find_mapped_line(&as_lines, line)))
 
 
 /* returns the number of machine words a single given argument takes up */
@@ -76,135 +79,98 @@ the function handles some errors but not all of them, the secnond pass handles t
 as_text and am_text are strings containing the .as and .am file's content
 IC_ptr and DC_ptr are pointers who's values will be set to the instruction counter and data counter
 label_head, extern_head and entry_node are the lists for labels
+diag receives the error messages
 */
-int first_pass(char* as_text, char* am_text, int* IC_ptr, int* DC_ptr, label_node** label_head, extern_node** extern_head, entry_node** entry_head) {
+int first_pass(char* as_text, char* am_text, int* IC_ptr, int* DC_ptr, label_node** label_head, extern_node** extern_head, entry_node** entry_head, diagnostics* diag) {
     int IC, DC, has_error;
     char* line;
+    line_reader reader;
+    line_map as_lines; /* the line numbers of the messages */
     label_node* current;
 	
     IC = 0;
     DC = 0;
     has_error = FALSE;
+    start_line_map(&as_lines, as_text);
     
-    /* Using strtok to split the string every new line */
-    line = strtok(am_text, "\n");
+    /* go through every line of the .am text */
+    start_lines(&reader, am_text);
+    line = next_line(&reader);
     
-    while (line != NULL) {
+    while (line != NULL && !too_many_errors(diag)) {
         int line_num;
         sentence s;
         char* error;
         operation_type type;
         
-        line_num = find_line_number(as_text, line); /* get the line number */
+        line_num = 0; /* looked up only when a message is reported (see LINE_NUMBER) */
         s = to_sentence(line); /* turn the line into a sentence */
+        error = NULL;
         
         /* blank lines should be ignored and defines are handled in the second pass */
-        if (s.is_blank || strcmp(s.operation, ".define") == 0) {
-        	free_sentence(s);
-            line = strtok(NULL, "\n");
-            continue;
-        }
+        if (s.is_blank || strcmp(s.operation, ".define") == 0)
+            ;
 
         /* handle errors with the sentence (not all errors are handled here) */
-        if (s.err != NULL) {
-            printf("line %d: error: %s\n", line_num, s.err);
+        else if ((error = (s.err != NULL) ? s.err : find_error(s)) != NULL) {
+            diagnostic_code code = sentence_error_code(error);
+            report(diag, code, LINE_NUMBER, line, sentence_error_token(s, code), NULL);
             has_error = TRUE;
-            free_sentence(s);
-            line = strtok(NULL, "\n");
-            continue;
         }
-        error = find_error(s);
-        if (error != NULL) {
-            printf("line %d: error: %s\n", line_num, error);
-            has_error = TRUE;
-            free_sentence(s);
-            line = strtok(NULL, "\n");
-            continue;
-        }
-        
-        type = get_operation_type(s.operation); /* get the operation type */
         
-        if (type == ENTRY) { /* if it's a .entry sentence */
+        else if ((type = get_operation_type(s.operation)) == ENTRY) { /* if it's a .entry sentence */
             if (s.label != NULL) /* if there is a label on the sentence */
-                printf("line %d: WARNING: Label Ignored When Put On .entry Lines.", line_num);
+                report(diag, LABEL_IGNORED, LINE_NUMBER, line, s.label, ".entry");
             
             if (get_extern(*extern_head, s.argv[0]) != NULL) { /* error if the entry is an extern */
-                printf("line %d: error: \"%s\" can't be both extern and entry\n", line_num, s.argv[0]);
+                report(diag, EXTERN_AND_ENTRY, LINE_NUMBER, line, s.argv[0], s.argv[0]);
                 has_error = TRUE;
-                free_sentence(s);
-                line = strtok(NULL, "\n");
-                continue;
             }
-            
-            if (get_entry(*entry_head, s.argv[0]) == NULL) /* add entry to list only if it is new */
+            else if (get_entry(*entry_head, s.argv[0]) == NULL) /* add entry to list only if it is new */
                 add_entry(entry_head, s.argv[0]);
         }
         else if (type == EXTERN) { /* if it's a .extern sentence */
             if (s.label != NULL)  /* if there is a label on the sentence */
-                printf("line %d: WARNING: Label Ignored When Put On .extern Lines.\n", line_num);
+                report(diag, LABEL_IGNORED, LINE_NUMBER, line, s.label, ".extern");
             
             if (get_label(*label_head, s.argv[0]) != NULL) { /* error if the extern is a label */
-                printf("line %d: error: \"%s\" can't be both extern and label\n", line_num, s.argv[0]);
+                report(diag, EXTERN_AND_LABEL, LINE_NUMBER, line, s.argv[0], s.argv[0]);
                 has_error = TRUE;
-                free_sentence(s);
-                line = strtok(NULL, "\n");
-                continue;
             }
-            if (get_entry(*entry_head, s.argv[0]) != NULL) {
-                printf("line %d: error: \"%s\" can't be both extern and entry\n", line_num, s.argv[0]);
+            else if (get_entry(*entry_head, s.argv[0]) != NULL) {
+                report(diag, EXTERN_AND_ENTRY, LINE_NUMBER, line, s.argv[0], s.argv[0]);
                 has_error = TRUE;
-                free_sentence(s);
-                line = strtok(NULL, "\n");
-                continue;
             }
-            if (get_extern(*extern_head, s.argv[0]) == NULL) /* add the extern to the list if it's new */
+            else if (get_extern(*extern_head, s.argv[0]) == NULL) /* add the extern to the list if it's new */
                 add_extern(extern_head, s.argv[0]);
         }
+        
+        /* an instruction (mov/add/dec/...) or data, the label is checked first */
+        else if (s.label != NULL && get_extern(*extern_head, s.label) != NULL) { /* error if the label is an extern */
+            report(diag, EXTERN_AND_LABEL, LINE_NUMBER, line, s.label, s.label);
+            has_error = TRUE;
+        }
+        else if (s.label != NULL && get_label(*label_head, s.label) != NULL) { /* error if the label already exists */
+            report(diag, LABEL_EXISTS, LINE_NUMBER, line, s.label, NULL);
+            has_error = TRUE;
+        }
+        
         else if (type == INSTRUCTION) {  /* if the operation is an instruction (mov/add/dec/...) */
-            if (s.label != NULL) { /* if there is a label */
-
-                if (get_extern(*extern_head, s.label) != NULL) { /* error if the label is an extern */
-                    printf("line %d: error: \"%s\" can't be both extern and label\n", line_num, s.argv[0]);
-                    has_error = TRUE;
-                    free_sentence(s);
-                    line = strtok(NULL, "\n");
-                    continue;
-                }
-                if (get_label(*label_head, s.label) != NULL) { /* error if the label already exists */
-                    printf("line %d: error: Label Already Exists\n", line_num);
-                    has_error = TRUE;
-                    free_sentence(s);
-                    line = strtok(NULL, "\n");
-                    continue;
-                }
+            if (s.label != NULL)
                 add_label(label_head, s.label, IC, INSTRUCTION); /* add the label to the label list */
-            }
             IC += instruction_number_of_machine_words(s); /* update the IC */
         }
         else {
-            if (s.label != NULL) {
-            	if (get_extern(*extern_head, s.label) != NULL) { /* error if the label is an extern */
-                    printf("line %d: error: \"%s\" can't be both extern and label\n", line_num, s.label);
-                    has_error = TRUE;
-                    free_sentence(s);
-                    line = strtok(NULL, "\n");
-                    continue;
-                }
-                if (get_label(*label_head, s.label) != NULL) { /* if the label already exists */
-                    printf("line %d: error: Label Already Exists\n", line_num);
-                    has_error = TRUE;
-                    free_sentence(s);
-                    line = strtok(NULL, "\n");
-                    continue;
-                }
-                if (type != ENTRY && type != EXTERN)
-                    add_label(label_head, s.label, DC, type); /* labels to data are marked with - */
-            }
+            if (s.label != NULL)
+                add_label(label_head, s.label, DC, type); /* labels to data are marked with - */
             DC += data_number_of_machine_words(s, type); /* update the DC */
         }
+        
         free_sentence(s);
-        line = strtok(NULL, "\n");
+        line = next_line(&reader);
     }
+    end_lines(&reader);
+    free_line_map(&as_lines);
 
     /* add to all of the data labels the IC because they are supposed to come after the instructions and add 100 to every line because the memory starts at 100 */
     current = *label_head;
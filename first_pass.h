@@ -1,3 +1,9 @@
-int first_pass(char* as_text, char* am_text, int* IC_ptr, int* DC_ptr, label_node** label_head, extern_node** extern_head, entry_node** entry_head);
+int first_pass(char* as_text, char* am_text, int* IC_ptr, int* DC_ptr, label_node** label_head, extern_node** extern_head, entry_node** entry_head, diagnostics* diag);
 
 int number_of_machine_words_one_arg(arg_type arg);
+
+int instruction_number_of_machine_words(sentence s);
+
+int data_number_of_machine_words(sentence s, operation_type type);
+
+operation_type get_operation_type(char* op);
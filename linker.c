@@ -0,0 +1,337 @@
+/* the static linker (make linker), it links binary objects (all --object, see object_file.h) into one image:
+ *
+ *     linker [--jobs=N] [--output=name] <modules.obj>
+ *
+ * the code of every module is put one after the other from FIRST_ADDRESS, and the data of every module after all
+ * of the code. the words of a module that hold an address of its own (the relocatable words) are moved with it, and
+ * every external word is patched with the address of the entry of that name in some module (the entries of all of
+ * the modules are one global index). the modules are loaded and patched by N threads, every one of them only
+ * touches its own part of the image, so the time grows with the total size of the modules.
+ * the image is written as <name>.ob, <name>.ent and <name>.obj (an object with nothing left to relocate).
+ * returns 1 if a module can't be loaded, an entry is in two modules or an external isn't an entry anywhere */
+
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "sentences.h"
+#include "errors.h"
+#include "utils.h"
+#include "arguments.h"
+#include "data_nodes.h"
+#include "ob_file.h"
+#include "second_pass.h"
+#include "object_file.h"
+#include "object_writer.h"
+#include "alloc.h"
+
+#define ALLOC_SUBSYSTEM ALLOC_DRIVER
+
+
+#define DEFAULT_OUTPUT "linked"
+#define MAX_JOBS 64
+
+/* the highest address a word can hold (12 bits above the A,R,E bits) */
+#define MAX_WORD_ADDRESS 4095
+
+/* a module and where its code and data go in the image */
+typedef struct module {
+    char* filename;
+    object_file object;
+    int loaded;
+    int code_base;
+    int data_base;
+    int unresolved; /* how many of its externals aren't an entry anywhere */
+} module;
+
+/* what the threads share */
+typedef struct linker {
+    module* modules;
+    int count;
+    int next; /* the next module a thread takes */
+    pthread_mutex_t lock;
+    void (*work)(struct linker* l, module* m);
+    symbol_node* entries; /* every entry with its address in the image, the global index */
+    int* image; /* the value of every word of the image */
+} linker;
+
+
+/* the address in the image of an address of the module */
+int relocate(module* m, int address) {
+    int offset = address - (int)m->object.header->base_address;
+    if (offset < (int)m->object.header->code_words)
+        return m->code_base + offset;
+    return m->data_base + offset - (int)m->object.header->code_words;
+}
+
+/* returns whether every entry of the module is one of its words and every relocation one of its code words, so
+ * patch_module only writes into the part of the image of its own module (open_object checks it too) */
+int check_module(module* m) {
+    object_header* header = m->object.header;
+    unsigned int i;
+
+    for (i=0; i<header->entry_count; i++) {
+        unsigned int address = m->object.entries[i].address;
+        if (address < header->base_address || address - header->base_address >= header->code_words + header->data_words) {
+            printf("error: %s: the entry %s is outside of the module\n", m->filename, object_symbol_name(&m->object, &m->object.entries[i]));
+            return FALSE;
+        }
+    }
+    for (i=0; i<header->relocation_count; i++) {
+        unsigned int address = m->object.relocations[i].address;
+        if (address < header->base_address || address - header->base_address >= header->code_words) {
+            printf("error: %s: the external %s is outside of the code of the module\n", m->filename,
+                   object_symbol_name(&m->object, &m->object.relocations[i]));
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+void load_module(linker* l, module* m) {
+    m->loaded = open_object(m->filename, &m->object);
+}
+
+/* copies the words of the module into the image, moving its own addresses and patching its externals */
+void patch_module(linker* l, module* m) {
+    object_header* header = m->object.header;
+    int* code = l->image + (m->code_base - FIRST_ADDRESS);
+    int* data = l->image + (m->data_base - FIRST_ADDRESS);
+    unsigned int i;
+
+    for (i=0; i<header->code_words; i++) {
+        int value = m->object.words[i];
+        if ((value & 3) == RELOCATABLE_ARE) /* the address of a label of the module */
+            value = (relocate(m, value >> 2) << 2 | RELOCATABLE_ARE) & 0x3FFF;
+        code[i] = value;
+    }
+    for (i=0; i<header->data_words; i++)
+        data[i] = m->object.words[header->code_words + i];
+
+    for (i=0; i<header->relocation_count; i++) {
+        object_symbol* relocation = &m->object.relocations[i];
+        symbol_node* entry = get_symbol_node(l->entries, object_symbol_name(&m->object, relocation));
+
+        if (entry == NULL)
+            m->unresolved++;
+        else
+            l->image[relocate(m, relocation->address) - FIRST_ADDRESS] = (entry->address << 2 | RELOCATABLE_ARE) & 0x3FFF;
+    }
+}
+
+/* the threads take the modules one by one and do the work on them */
+void* worker(void* argument) {
+    linker* l = (linker*)argument;
+
+    while (1) {
+        int i;
+
+        pthread_mutex_lock(&l->lock);
+        i = l->next++;
+        pthread_mutex_unlock(&l->lock);
+        if (i >= l->count)
+            return NULL;
+        l->work(l, &l->modules[i]);
+    }
+}
+
+/* does the work on every module with the given amount of threads */
+void run_in_parallel(linker* l, int jobs, void (*work)(linker* l, module* m)) {
+    pthread_t threads[MAX_JOBS];
+    int i;
+
+    l->next = 0;
+    l->work = work;
+    if (jobs > l->count)
+        jobs = l->count;
+    for (i=1; i<jobs; i++)
+        if (pthread_create(&threads[i], NULL, worker, l) != 0) {
+            printf("error: can't start a thread\n");
+            exit(1);
+        }
+    worker(l); /* this thread is one of them */
+    for (i=1; i<jobs; i++)
+        pthread_join(threads[i], NULL);
+}
+
+/* returns the name of the module the entry is in (other than the one given) */
+char* entry_module(linker* l, char* name, module* not_this) {
+    int i;
+    for (i=0; i<l->count; i++)
+        if (&l->modules[i] != not_this && find_object_entry(&l->modules[i].object, name) != NULL)
+            return l->modules[i].filename;
+    return "?";
+}
+
+/* writes <output>.ob, <output>.ent (if there are entries) and <output>.obj */
+void write_image(linker* l, char* output, int IC, int DC) {
+    char filename[256];
+    text_buffer ent_text;
+    symbol_node* entry;
+    ob_writer* writer;
+    int fd;
+    int i;
+
+    writer = (ob_writer*)MALLOC(sizeof(ob_writer));
+    if (writer == NULL) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    sprintf(filename, "%.200s.ob", output);
+    fd = create_ob_file(filename, IC, DC);
+    start_ob_writer(writer, fd, IC, DC);
+    for (i=0; i<IC+DC; i++)
+        write_ob_value(writer, FIRST_ADDRESS + i, l->image[i]);
+    flush_ob_writer(writer);
+    close_ob_file(fd);
+    FREE(writer);
+
+    start_text(&ent_text);
+    for (entry = l->entries; entry != NULL; entry = entry->next) {
+        char line[128];
+        int length = strlen(entry->name);
+        sprintf(line, "%.100s%*s%04d\n", entry->name, length>9 ? 1 : 10-length, "", entry->address);
+        add_text(&ent_text, line);
+    }
+    sprintf(filename, "%.200s.ent", output);
+    if (ent_text.text != NULL)
+        write_file(filename, ent_text.text);
+    else
+        remove(filename);
+    FREE(ent_text.text);
+
+    sprintf(filename, "%.200s.obj", output);
+    write_object_file(filename, IC, DC, l->image, l->entries, NULL);
+}
+
+int main(int argc, char* argv[]) {
+    linker l;
+    char* output;
+    long relocations;
+    int jobs;
+    int failed;
+    int IC;
+    int DC;
+    int address;
+    int i;
+
+    output = DEFAULT_OUTPUT;
+    jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    for (i = 1; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+        if (strncmp(argv[i], "--jobs=", 7) == 0 && atoi(argv[i] + 7) > 0)
+            jobs = atoi(argv[i] + 7);
+        else if (strncmp(argv[i], "--output=", 9) == 0 && argv[i][9] != '\0')
+            output = argv[i] + 9;
+        else {
+            printf("error: unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    if (i == argc) {
+        printf("usage: linker [--jobs=N] [--output=name] <modules.obj>\n");
+        return 1;
+    }
+    if (jobs < 1)
+        jobs = 1;
+    if (jobs > MAX_JOBS)
+        jobs = MAX_JOBS;
+
+    l.count = argc - i;
+    l.modules = (module*)CALLOC(l.count, sizeof(module));
+    if (l.modules == NULL) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    for (address = 0; address < l.count; address++)
+        l.modules[address].filename = argv[i + address];
+    pthread_mutex_init(&l.lock, NULL);
+    l.entries = NULL;
+    l.image = NULL;
+
+    /* load every module */
+    run_in_parallel(&l, jobs, load_module);
+    failed = 0;
+    for (i=0; i<l.count; i++)
+        if (!l.modules[i].loaded) {
+            printf("error: %s: %s\n", l.modules[i].filename, l.modules[i].object.error);
+            failed++;
+        }
+        else if (!check_module(&l.modules[i]))
+            failed++;
+
+    if (failed == 0) {
+        /* lay out the code of every module and then the data of every module */
+        address = FIRST_ADDRESS;
+        for (i=0; i<l.count; i++) {
+            l.modules[i].code_base = address;
+            address += l.modules[i].object.header->code_words;
+        }
+        IC = address - FIRST_ADDRESS;
+        for (i=0; i<l.count; i++) {
+            l.modules[i].data_base = address;
+            address += l.modules[i].object.header->data_words;
+        }
+        DC = address - FIRST_ADDRESS - IC;
+
+        /* the global index of the entries */
+        relocations = 0;
+        for (i=0; i<l.count; i++) {
+            module* m = &l.modules[i];
+            unsigned int j;
+
+            relocations += m->object.header->relocation_count;
+            for (j=0; j<m->object.header->entry_count; j++) {
+                char* name = object_symbol_name(&m->object, &m->object.entries[j]);
+
+                if (get_symbol_node(l.entries, name) == NULL)
+                    add_symbol_node(&l.entries, name, relocate(m, m->object.entries[j].address));
+                else if (find_object_entry(&m->object, name) == &m->object.entries[j]) { /* not a second .entry in the module */
+                    printf("error: %s is an entry of both %s and %s\n", name, entry_module(&l, name, m), m->filename);
+                    failed++;
+                }
+            }
+        }
+    }
+
+    if (failed == 0) {
+        l.image = (int*)MALLOC((IC + DC + 1) * sizeof(int));
+        if (l.image == NULL) {
+            printf("Memory allocation failed\n");
+            exit(1);
+        }
+        run_in_parallel(&l, jobs, patch_module);
+
+        for (i=0; i<l.count; i++) {
+            module* m = &l.modules[i];
+            unsigned int j;
+
+            for (j=0; j<m->object.header->relocation_count && m->unresolved > 0; j++) {
+                char* name = object_symbol_name(&m->object, &m->object.relocations[j]);
+                if (get_symbol_node(l.entries, name) == NULL) {
+                    printf("error: %s: %s isn't an entry of any module\n", m->filename, name);
+                    failed++;
+                    break; /* once for every module */
+                }
+            }
+        }
+    }
+
+    if (failed == 0) {
+        if (FIRST_ADDRESS + IC + DC - 1 > MAX_WORD_ADDRESS)
+            printf("warning: the image ends at %d, the addresses above %d don't fit in a word\n",
+                   FIRST_ADDRESS + IC + DC - 1, MAX_WORD_ADDRESS);
+        write_image(&l, output, IC, DC);
+        printf("linked %d modules into %s: %d code words, %d data words, %d entries, %ld externals patched\n",
+               l.count, output, IC, DC, count_symbol_nodes(l.entries), relocations);
+    }
+
+    for (i=0; i<l.count; i++)
+        close_object(&l.modules[i].object);
+    free_symbol_nodes(l.entries);
+    FREE(l.image);
+    FREE(l.modules);
+    pthread_mutex_destroy(&l.lock);
+    return failed > 0;
+}
@@ -1,37 +1,127 @@
+#define _POSIX_C_SOURCE 200112L
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include "sentences.h"
+#include "errors.h"
 #include "data_nodes.h"
 #include "arguments.h"
-#include "first_pass.h"
-#include "second_pass.h"
-#include "sentences.h"
 #include "utils.h"
 #include "preprocessor.h"
+#include "assembler.h"
+#include "ob_file.h"
+#include "second_pass.h"
+#include "object_file.h"
+#include "object_writer.h"
+#include "optimizer.h"
+#include "daemon.h"
+#include "cache.h"
+#include "watch.h"
+#include "check.h"
+#include "trace.h"
+#include "counters.h"
+#include "stats.h"
+#include "alloc.h"
+
+#define ALLOC_SUBSYSTEM ALLOC_DRIVER
+
+
+
+/* the directory of the build cache, NULL when it isn't used (all --cache[=dir]) */
+char* cache_dir = NULL;
+
+/* the messages of every file are written as one line of json (all --diagnostics=json) */
+int json_diagnostics = FALSE;
+
+/* a file stops compiling after this many errors, 0 for no limit (all --max-errors=N) */
+int max_errors = 0;
+
+/* the stats of every file are printed (all --stats) */
+int show_stats = FALSE;
+
+/* the stats are printed as json (all --stats=json) */
+int json_stats = FALSE;
+
+/* a binary object is written next to every .ob file (all --object, see object_file.h) */
+int binary_object = FALSE;
 
+/* the file the trace is written to, NULL when there is no trace (all --trace <file>) */
+char* trace_filename = NULL;
+
+/* the .am text goes through the peephole optimizer before the passes (all --optimize, see optimizer.c) */
+int optimize_code = FALSE;
+
+/* the engine and whether the symbols are collected (all --engine=reference and --object) */
+pass_options encoding = {FALSE, FALSE};
+
+
+/* writes the file <filename>.<extension> */
+void write_output(char* filename, char* extension, char* text) {
+    char output_filename[103];
+    sprintf(output_filename, "%.96s.%s", filename, extension);
+    write_file(output_filename, text);
+}
+
+/* creates the outputs of the given file from the build cache, returns FALSE if they aren't in it.
+ * files whose contents didn't change are left untouched */
+int compile_cached(char* filename, unsigned long hash) {
+    cached_outputs outputs;
+    
+    if (!load_cached(cache_dir, hash, &outputs))
+        return FALSE;
+    
+    if (outputs.messages != NULL)
+        printf("%s", outputs.messages);
+    write_output(filename, "am", outputs.am);
+    write_output(filename, "ob", outputs.ob);
+    if (outputs.ent != NULL)
+        write_output(filename, "ent", outputs.ent);
+    if (outputs.ext != NULL)
+        write_output(filename, "ext", outputs.ext);
+    
+    printf("compilation succeeded!\n\n");
+    free_cached(&outputs);
+    return TRUE;
+}
+
+/* puts the outputs of a successful compilation in the build cache */
+void cache_outputs(char* ob_filename, unsigned long hash, diagnostics* diag, char* am_text, second_pass_result* result) {
+    cached_outputs outputs;
+    source_file ob_file;
+    
+    if (!read_file(ob_filename, &ob_file))
+        return;
+    
+    outputs.messages = json_diagnostics ? diagnostics_json(diag) : diagnostics_text(diag);
+    outputs.am = am_text;
+    outputs.ob = ob_file.text;
+    outputs.ent = result->ent_file;
+    outputs.ext = result->ext_file;
+    store_cached(cache_dir, hash, &outputs);
+    
+    FREE(outputs.messages);
+    close_file(&ob_file);
+}
 
 
 /* this function compiles the given file (creates the .ob, .ent and .ext files) */
 void compile(char* filename) {
     char filename_with_extension[103];
     
+    source_file as_file;
     char* as_text;
     char* am_text;
     
     char am_filename[103];
+    char ob_filename[103];
     
-    label_node* label_head;
-    extern_node* extern_head;
-    entry_node* entry_head;
-    
-    char* temp;
-    
-    int IC;
-    int DC;
-    
-    int has_error;
-    
+    diagnostics diag;
+    char options[128];
+    unsigned long hash;
     second_pass_result* result;
+    optimizer_report report;
+    char* optimized_text;
 	
     printf("\ncompiling %s.as\n", filename);
     
@@ -39,73 +129,81 @@ void compile(char* filename) {
     strcpy(filename_with_extension, filename);
     strcat(filename_with_extension, ".as");
     
-    /* read the .as file */
-    as_text = read_file(filename_with_extension);
-    
-    if (as_text==NULL) {
+    /* read the .as file (mapped into memory when possible, none of the passes modify it) */
+    if (!read_file(filename_with_extension, &as_file)) {
     	printf("%s.as not found\n\n", filename);
     	return;
     }
+    as_text = as_file.text;
+    
+    /* an unchanged file is taken from the build cache (which doesn't keep binary objects) */
+    hash = 0;
+    if (cache_dir != NULL && !binary_object) {
+        sprintf(options, "%s%s %.100s", json_diagnostics ? "json" : "text", optimize_code ? " optimize" : "", filename_with_extension);
+        hash = hash_source(options, as_file.text, as_file.length);
+        if (compile_cached(filename, hash)) {
+            close_file(&as_file);
+            return;
+        }
+    }
+    
+    /* the messages are collected and written at once when the file is done */
+    start_diagnostics(&diag, filename_with_extension, max_errors);
 	
 	/* create am file */
-    am_text = create_am_file(as_text);
+    am_text = create_am_file(as_text, &diag);
     if (am_text == NULL) {
+        write_diagnostics(&diag, json_diagnostics, stdout);
         printf("an error in the preprocessor prevented creation of .am file\n\n");
-        free(as_text);
+        free_diagnostics(&diag);
+        close_file(&as_file);
         return;
     }
     strcpy(am_filename, filename);
     strcat(am_filename, ".am");
     write_file(am_filename, am_text);
     
-    /* the labe, extern and entry lists */
-    label_head = NULL;
-    extern_head = NULL;
-    entry_head = NULL;
-
-    /* in the first pass we use strtok which modifies the text so we copy it to another place so we can use am_text again */
-    temp = NULL;
-    temp = merge_strings(temp, am_text);
-	
-    IC=0;
-    DC=0;
-	
-    has_error = first_pass(as_text, temp, &IC, &DC, &label_head, &extern_head, &entry_head);
+    strcpy(ob_filename, filename);
+    strcat(ob_filename, ".ob");
     
-    /* free allocated memory for temp */
-    free(temp);
-	
-    result = second_pass(as_text, am_text, IC, DC, has_error, &label_head, &extern_head, &entry_head);
+    /* the .am file stays the output of the preprocessor, only the passes see the optimized text */
+    optimized_text = NULL;
+    if (optimize_code)
+        optimized_text = optimize_source(am_text, &report);
+    
+    result = assemble(as_text, optimized_text != NULL ? optimized_text : am_text, ob_filename, NULL, NULL, &encoding, &diag);
+    write_diagnostics(&diag, json_diagnostics, stdout);
+    FREE(optimized_text);
     
     if (result != NULL) { /* if the code has no erros */
+    
+        if (cache_dir != NULL && !binary_object)
+            cache_outputs(ob_filename, hash, &diag, am_text, result);
+
+        if (binary_object) {
+            /* create the .obj file */
+            char obj_filename[103];
+            sprintf(obj_filename, "%.96s.obj", filename);
+            write_object_file(obj_filename, result->IC, result->DC, result->words, result->entries, result->externals);
+        }
+        FREE(result->words);
+        free_symbol_nodes(result->entries);
+        free_symbol_nodes(result->externals);
 
         if (result->ent_file != NULL) {
             /* create the .ent file */
-            char ent_filename[103];
-            strcpy(ent_filename, filename);
-            strcat(ent_filename, ".ent");
-            write_file(ent_filename, result->ent_file);
-            free(result->ent_file);
+            write_output(filename, "ent", result->ent_file);
+            FREE(result->ent_file);
         }
 
         if (result->ext_file != NULL) {
             /* create the .ext file */
-            char ext_filename[103];
-            strcpy(ext_filename, filename);
-            strcat(ext_filename, ".ext");
-            write_file(ext_filename, result->ext_file);
-            free(result->ext_file);
+            write_output(filename, "ext", result->ext_file);
+            FREE(result->ext_file);
         }
 
-        /* create the .ob file */
-        if (result->machine_code != NULL) {
-            /* create the .ext file */
-            char ob_filename[103];
-            strcpy(ob_filename, filename);
-            strcat(ob_filename, ".ob");
-            write_file(ob_filename, result->machine_code);
-            free(result->machine_code);
-        }
+        if (optimize_code)
+            print_optimizer_report(stdout, &report);
         printf("compilation succeeded!\n\n");
 	} 
 	else 
@@ -113,17 +211,154 @@ void compile(char* filename) {
 	
 	/* free allocated memory */
 	
-    free(as_text);
-    free(am_text);
-    free(result);
+    free_diagnostics(&diag);
+    close_file(&as_file);
+    FREE(am_text);
+    FREE(result);
+}
+
+
+/* this function compiles the source given in the standard input without creating any files.
+ * the .ob, .ent and .ext outputs are written to out as sections (see write_section in utils.c) in that order,
+ * nothing is written to out if there is an error. returns whether the compilation succeeded */
+int compile_stream(FILE* out) {
+    source_file as_file;
+    char* am_text;
+    char* ob_image;
+    second_pass_result* result;
+    diagnostics diag;
+    optimizer_report report;
+    char* optimized_text;
+    
+    fprintf(stderr, "\ncompiling standard input\n");
+    
+    if (!read_fd(0, &as_file)) {
+        fprintf(stderr, "couldn't read the standard input\n\n");
+        return FALSE;
+    }
+    
+    start_diagnostics(&diag, "<stdin>", max_errors);
+    
+    /* the .am text is only needed in memory */
+    am_text = create_am_file(as_file.text, &diag);
+    if (am_text == NULL) {
+        write_diagnostics(&diag, json_diagnostics, stderr);
+        free_diagnostics(&diag);
+        fprintf(stderr, "an error in the preprocessor prevented creation of .am file\n\n");
+        close_file(&as_file);
+        return FALSE;
+    }
+    
+    optimized_text = NULL;
+    if (optimize_code)
+        optimized_text = optimize_source(am_text, &report);
+    
+    ob_image = NULL;
+    result = assemble(as_file.text, optimized_text != NULL ? optimized_text : am_text, NULL, &ob_image, NULL, &encoding, &diag);
+    write_diagnostics(&diag, json_diagnostics, stderr);
+    free_diagnostics(&diag);
+    FREE(optimized_text);
+    
+    if (result != NULL) {
+        write_section(out, "ob", ob_image);
+        write_section(out, "ent", result->ent_file);
+        write_section(out, "ext", result->ext_file);
+        fflush(out);
+        
+        FREE(ob_image);
+        FREE(result->ent_file);
+        FREE(result->ext_file);
+        FREE(result->words);
+        free_symbol_nodes(result->entries);
+        free_symbol_nodes(result->externals);
+        
+        if (optimize_code)
+            print_optimizer_report(stderr, &report);
+        fprintf(stderr, "compilation succeeded!\n\n");
+    }
+    else
+        fprintf(stderr, "compilation failed\n\n");
+    
+    close_file(&as_file);
+    FREE(am_text);
     
-    free_labels(label_head);
-    free_externs(extern_head);
-    free_entrys(entry_head);
+    if (result == NULL)
+        return FALSE;
+    FREE(result);
+    return TRUE;
+}
+
+
+/* reads the options that come before the filenames, from argv[first] on:
+ * "--cache[=dir]" reuses the outputs of files that didn't change,
+ * "--diagnostics=json" writes the messages of every file as one line of json ("--diagnostics=text" is the default),
+ * "--max-errors=N" stops compiling a file after N errors,
+ * "--object" also writes a binary object (<name>.obj) of every file that compiles (see object_file.h),
+ * "--optimize" rewrites wasteful instructions into shorter ones before the first pass and reports the words saved (see optimizer.c),
+ * "--engine=reference" encodes the words with the reference engine ("--engine=fast" is the default, see second_pass.c),
+ * "--stats" prints the time of every phase and what it went through to the standard error ("--stats=json" as json),
+ * "--counters" prints the cycles, instructions, misses, page faults and context switches of every phase to the standard error,
+ * "--alloc-stats" prints what every subsystem and the busiest call sites allocated to the standard error,
+ * "--trace <file>" writes a timeline of the files, the phases and the writes (see trace.h).
+ * returns the index of the first filename, or -1 if an option is unknown */
+int read_options(int argc, char* argv[], int first) {
+    int i;
+    
+    for (i=first; i<argc && strncmp(argv[i], "--", 2)==0; i++) {
+        if (strcmp(argv[i], "--cache")==0)
+            cache_dir = DEFAULT_CACHE_DIR;
+        else if (strncmp(argv[i], "--cache=", 8)==0)
+            cache_dir = argv[i] + 8;
+        else if (strcmp(argv[i], "--diagnostics=json")==0)
+            json_diagnostics = TRUE;
+        else if (strcmp(argv[i], "--diagnostics=text")==0)
+            json_diagnostics = FALSE;
+        else if (strncmp(argv[i], "--max-errors=", 13)==0 && is_integer(argv[i] + 13) && atoi(argv[i] + 13) >= 0)
+            max_errors = atoi(argv[i] + 13);
+        else if (strcmp(argv[i], "--object")==0) {
+            binary_object = TRUE;
+            encoding.collect_symbols = TRUE;
+        }
+        else if (strcmp(argv[i], "--optimize")==0)
+            optimize_code = TRUE;
+        else if (strcmp(argv[i], "--engine=reference")==0)
+            encoding.reference_engine = TRUE;
+        else if (strcmp(argv[i], "--engine=fast")==0)
+            encoding.reference_engine = FALSE;
+#ifndef NO_STATS
+        else if (strcmp(argv[i], "--stats")==0 || strcmp(argv[i], "--stats=json")==0) {
+            stats_enabled = TRUE;
+            show_stats = TRUE;
+            json_stats = (argv[i][7] == '=');
+        }
+        else if (strcmp(argv[i], "--counters")==0) {
+            stats_enabled = TRUE; /* the counters are split between the phases with the stats */
+            start_counters();
+        }
+#endif
+#ifndef NO_ALLOC_TAGS
+        else if (strcmp(argv[i], "--alloc-stats")==0)
+            alloc_profiling = TRUE; /* nothing was allocated yet */
+#endif
+#ifndef NO_TRACE
+        else if (strcmp(argv[i], "--trace")==0 && i + 1 < argc) {
+            trace_filename = argv[++i];
+            start_tracing();
+        }
+#endif
+        else {
+            printf("error: unknown option %s\n", argv[i]);
+            return -1;
+        }
+    }
+    return i;
 }
 
 
 int main(int argc, char* argv[]) {
+    compile_stats total; /* the stats of all of the files */
+    int files;
+    int failed;
     int i;
     
     if (argc==1) {
@@ -131,9 +366,132 @@ int main(int argc, char* argv[]) {
     	return 1;
     }
     
-    for (i=1; i<argc; i++)  /* go through every given filename */
+    /* "--serve <socket> [workers]" runs the assembler server */
+    if (strcmp(argv[1], "--serve")==0) {
+        if (argc < 3) {
+            printf("error: no socket given\n");
+            return 1;
+        }
+        return serve(argv[2], argc > 3 ? atoi(argv[3]) : DEFAULT_WORKERS);
+    }
+    
+    /* "--client <socket> <files>" compiles the files on a running server */
+    if (strcmp(argv[1], "--client")==0) {
+        if (argc < 4) {
+            printf("error: no files given\n");
+            return 1;
+        }
+        return run_client(argv[2], argc - 3, argv + 3);
+    }
+    
+    /* "--client-bench <socket> <file.as> [requests]" measures the latency of the server */
+    if (strcmp(argv[1], "--client-bench")==0) {
+        if (argc < 4) {
+            printf("error: no file given\n");
+            return 1;
+        }
+        return run_client_benchmark(argv[2], argv[3], argc > 4 ? atoi(argv[4]) : 0);
+    }
+    
+    /* "--check [options] <files>" only reports the errors of the files, nothing is written */
+    if (strcmp(argv[1], "--check")==0) {
+        i = read_options(argc, argv, 2);
+        if (i < 0)
+            return 1;
+        if (stats_enabled || alloc_profiling) { /* the files are checked in parallel, the stats are only counted for one file at a time */
+            printf("error: --stats, --counters and --alloc-stats can't be used with --check\n");
+            return 1;
+        }
+        if (i >= argc) {
+            printf("error: no files given\n");
+            return 1;
+        }
+        failed = check_files(argc - i, argv + i, json_diagnostics, max_errors);
+        if (trace_filename != NULL && !write_trace(trace_filename))
+            return 1;
+        return failed;
+    }
+    
+    /* "--watch <dir>" re-assembles the .as files of the directory whenever they change */
+    if (strcmp(argv[1], "--watch")==0) {
+        if (argc < 3) {
+            printf("error: no directory given\n");
+            return 1;
+        }
+        return watch_directory(argv[2]);
+    }
+    
+    /* the options come before the filenames (see read_options) */
+    i = read_options(argc, argv, 1);
+    if (i < 0)
+        return 1;
+    
+    /* "-" assembles the standard input into the standard output */
+    if (i==argc-1 && strcmp(argv[i], "-")==0) {
+        FILE* out;
+        int succeeded;
+        
+        /* anything printed with printf goes to the standard error,
+         * and the sections are written to a copy of the original standard output */
+        out = fdopen(dup(1), "w");
+        if (out == NULL) {
+            perror("dup");
+            return 1;
+        }
+        dup2(2, 1);
+        
+        start_stats();
+        TRACE_BEGIN("compile", "<stdin>");
+        succeeded = compile_stream(out);
+        TRACE_END();
+        
+        fflush(stdout);
+        if (stats_enabled)
+            stop_stats();
+        if (show_stats)
+            print_stats("<stdin>", 1, &stats, json_stats, stderr);
+        if (counters_enabled) {
+            print_counters(1, &stats, stderr);
+            stop_counters();
+        }
+        if (alloc_profiling)
+            print_alloc_report(stderr);
+        if (trace_filename != NULL)
+            write_trace(trace_filename);
+        fclose(out);
+        return succeeded ? 0 : 1;
+    }
+    
+    memset(&total, 0, sizeof(total));
+    files = argc - i;
+    
+    for (; i<argc; i++) { /* go through every given filename */
+        start_stats();
+        TRACE_BEGIN("compile", argv[i]);
     	compile(argv[i]); /* compile each every given file */
+        TRACE_END();
+    	
+        if (stats_enabled) {
+            char name[103];
+            sprintf(name, "%.98s.as", argv[i]);
+            stop_stats();
+            fflush(stdout);
+            if (show_stats)
+                print_stats(name, 1, &stats, json_stats, stderr);
+            add_stats(&total, &stats);
+        }
+    }
+    
+    if (show_stats)
+        print_stats(NULL, files, &total, json_stats, stderr);
+    if (counters_enabled) {
+        print_counters(files, &total, stderr);
+        stop_counters();
+    }
+    if (alloc_profiling)
+        print_alloc_report(stderr);
+    if (trace_filename != NULL && !write_trace(trace_filename))
+        return 1;
 
     return 0;
 }
-
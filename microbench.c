@@ -0,0 +1,341 @@
+/* the microbenchmarks of the hot helpers (make microbench):
+ *
+ *     microbench [--json] [--repetitions=N] [names]
+ *
+ * every helper runs over a fixed set of inputs like the ones the passes give it. a repetition runs it enough times
+ * to take at least MIN_REPETITION_MICROSECONDS, the first WARMUP_REPETITIONS are thrown away and the time of one
+ * call is reported as the fastest, median, 90th and 99th percentile of the repetitions.
+ * only the named benchmarks run when names are given */
+
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "sentences.h"
+#include "errors.h"
+#include "utils.h"
+#include "arguments.h"
+#include "data_nodes.h"
+#include "first_pass.h"
+#include "ob_file.h"
+#include "second_pass.h"
+#include "alloc.h"
+
+#define ALLOC_SUBSYSTEM ALLOC_DRIVER
+
+
+#define DEFAULT_REPETITIONS 25
+#define WARMUP_REPETITIONS 3
+#define MIN_REPETITION_MICROSECONDS 2000
+
+/* the amount of labels and defines in the lists the lookups go through */
+#define LABEL_COUNT 1000
+#define DEFINE_COUNT 100
+
+/* how many lines are appended to one string in the merge_strings benchmark */
+#define MERGED_LINES 1000
+
+
+/* lines like the ones of a real file (see a.as), every operand refers to a name in the lists */
+char* lines[] = {
+    "MAIN:\tmov r3, D7[2]",
+    "LOOP:\tjmp L10",
+    "\tprn #-5",
+    "\tmov D3[5], D4[2]",
+    "\tsub r1, r4",
+    "\tcmp L5, #48",
+    "\tbne X1",
+    "L1:\tinc L3",
+    "\tlea D2, r6",
+    "\tadd #120, L499",
+    "\tclr D1[0]",
+    "\tred r2",
+    "\trts",
+    "END:\thlt",
+    "STR:\t.string \"abcdef\"",
+    "LIST:\t.data 6, -9, 15, 22"
+};
+
+#define LINE_COUNT 16
+
+char* arguments[] = {"r3", "#-5", "D7[2]", "L10", "X1", "#48", "r7", "D1[0]", "\"abcdef\"", "22", "L499", "r0"};
+
+#define ARGUMENT_COUNT 12
+
+
+sentence sentences[LINE_COUNT];
+label_node* labels;
+define_node* defines;
+extern_node* externs;
+entry_node* entries;
+char* label_names[LABEL_COUNT * 2]; /* every label and as many names that aren't labels */
+char* define_names[DEFINE_COUNT * 2];
+char* binary_words[256];
+
+/* the results are added here so that the calls can't be optimized away */
+volatile long sink;
+
+
+void bench_to_sentence(long iterations) {
+    long i;
+    for (i = 0; i < iterations; i++) {
+        sentence s = to_sentence(lines[i % LINE_COUNT]);
+        sink += s.argc;
+        free_sentence(s);
+    }
+}
+
+void bench_get_arg_type(long iterations) {
+    long i;
+    for (i = 0; i < iterations; i++)
+        sink += get_arg_type(arguments[i % ARGUMENT_COUNT]);
+}
+
+void bench_find_error(long iterations) {
+    long i;
+    for (i = 0; i < iterations; i++)
+        sink += find_error(sentences[i % LINE_COUNT]) != NULL;
+}
+
+void bench_get_label(long iterations) {
+    long i;
+    for (i = 0; i < iterations; i++)
+        sink += get_label(labels, label_names[i % (LABEL_COUNT * 2)]) != NULL;
+}
+
+void bench_get_define(long iterations) {
+    long i;
+    for (i = 0; i < iterations; i++)
+        sink += get_define(defines, define_names[i % (DEFINE_COUNT * 2)]) != NULL;
+}
+
+void bench_instruction_words(long iterations) {
+    long i;
+    for (i = 0; i < iterations; i++) {
+        sentence s = sentences[i % (LINE_COUNT - 2)]; /* the last two lines are data */
+        sink += instruction_number_of_machine_words(s);
+    }
+}
+
+void bench_to_words(long iterations) {
+    long i;
+    for (i = 0; i < iterations; i++) {
+        char* words = to_words(sentences[i % LINE_COUNT], &labels, &externs, &entries, &defines);
+        sink += words != NULL;
+        FREE(words);
+    }
+}
+
+void bench_decimal_to_binary(long iterations) {
+    long i;
+    for (i = 0; i < iterations; i++) {
+        char* word = decimal_to_n_bit_binary((int)(i % 2001) - 1000, (i & 1) ? 12 : 14);
+        sink += word[0];
+        FREE(word);
+    }
+}
+
+void bench_to_encrypted(long iterations) {
+    char result[8];
+    long i;
+    for (i = 0; i < iterations; i++) {
+        to_encrypted_four_bit(binary_words[i % 256], result);
+        sink += result[0];
+    }
+}
+
+/* one call is one appended line, a string is built out of MERGED_LINES lines like the words of a file */
+void bench_merge_strings(long iterations) {
+    char* text = NULL;
+    long i;
+    for (i = 0; i < iterations; i++) {
+        text = merge_strings(text, "%*#!%*#\n");
+        if ((i + 1) % MERGED_LINES == 0) {
+            sink += text[0];
+            FREE(text);
+            text = NULL;
+        }
+    }
+    FREE(text);
+}
+
+
+typedef struct benchmark {
+    char* name;
+    void (*run)(long iterations);
+} benchmark;
+
+benchmark benchmarks[] = {
+    {"to_sentence", bench_to_sentence},
+    {"get_arg_type", bench_get_arg_type},
+    {"find_error", bench_find_error},
+    {"get_label", bench_get_label},
+    {"get_define", bench_get_define},
+    {"instruction_number_of_machine_words", bench_instruction_words},
+    {"to_words", bench_to_words},
+    {"decimal_to_n_bit_binary", bench_decimal_to_binary},
+    {"to_encrypted_four_bit", bench_to_encrypted},
+    {"merge_strings", bench_merge_strings}
+};
+
+#define BENCHMARK_COUNT 10
+
+
+/* builds the inputs of the benchmarks */
+void prepare_inputs() {
+    char name[32];
+    int i;
+    int j;
+
+    for (i = 0; i < LINE_COUNT; i++)
+        sentences[i] = to_sentence(lines[i]);
+
+    labels = NULL;
+    defines = NULL;
+    externs = NULL;
+    entries = NULL;
+    for (i = 0; i < LABEL_COUNT; i++) {
+        sprintf(name, "%c%d", "LD"[i % 2], i / 2);
+        add_label(&labels, name, FIRST_ADDRESS + i, i % 2 == 0 ? INSTRUCTION : DATA);
+    }
+    for (i = 0; i < LABEL_COUNT; i++) { /* half of the lookups find the label, anywhere in the list */
+        sprintf(name, "%c%d", "LD"[i % 2], (i * 7919 % LABEL_COUNT) / 2);
+        label_names[2 * i] = STRDUP(name);
+        sprintf(name, "M%d", i);
+        label_names[2 * i + 1] = STRDUP(name);
+    }
+    for (i = 0; i < DEFINE_COUNT; i++) {
+        sprintf(name, "k%d", i);
+        add_define(&defines, name, i);
+        sprintf(name, "k%d", i * 37 % DEFINE_COUNT);
+        define_names[2 * i] = STRDUP(name);
+        sprintf(name, "n%d", i);
+        define_names[2 * i + 1] = STRDUP(name);
+    }
+    add_extern(&externs, "X1");
+    add_entry(&entries, "L1");
+
+    for (i = 0; i < 256; i++) {
+        binary_words[i] = (char*)MALLOC(15);
+        if (binary_words[i] == NULL) {
+            printf("Memory allocation failed\n");
+            exit(1);
+        }
+        for (j = 0; j < 14; j++)
+            binary_words[i][j] = ((i * 2654435761UL) >> (j + 8)) & 1 ? '1' : '0';
+        binary_words[i][14] = '\0';
+    }
+}
+
+double now_in_nanoseconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e9 + now.tv_nsec;
+}
+
+int compare_doubles(const void* a, const void* b) {
+    double x = *(double*)a;
+    double y = *(double*)b;
+    return (x > y) - (x < y);
+}
+
+/* the value at the percent of the sorted values */
+double percentile(double* values, int count, int percent) {
+    return values[(int)((count - 1) * percent / 100.0 + 0.5)];
+}
+
+/* runs the benchmark and puts the sorted nanoseconds of one call in every repetition into times */
+long measure(benchmark* b, double* times, int repetitions) {
+    long iterations;
+    double start;
+    int i;
+
+    /* find how many calls take long enough to be timed */
+    for (iterations = 1; ; iterations *= 2) {
+        start = now_in_nanoseconds();
+        b->run(iterations);
+        if (now_in_nanoseconds() - start >= MIN_REPETITION_MICROSECONDS * 1000.0)
+            break;
+    }
+
+    for (i = 0; i < WARMUP_REPETITIONS; i++)
+        b->run(iterations);
+
+    for (i = 0; i < repetitions; i++) {
+        start = now_in_nanoseconds();
+        b->run(iterations);
+        times[i] = (now_in_nanoseconds() - start) / iterations;
+    }
+    qsort(times, repetitions, sizeof(double), compare_doubles);
+    return iterations;
+}
+
+/* returns whether the benchmark was named (or no names were given) */
+int is_selected(char* name, int namec, char* names[]) {
+    int i;
+    for (i = 0; i < namec; i++)
+        if (strcmp(names[i], name) == 0)
+            return TRUE;
+    return namec == 0;
+}
+
+int main(int argc, char* argv[]) {
+    double* times;
+    int repetitions;
+    int json;
+    int printed;
+    int first_name;
+    int i;
+
+    repetitions = DEFAULT_REPETITIONS;
+    json = FALSE;
+    for (i = 1; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+        if (strcmp(argv[i], "--json") == 0)
+            json = TRUE;
+        else if (strncmp(argv[i], "--repetitions=", 14) == 0 && atoi(argv[i] + 14) > 0)
+            repetitions = atoi(argv[i] + 14);
+        else {
+            printf("error: unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+    first_name = i;
+
+    prepare_inputs();
+    times = (double*)MALLOC(repetitions * sizeof(double));
+    if (times == NULL) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+
+    if (json)
+        printf("{\"repetitions\": %d, \"benchmarks\": [", repetitions);
+    else
+        printf("%-36s %12s %10s %10s %10s %10s\n", "ns per call", "calls", "min", "median", "p90", "p99");
+
+    printed = 0;
+    for (i = 0; i < BENCHMARK_COUNT; i++) {
+        benchmark* b = &benchmarks[i];
+        long iterations;
+
+        if (!is_selected(b->name, argc - first_name, argv + first_name))
+            continue;
+
+        iterations = measure(b, times, repetitions);
+        if (json)
+            printf("%s\n  {\"name\": \"%s\", \"calls\": %ld, \"min_ns\": %.2f, \"median_ns\": %.2f, \"p90_ns\": %.2f, \"p99_ns\": %.2f}",
+                   printed > 0 ? "," : "", b->name, iterations, times[0], percentile(times, repetitions, 50),
+                   percentile(times, repetitions, 90), percentile(times, repetitions, 99));
+        else
+            printf("%-36s %12ld %10.2f %10.2f %10.2f %10.2f\n", b->name, iterations, times[0],
+                   percentile(times, repetitions, 50), percentile(times, repetitions, 90), percentile(times, repetitions, 99));
+        fflush(stdout);
+        printed++;
+    }
+    if (json)
+        printf("\n]}\n");
+
+    FREE(times);
+    return 0;
+}
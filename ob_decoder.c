@@ -0,0 +1,119 @@
+/* the decoder of .ob files, the inverse of write_ob_word (see ob_file.c).
+ * like object_file.c it doesn't use anything else of the assembler (make libobject.a) */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ob_file.h"
+#include "ob_decoder.h"
+
+#define TRUE 1
+#define FALSE 0
+
+
+/* the value of every symbol by its character, from '!' to '*' (-1 for the characters in between) */
+signed char symbol_values['*' - '!' + 1] = {3, -1, 1, -1, 2, -1, -1, -1, -1, 0};
+
+#define SYMBOL_VALUE(c) ((unsigned char)((c) - '!') <= '*' - '!' ? symbol_values[(unsigned char)((c) - '!')] : -1)
+
+
+/* returns the value of the 7 symbols of a word, or -1 if one of them isn't a symbol */
+int decode_ob_symbols(char* symbols) {
+    int value = 0;
+    int invalid = 0;
+    int i;
+
+    for (i=0; i<7; i++) {
+        int symbol = SYMBOL_VALUE(symbols[i]);
+        invalid |= symbol; /* only -1 has the sign bit */
+        value = (value << 2) | (symbol & 3);
+    }
+    return invalid < 0 ? -1 : value;
+}
+
+/* writes the 7 symbols of the value (its low 14 bits) into symbols, not null terminated */
+void encode_ob_symbols(int value, char* symbols) {
+    int i;
+    for (i=6; i>=0; i--)
+        *symbols++ = "*#%!"[(value >> (2 * i)) & 3];
+}
+
+/* reads the decimal number at *cursor (before end), returns how many digits it had */
+int read_number(char** cursor, char* end, long* number) {
+    int digits = 0;
+
+    *number = 0;
+    while (*cursor < end && **cursor >= '0' && **cursor <= '9' && digits < 9) {
+        *number = *number * 10 + (**cursor - '0');
+        (*cursor)++;
+        digits++;
+    }
+    return digits;
+}
+
+/* sets the error of the line, returns FALSE */
+int decode_error(decoded_ob* ob, long line, char* error) {
+    ob->error = error;
+    ob->error_line = line;
+    free(ob->words);
+    ob->words = NULL;
+    return FALSE;
+}
+
+/* decodes the text of a .ob file (length bytes, it doesn't need to be null terminated) into ob.
+ * every line must have the next address and 7 symbols, and there must be exactly IC + DC of them.
+ * returns FALSE if the text isn't a valid .ob file, ob->error and ob->error_line say why */
+int decode_ob(char* text, long length, decoded_ob* ob) {
+    char* cursor = text;
+    char* end = text + length;
+    long IC;
+    long DC;
+    long i;
+
+    ob->words = NULL;
+    ob->error = NULL;
+    ob->error_line = 0;
+    ob->first_address = FIRST_ADDRESS;
+
+    /* the "  IC DC" line */
+    while (cursor < end && *cursor == ' ')
+        cursor++;
+    if (read_number(&cursor, end, &IC) == 0 || cursor >= end || *cursor++ != ' ')
+        return decode_error(ob, 1, "the first line isn't \"IC DC\"");
+    if (read_number(&cursor, end, &DC) == 0 || cursor >= end || *cursor++ != '\n')
+        return decode_error(ob, 1, "the first line isn't \"IC DC\"");
+    ob->IC = IC;
+    ob->DC = DC;
+    if ((IC + DC) * 13 > (end - cursor) + 1) /* every line is at least 13 characters (the last one might not have its newline) */
+        return decode_error(ob, 2, "there are fewer words than IC + DC");
+
+    ob->words = (int*)malloc((IC + DC + 1) * sizeof(int));
+    if (ob->words == NULL) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+
+    for (i=0; i<IC+DC; i++) {
+        long address;
+        int value;
+
+        if (cursor >= end)
+            return decode_error(ob, i + 2, "there are fewer words than IC + DC");
+        if (read_number(&cursor, end, &address) < 4 || address != FIRST_ADDRESS + i)
+            return decode_error(ob, i + 2, "the address isn't the next one");
+        if (end - cursor < 8 || *cursor != ' ' || (value = decode_ob_symbols(cursor + 1)) < 0)
+            return decode_error(ob, i + 2, "the word isn't a space and 7 symbols");
+        cursor += 8;
+        if (cursor < end && *cursor++ != '\n')
+            return decode_error(ob, i + 2, "the line is longer than a word");
+        ob->words[i] = value;
+    }
+    if (cursor < end)
+        return decode_error(ob, i + 2, "there are more words than IC + DC");
+    return TRUE;
+}
+
+void free_decoded_ob(decoded_ob* ob) {
+    free(ob->words);
+    ob->words = NULL;
+}
@@ -0,0 +1,22 @@
+#ifndef OB_DECODER_H
+#define OB_DECODER_H
+
+/* the words of a .ob file, decoded back from its text (see decode_ob) */
+typedef struct decoded_ob {
+    int IC;
+    int DC;
+    int first_address; /* the address of words[0] */
+    int* words; /* IC + DC values of 14 bits, in the order of the file */
+    char* error; /* why the text isn't a valid .ob file */
+    long error_line;
+} decoded_ob;
+
+#endif
+
+int decode_ob(char* text, long length, decoded_ob* ob);
+
+void free_decoded_ob(decoded_ob* ob);
+
+int decode_ob_symbols(char* symbols);
+
+void encode_ob_symbols(int value, char* symbols);
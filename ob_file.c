@@ -0,0 +1,237 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "ob_file.h"
+#include "trace.h"
+#include "counters.h"
+#include "stats.h"
+#include "alloc.h"
+
+#define ALLOC_SUBSYSTEM ALLOC_OB_FILE
+
+
+/* the length of a .ob line without the address: a space, 7 encrypted symbols and \n */
+#define LINE_LENGTH_WITHOUT_ADDRESS 9
+
+
+/* returns the length of the "  IC DC\n" line at the top of the .ob file */
+long ob_header_length(int IC, int DC) {
+    char header[32];
+    return sprintf(header, "  %d %d\n", IC, DC);
+}
+
+/* returns the total length of the .ob lines of the addresses first_address to last_address-1.
+ * addresses are written with at least 4 digits, so every line before address 10000 has the same length */
+long ob_lines_length(int first_address, int last_address) {
+    long total;
+    long band_end; /* the first address that has more digits than the current band */
+    int width;
+    int address;
+
+    total = 0;
+    band_end = 10000;
+    width = 4;
+    address = first_address;
+
+    while (address < last_address) {
+        if (address < band_end) {
+            long end = last_address < band_end ? last_address : band_end;
+            total += (end - address) * (width + LINE_LENGTH_WITHOUT_ADDRESS);
+            address = end;
+        }
+        band_end *= 10;
+        width++;
+    }
+
+    return total;
+}
+
+/* returns the exact size of the .ob file of a program with the given IC and DC */
+long ob_file_size(int IC, int DC) {
+    return ob_header_length(IC, DC) + ob_lines_length(FIRST_ADDRESS, FIRST_ADDRESS + IC + DC);
+}
+
+
+/* writes the whole given range to the given offset of the file */
+void write_at(int fd, char* data, long length, long offset) {
+    STATS_ADD(bytes_written, length);
+    TRACE_BEGIN("pwrite", NULL);
+    while (length > 0) {
+        ssize_t count = pwrite(fd, data, length, offset);
+        if (count < 0) {
+            printf("Error writing to file");
+            exit(1);
+        }
+        data += count;
+        length -= count;
+        offset += count;
+    }
+    TRACE_END();
+}
+
+/* creates the .ob file at its final size with the IC and DC line already at the top, returns the file descriptor.
+ * the words are then written into place with an ob_writer */
+int create_ob_file(char* filename, int IC, int DC) {
+    int fd;
+    char header[32];
+
+    STATS_ENTER(PHASE_OB_FILE);
+    fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        printf("Error opening file");
+        exit(1);
+    }
+
+    if (ftruncate(fd, ob_file_size(IC, DC)) != 0) {
+        printf("Error writing to file");
+        close(fd);
+        exit(1);
+    }
+
+    write_at(fd, header, sprintf(header, "  %d %d\n", IC, DC), 0);
+
+    STATS_LEAVE();
+    return fd;
+}
+
+
+/* closes a file created with create_ob_file (after all of its writers were flushed) */
+void close_ob_file(int fd) {
+    if (close(fd) != 0) {
+        printf("Error writing to file");
+        exit(1);
+    }
+}
+
+
+/* prepares a writer for the .ob file in fd (which was created with create_ob_file) */
+void start_ob_writer(ob_writer* writer, int fd, int IC, int DC) {
+    writer->fd = fd;
+    writer->image = NULL;
+    writer->words = NULL;
+    writer->header_length = ob_header_length(IC, DC);
+    writer->next_address = -1;
+    writer->buffer_offset = 0;
+    writer->buffer_used = 0;
+}
+
+/* allocates the whole .ob file in memory (ob_file_size bytes and a null terminator) with the IC and DC line at the top.
+ * it is used instead of a file when the output isn't a regular file */
+char* create_ob_image(int IC, int DC) {
+    long size;
+    char* image;
+    
+    size = ob_file_size(IC, DC);
+    image = (char*)MALLOC(size + 1);
+    if (image == NULL) {
+        printf("Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    
+    sprintf(image, "  %d %d\n", IC, DC);
+    image[size] = '\0';
+    
+    return image;
+}
+
+/* prepares a writer for a .ob file in memory (which was created with create_ob_image) */
+void start_ob_image_writer(ob_writer* writer, char* image, int IC, int DC) {
+    start_ob_writer(writer, -1, IC, DC);
+    writer->image = image;
+}
+
+/* writes all of the buffered lines to their place in the file */
+void flush_ob_writer(ob_writer* writer) {
+    STATS_ENTER(PHASE_OB_FILE);
+    if (writer->buffer_used > 0 && writer->image != NULL)
+        memcpy(writer->image + writer->buffer_offset, writer->buffer, writer->buffer_used);
+    else if (writer->buffer_used > 0)
+        write_at(writer->fd, writer->buffer, writer->buffer_used, writer->buffer_offset);
+    writer->buffer_used = 0;
+    writer->next_address = -1;
+    STATS_LEAVE();
+}
+
+/* adds the line of the given machine word (14 binary digits) at the given address.
+ * lines of consecutive addresses are collected in the buffer and written together */
+void write_ob_word(ob_writer* writer, int address, char* word) {
+    char* line;
+
+    /* a line that doesn't continue the buffered lines (or doesn't fit) starts a new chunk */
+    if (address != writer->next_address || writer->buffer_used + 32 > OB_BUFFER_SIZE) {
+        flush_ob_writer(writer);
+        writer->buffer_offset = writer->header_length + ob_lines_length(FIRST_ADDRESS, address);
+    }
+
+    STATS_COUNT(words);
+    if (writer->words != NULL)
+        writer->words[address - FIRST_ADDRESS] = (int)strtol(word, NULL, 2);
+
+    line = writer->buffer + writer->buffer_used;
+    line += sprintf(line, "%04d ", address); /* add the address */
+    to_encrypted_four_bit(word, line); /* add the encrypted word */
+    line += 7;
+    *line++ = '\n';
+
+    writer->buffer_used = line - writer->buffer;
+    writer->next_address = address + 1;
+}
+
+
+/* the same as write_ob_word with the value of the word (its low 14 bits) instead of its binary digits */
+void write_ob_value(ob_writer* writer, int address, int value) {
+    char* line;
+    int i;
+
+    if (address != writer->next_address || writer->buffer_used + 32 > OB_BUFFER_SIZE) {
+        flush_ob_writer(writer);
+        writer->buffer_offset = writer->header_length + ob_lines_length(FIRST_ADDRESS, address);
+    }
+
+    STATS_COUNT(words);
+    value &= 0x3FFF;
+    if (writer->words != NULL)
+        writer->words[address - FIRST_ADDRESS] = value;
+
+    line = writer->buffer + writer->buffer_used;
+    if (address >= 0 && address < 10000) { /* the usual 4 digits without sprintf */
+        line[0] = '0' + address / 1000;
+        line[1] = '0' + address / 100 % 10;
+        line[2] = '0' + address / 10 % 10;
+        line[3] = '0' + address % 10;
+        line[4] = ' ';
+        line += 5;
+    }
+    else
+        line += sprintf(line, "%04d ", address);
+    for (i = 6; i >= 0; i--) /* every 2 bits are one symbol (see to_encrypted_four_bit) */
+        *line++ = "*#%!"[(value >> (2 * i)) & 3];
+    *line++ = '\n';
+
+    writer->buffer_used = line - writer->buffer;
+    writer->next_address = address + 1;
+}
+
+/* recieves a machine word and writes the word in encrypted 4 bit into result (7 symbols, not null terminated) */
+void to_encrypted_four_bit(char* word, char* result) {
+    while (*word != '\0') { /* untill the end of the word */
+        if (*word == '0') { /* the left bit of the current 2 bits is 0 */
+            word++;
+            if (*word=='0') /* the right bit of the current two bits is 0 */
+                *result++ = '*'; /* because '*' is "00" in the encryption */
+            else /* the right bit of the current two bits is 1 */
+                *result++ = '#'; /* because '#' is "01" in the encryption */
+        }
+        else { /* the left bit of the current 2 bits is 1 */
+            word++;
+            if (*word=='0') /* the right bit of the current two bits is 0 */
+                *result++ = '%'; /* because '%' is "10" in the encryption */
+            else /* the right bit of the current two bits is 1 */
+                *result++ = '!'; /* because '!' is "11" in the encryption */
+        }
+        word++;
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef OB_FILE_H
+#define OB_FILE_H
+
+/* the address of the first word in the memory */
+#define FIRST_ADDRESS 100
+
+/* how many bytes of .ob lines are collected before they are written to the file */
+#define OB_BUFFER_SIZE 65536
+
+/* writes the lines of a .ob file straight into their place in the file.
+ * the size of the file is known in advance so every line has a fixed offset,
+ * several writers can share the same file as long as they write different addresses */
+typedef struct ob_writer {
+    int fd; /* the .ob file */
+    char* image; /* the .ob file in memory when there is no file (NULL when writing to fd) */
+    int* words; /* when not NULL, the value of every word is also stored here (by address - FIRST_ADDRESS) */
+    long header_length; /* the length of the IC and DC line at the top of the file */
+    int next_address; /* the address that continues the buffered lines */
+    long buffer_offset; /* the offset in the file of the first buffered byte */
+    int buffer_used;
+    char buffer[OB_BUFFER_SIZE];
+} ob_writer;
+
+#endif
+
+long ob_header_length(int IC, int DC);
+
+long ob_lines_length(int first_address, int last_address);
+
+long ob_file_size(int IC, int DC);
+
+int create_ob_file(char* filename, int IC, int DC);
+
+void close_ob_file(int fd);
+
+void start_ob_writer(ob_writer* writer, int fd, int IC, int DC);
+
+char* create_ob_image(int IC, int DC);
+
+void start_ob_image_writer(ob_writer* writer, char* image, int IC, int DC);
+
+void write_ob_word(ob_writer* writer, int address, char* word);
+
+void write_ob_value(ob_writer* writer, int address, int value);
+
+void flush_ob_writer(ob_writer* writer);
+
+void to_encrypted_four_bit(char* word, char* result);
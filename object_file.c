@@ -0,0 +1,148 @@
+/* the library that reads binary objects (see object_file.h).
+ * it doesn't use anything else of the assembler, so loaders and other tools can link it alone (make libobject.a) */
+
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "object_file.h"
+
+#define TRUE 1
+#define FALSE 0
+
+
+/* returns whether a section of count items of the size starts at offset and ends inside the object */
+int section_fits(object_file* object, unsigned long offset, unsigned long count, unsigned long size) {
+    if (offset % 4 != 0 || offset > (unsigned long)object->size)
+        return FALSE;
+    return count <= ((unsigned long)object->size - offset) / size;
+}
+
+/* returns whether every symbol of the table has a name inside the strings */
+int names_fit(object_file* object, object_symbol* symbols, unsigned long count) {
+    unsigned long i;
+    for (i=0; i<count; i++)
+        if (symbols[i].name >= object->header->strings_size)
+            return FALSE;
+    return TRUE;
+}
+
+/* returns whether the address of every symbol of the table is one of the first count words of the object */
+int addresses_fit(object_file* object, object_symbol* symbols, unsigned long count, unsigned long words) {
+    unsigned long i;
+    for (i=0; i<count; i++)
+        if (symbols[i].address < object->header->base_address || symbols[i].address - object->header->base_address >= words)
+            return FALSE;
+    return TRUE;
+}
+
+/* checks the object in data (size bytes, aligned to 4) and points the sections of the object into it, nothing is copied.
+ * returns FALSE if it isn't a valid object, object->error says why */
+int load_object(char* data, long size, object_file* object) {
+    object_header* header;
+
+    object->data = data;
+    object->size = size;
+    object->mapped = FALSE;
+    object->error = NULL;
+
+    header = (object_header*)data;
+    if ((unsigned long)data % 4 != 0)
+        object->error = "the object isn't aligned to 4 bytes";
+    else if (size < (long)sizeof(object_header) || memcmp(header->magic, OBJECT_MAGIC, 4) != 0)
+        object->error = "not a binary object";
+    else if (header->version != OBJECT_VERSION)
+        object->error = "unknown object version (or the other byte order)";
+    else if (!section_fits(object, header->words_offset, (unsigned long)header->code_words + header->data_words, sizeof(unsigned short)) ||
+             !section_fits(object, header->entries_offset, header->entry_count, sizeof(object_symbol)) ||
+             !section_fits(object, header->relocations_offset, header->relocation_count, sizeof(object_symbol)) ||
+             !section_fits(object, header->strings_offset, header->strings_size, 1))
+        object->error = "a section is outside of the object";
+    if (object->error != NULL)
+        return FALSE;
+
+    object->header = header;
+    object->words = (unsigned short*)(data + header->words_offset);
+    object->entries = (object_symbol*)(data + header->entries_offset);
+    object->relocations = (object_symbol*)(data + header->relocations_offset);
+    object->strings = data + header->strings_offset;
+
+    if (header->strings_size > 0 && object->strings[header->strings_size - 1] != '\0')
+        object->error = "the last name doesn't end";
+    else if (!names_fit(object, object->entries, header->entry_count) ||
+             !names_fit(object, object->relocations, header->relocation_count))
+        object->error = "a name is outside of the strings";
+    else if (!addresses_fit(object, object->entries, header->entry_count, (unsigned long)header->code_words + header->data_words) ||
+             !addresses_fit(object, object->relocations, header->relocation_count, header->code_words))
+        object->error = "an address is outside of the object"; /* a relocation is also only in the code */
+    return object->error == NULL;
+}
+
+/* maps the object file into memory and checks it (see load_object). returns FALSE if it can't be used, object->error says why */
+int open_object(char* filename, object_file* object) {
+    struct stat info;
+    void* map;
+    int fd;
+
+    object->data = NULL;
+    object->mapped = FALSE;
+    fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        object->error = "can't open the object";
+        return FALSE;
+    }
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        close(fd);
+        object->error = "not a binary object";
+        return FALSE;
+    }
+
+    map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        object->error = "can't map the object";
+        return FALSE;
+    }
+
+    if (!load_object((char*)map, info.st_size, object)) {
+        munmap(map, info.st_size);
+        object->data = NULL;
+        return FALSE;
+    }
+    object->mapped = TRUE;
+    return TRUE;
+}
+
+/* releases an object opened with open_object (an object from load_object belongs to the caller) */
+void close_object(object_file* object) {
+    if (object->mapped && object->data != NULL)
+        munmap(object->data, object->size);
+    object->data = NULL;
+    object->mapped = FALSE;
+}
+
+/* returns the value of the word at the address, or -1 if there is no word at it */
+int object_word(object_file* object, int address) {
+    long i = (long)address - object->header->base_address;
+    if (i < 0 || i >= (long)object->header->code_words + object->header->data_words)
+        return -1;
+    return object->words[i];
+}
+
+/* returns the name of an entry or a relocation of the object */
+char* object_symbol_name(object_file* object, object_symbol* symbol) {
+    return object->strings + symbol->name;
+}
+
+/* returns the entry with the name, or NULL if the object doesn't have it */
+object_symbol* find_object_entry(object_file* object, char* name) {
+    unsigned long i;
+    for (i=0; i<object->header->entry_count; i++)
+        if (strcmp(object->strings + object->entries[i].name, name) == 0)
+            return &object->entries[i];
+    return NULL;
+}
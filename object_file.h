@@ -0,0 +1,67 @@
+#ifndef OBJECT_FILE_H
+#define OBJECT_FILE_H
+
+/* the binary object (all --object writes <name>.obj next to the .ob file, see object_writer.c) and the library that reads it.
+ * it holds what the .ob, .ent and .ext files hold without any text, so it can be mapped and used in place:
+ *
+ *     the header        object_header, the counts and the offsets of the sections
+ *     the words         IC code words and then DC data words, one unsigned short each (the low 14 bits).
+ *                       they are where the addresses of the labels put them, so unlike the .ob file (which has
+ *                       the words in the order of the source) the data is always after the code
+ *     the entries       an object_symbol for every .entry, the address of its label
+ *     the relocations   an object_symbol for every word that refers to an external, the address of that word
+ *     the strings       the names of the symbols, every one ends with a null
+ *
+ * every section starts at a multiple of 4 bytes and the numbers are in the byte order of the machine that wrote the file
+ * (a file of the other order has the wrong OBJECT_VERSION, so it is rejected). unlike the .ext file the relocations
+ * have every external operand of a sentence, each with the address of its own word */
+
+#define OBJECT_MAGIC "AOBJ"
+#define OBJECT_VERSION 1
+
+typedef struct object_header {
+    char magic[4];
+    unsigned int version;
+    unsigned int base_address; /* the address of the first word */
+    unsigned int code_words; /* IC */
+    unsigned int data_words; /* DC */
+    unsigned int entry_count;
+    unsigned int relocation_count;
+    unsigned int strings_size; /* in bytes */
+    unsigned int words_offset; /* the offsets of the sections from the start of the file */
+    unsigned int entries_offset;
+    unsigned int relocations_offset;
+    unsigned int strings_offset;
+} object_header;
+
+typedef struct object_symbol {
+    unsigned int name; /* the offset of the name in the strings */
+    unsigned int address;
+} object_symbol;
+
+/* an object that was opened with open_object (or checked with load_object), the pointers point into data */
+typedef struct object_file {
+    char* data;
+    long size;
+    int mapped; /* data is mapped from the file, otherwise it belongs to the caller */
+    object_header* header;
+    unsigned short* words;
+    object_symbol* entries;
+    object_symbol* relocations;
+    char* strings;
+    char* error; /* why the object couldn't be opened */
+} object_file;
+
+#endif
+
+int load_object(char* data, long size, object_file* object);
+
+int open_object(char* filename, object_file* object);
+
+void close_object(object_file* object);
+
+int object_word(object_file* object, int address);
+
+char* object_symbol_name(object_file* object, object_symbol* symbol);
+
+object_symbol* find_object_entry(object_file* object, char* name);
@@ -0,0 +1,114 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.h"
+#include "data_nodes.h"
+#include "ob_file.h"
+#include "object_file.h"
+#include "object_writer.h"
+#include "trace.h"
+#include "counters.h"
+#include "stats.h"
+#include "alloc.h"
+
+#define ALLOC_SUBSYSTEM ALLOC_OBJECT_FILE
+
+
+/* rounds the offset up to the next multiple of 4 (every section starts at one) */
+#define ALIGNED(offset) (((offset) + 3) & ~3UL)
+
+
+/* adds the name to the strings if it isn't in them yet, names keeps the offset of every name (in the address) */
+void add_string(symbol_node** names, unsigned long* strings_size, char* name) {
+    if (get_symbol_node(*names, name) != NULL)
+        return;
+    add_symbol_node(names, name, (int)*strings_size);
+    *strings_size += strlen(name) + 1;
+}
+
+/* puts the symbols of the list into the table, with the offsets of their names */
+void fill_symbols(object_symbol* table, symbol_node* symbols, symbol_node* names) {
+    for (; symbols != NULL; symbols = symbols->next, table++) {
+        table->name = get_symbol_node(names, symbols->name)->address;
+        table->address = symbols->address;
+    }
+}
+
+/* builds the binary object (see object_file.h) in memory out of the value of every word and the symbol lists.
+ * sets size to its length in bytes */
+char* create_object_image(int IC, int DC, int* words, symbol_node* entries, symbol_node* externals, long* size) {
+    object_header header;
+    symbol_node* names; /* every name once, with its offset in the strings */
+    symbol_node* symbol;
+    unsigned long strings_size;
+    char* image;
+    unsigned short* packed;
+    int i;
+
+    names = NULL;
+    strings_size = 0;
+    for (symbol = entries; symbol != NULL; symbol = symbol->next)
+        add_string(&names, &strings_size, symbol->name);
+    for (symbol = externals; symbol != NULL; symbol = symbol->next)
+        add_string(&names, &strings_size, symbol->name);
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, OBJECT_MAGIC, 4);
+    header.version = OBJECT_VERSION;
+    header.base_address = FIRST_ADDRESS;
+    header.code_words = IC;
+    header.data_words = DC;
+    header.entry_count = count_symbol_nodes(entries);
+    header.relocation_count = count_symbol_nodes(externals);
+    header.strings_size = strings_size;
+    header.words_offset = ALIGNED(sizeof(object_header));
+    header.entries_offset = ALIGNED(header.words_offset + (IC + DC) * sizeof(unsigned short));
+    header.relocations_offset = header.entries_offset + header.entry_count * sizeof(object_symbol);
+    header.strings_offset = header.relocations_offset + header.relocation_count * sizeof(object_symbol);
+    *size = ALIGNED(header.strings_offset + strings_size);
+
+    image = (char*)CALLOC(*size, 1); /* the padding is zeros */
+    if (image == NULL) {
+        printf("Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(image, &header, sizeof(header));
+
+    packed = (unsigned short*)(image + header.words_offset);
+    for (i=0; i<IC+DC; i++)
+        packed[i] = (unsigned short)(words[i] & 0x3FFF);
+
+    fill_symbols((object_symbol*)(image + header.entries_offset), entries, names);
+    fill_symbols((object_symbol*)(image + header.relocations_offset), externals, names);
+    for (symbol = names; symbol != NULL; symbol = symbol->next)
+        strcpy(image + header.strings_offset + symbol->address, symbol->name);
+
+    free_symbol_nodes(names);
+    return image;
+}
+
+/* writes the binary object to the file. like write_file, a file that is already the same isn't rewritten */
+void write_object_file(char* filename, int IC, int DC, int* words, symbol_node* entries, symbol_node* externals) {
+    FILE* file;
+    char* image;
+    long size;
+
+    image = create_object_image(IC, DC, words, entries, externals, &size);
+
+    STATS_ENTER(PHASE_WRITE_FILE);
+    if (!file_has_contents(filename, image, size)) {
+        file = fopen(filename, "wb");
+        if (file == NULL) {
+            printf("Error opening file");
+            exit(1);
+        }
+        if (fwrite(image, 1, size, file) != (size_t)size || fclose(file) != 0) {
+            printf("Error writing to file");
+            exit(1);
+        }
+        STATS_ADD(bytes_written, size);
+    }
+    STATS_LEAVE();
+
+    FREE(image);
+}
@@ -0,0 +1,3 @@
+char* create_object_image(int IC, int DC, int* words, symbol_node* entries, symbol_node* externals, long* size);
+
+void write_object_file(char* filename, int IC, int DC, int* words, symbol_node* entries, symbol_node* externals);
@@ -0,0 +1,286 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "sentences.h"
+#include "errors.h"
+#include "utils.h"
+#include "arguments.h"
+#include "data_nodes.h"
+#include "first_pass.h"
+#include "optimizer.h"
+#include "alloc.h"
+
+#define ALLOC_SUBSYSTEM ALLOC_OPTIMIZER
+
+
+/* the peephole optimizer rewrites the .am text before the first pass gives the lines their addresses (all --optimize).
+ * every rule keeps what the program does and makes it shorter (see instruction_number_of_machine_words), and only
+ * lines that can't have an error are touched, so every message is still on a line of the source */
+
+/* an instruction with an immediate origin operand that does the same as an instruction with one operand */
+typedef struct immediate_rule {
+    char* operation;
+    int value; /* the immediate it applies to */
+    char* replacement; /* NULL when the instruction doesn't do anything and is removed */
+    char* name;
+} immediate_rule;
+
+#define IMMEDIATE_RULES 7
+
+immediate_rule immediate_rules[IMMEDIATE_RULES] = {
+    {"mov", 0, "clr", "mov #0, x -> clr x"},
+    {"add", 1, "inc", "add #1, x -> inc x"},
+    {"sub", 1, "dec", "sub #1, x -> dec x"},
+    {"add", -1, "dec", "add #-1, x -> dec x"},
+    {"sub", -1, "inc", "sub #-1, x -> inc x"},
+    {"add", 0, NULL, "add #0, x removed"},
+    {"sub", 0, NULL, "sub #0, x removed"}
+};
+
+/* the rules after the immediate ones */
+#define SELF_MOVE_RULE IMMEDIATE_RULES /* mov x, x does nothing */
+#define REPEATED_MOVE_RULE (IMMEDIATE_RULES + 1) /* mov x, y or mov y, x right after mov x, y does nothing */
+
+char* move_rule_names[] = {"mov x, x removed", "repeated mov removed"};
+
+/* the names of the file, the lines that use names that might not exist aren't touched */
+typedef struct known_names {
+    symbol_node* labels; /* the address is how many times the label is defined */
+    symbol_node* externs;
+    symbol_node* define_counts; /* how many times every name is defined */
+    symbol_node* defines; /* the defines before the current line, with their values */
+} known_names;
+
+
+/* adds one to the count of the name */
+void count_name(symbol_node** names, char* name) {
+    symbol_node* node = get_symbol_node(*names, name);
+    if (node == NULL)
+        add_symbol_node(names, name, 1);
+    else
+        node->address++;
+}
+
+/* finds the labels, externs and defines of the whole text */
+void find_names(char* am_text, known_names* names) {
+    line_reader reader;
+    char* line;
+
+    names->labels = NULL;
+    names->externs = NULL;
+    names->define_counts = NULL;
+    names->defines = NULL;
+
+    start_lines(&reader, am_text);
+    while ((line = next_line(&reader)) != NULL) {
+        sentence s = to_sentence(line);
+
+        if (!s.is_blank && s.err == NULL) {
+            if (strcmp(s.operation, ".define") == 0 && s.argc == 2)
+                count_name(&names->define_counts, s.argv[0]);
+            else if (strcmp(s.operation, ".extern") == 0 && s.argc == 1)
+                count_name(&names->externs, s.argv[0]);
+            else if (s.label != NULL && strcmp(s.operation, ".entry") != 0 && strcmp(s.operation, ".extern") != 0)
+                count_name(&names->labels, s.label);
+        }
+        free_sentence(s);
+    }
+    end_lines(&reader);
+}
+
+/* sets value to the integer or the define (defined once, before this line), returns FALSE if it isn't one */
+int known_value(known_names* names, char* text, int* value) {
+    symbol_node* define;
+    symbol_node* count;
+
+    if (is_integer(text)) {
+        *value = to_integer(text);
+        return TRUE;
+    }
+    define = get_symbol_node(names->defines, text);
+    count = get_symbol_node(names->define_counts, text);
+    if (define == NULL || count == NULL || count->address != 1)
+        return FALSE;
+    *value = define->address;
+    return TRUE;
+}
+
+/* returns whether the operand surely has no error (a register, a known value, a label or an extern) */
+int known_operand(known_names* names, char* arg) {
+    char name[128];
+    char index[128];
+    char* open;
+    char* close;
+    int value;
+
+    switch (get_arg_type(arg)) {
+        case REGISTER:
+            return TRUE;
+        case NUMBER:
+            return known_value(names, arg + 1, &value);
+        case VARIABLE:
+            return get_symbol_node(names->labels, arg) != NULL || get_symbol_node(names->externs, arg) != NULL;
+        case ARRAY_AND_INDEX: /* the sentence doesn't keep the ] (see get_array_index) */
+            open = strchr(arg, '[');
+            close = strchr(arg, ']');
+            if (close == NULL)
+                close = open + strlen(open);
+            else if (close < open || close[1] != '\0')
+                return FALSE;
+            if (open - arg >= 128 || close - open >= 128)
+                return FALSE;
+            sprintf(name, "%.*s", (int)(open - arg), arg);
+            sprintf(index, "%.*s", (int)(close - open - 1), open + 1);
+            return known_operand(names, name) && known_value(names, index, &value);
+        default:
+            return FALSE;
+    }
+}
+
+/* returns whether nothing on the instruction can be an error */
+int known_instruction(known_names* names, sentence s) {
+    unsigned int i;
+
+    if (s.label != NULL) { /* defined only here, and not as an extern too */
+        symbol_node* label = get_symbol_node(names->labels, s.label);
+        if (label == NULL || label->address != 1 || get_symbol_node(names->externs, s.label) != NULL)
+            return FALSE;
+    }
+    for (i=0; i<s.argc; i++)
+        if (!known_operand(names, s.argv[i]))
+            return FALSE;
+    return TRUE;
+}
+
+/* returns the .am text after the rewrites of the rules (allocated), report gets how many words every rule saved */
+char* optimize_source(char* am_text, optimizer_report* report) {
+    known_names names;
+    text_buffer optimized;
+    line_reader reader;
+    char* line;
+    char* previous_move[2]; /* the operands of the mov right before the line, NULL if there isn't one */
+
+    memset(report, 0, sizeof(optimizer_report));
+    find_names(am_text, &names);
+    previous_move[0] = NULL;
+    previous_move[1] = NULL;
+
+    start_text(&optimized);
+    start_lines(&reader, am_text);
+    while ((line = next_line(&reader)) != NULL) {
+        sentence s = to_sentence(line);
+        char rewritten[256];
+        int is_move;
+        int removed;
+        int rule;
+        int value;
+        int i;
+
+        rewritten[0] = '\0';
+        removed = FALSE;
+        rule = -1;
+        is_move = FALSE;
+
+        if (s.is_blank || s.err != NULL)
+            ; /* left as it is */
+        else if (strcmp(s.operation, ".define") == 0) { /* the later lines can use it */
+            if (s.argc == 2 && is_integer(s.argv[1]) && get_symbol_node(names.defines, s.argv[0]) == NULL)
+                add_symbol_node(&names.defines, s.argv[0], to_integer(s.argv[1]));
+            free_sentence(s);
+            add_text(&optimized, line);
+            add_text(&optimized, "\n");
+            continue; /* doesn't make words, so the mov before it is still right before the next line */
+        }
+        else if (find_error(s) != NULL)
+            ;
+        else if (get_operation_type(s.operation) == INSTRUCTION && known_instruction(&names, s)) {
+            is_move = (strcmp(s.operation, "mov") == 0);
+
+            if (is_move && s.label == NULL) {
+                if (strcmp(s.argv[0], s.argv[1]) == 0)
+                    rule = SELF_MOVE_RULE;
+                else if (previous_move[0] != NULL &&
+                         ((strcmp(previous_move[0], s.argv[0]) == 0 && strcmp(previous_move[1], s.argv[1]) == 0) ||
+                          (strcmp(previous_move[0], s.argv[1]) == 0 && strcmp(previous_move[1], s.argv[0]) == 0)))
+                    rule = REPEATED_MOVE_RULE;
+                removed = (rule >= 0);
+            }
+
+            if (rule < 0 && s.argc == 2 && get_arg_type(s.argv[0]) == NUMBER && known_value(&names, s.argv[0] + 1, &value))
+                for (i=0; i<IMMEDIATE_RULES; i++) {
+                    immediate_rule* r = &immediate_rules[i];
+
+                    if (strcmp(r->operation, s.operation) != 0 || r->value != value)
+                        continue;
+                    if (r->replacement == NULL && s.label == NULL) { /* the label would have nothing to be on */
+                        rule = i;
+                        removed = TRUE;
+                    }
+                    else if (r->replacement != NULL && strlen(s.argv[1]) < 200) {
+                        rule = i;
+                        sprintf(rewritten, "%.40s%s\t%s %s%s", s.label != NULL ? s.label : "", s.label != NULL ? ":" : "",
+                                r->replacement, s.argv[1], get_arg_type(s.argv[1]) == ARRAY_AND_INDEX &&
+                                strchr(s.argv[1], ']') == NULL ? "]" : "");
+                    }
+                    break;
+                }
+        }
+
+        if (rule >= 0) {
+            int saved = instruction_number_of_machine_words(s);
+            if (!removed) {
+                sentence replacement = to_sentence(rewritten);
+                saved -= instruction_number_of_machine_words(replacement);
+                free_sentence(replacement);
+            }
+            report->applied[rule]++;
+            report->words_saved[rule] += saved;
+        }
+        if (!removed) {
+            add_text(&optimized, rewritten[0] != '\0' ? rewritten : line);
+            add_text(&optimized, "\n");
+        }
+
+        /* blank lines and removed movs (they leave the operands as the mov before did) don't end the sequence */
+        if (!s.is_blank && !removed) {
+            FREE(previous_move[0]);
+            FREE(previous_move[1]);
+            previous_move[0] = NULL;
+            previous_move[1] = NULL;
+            if (is_move) {
+                previous_move[0] = STRDUP(s.argv[0]);
+                previous_move[1] = STRDUP(s.argv[1]);
+            }
+        }
+        free_sentence(s);
+    }
+    end_lines(&reader);
+
+    FREE(previous_move[0]);
+    FREE(previous_move[1]);
+    free_symbol_nodes(names.labels);
+    free_symbol_nodes(names.externs);
+    free_symbol_nodes(names.define_counts);
+    free_symbol_nodes(names.defines);
+
+    if (optimized.text == NULL) /* an empty file */
+        return STRDUP("");
+    return optimized.text;
+}
+
+/* prints how many times every rule was used and how many words it saved */
+void print_optimizer_report(FILE* out, optimizer_report* report) {
+    int total = 0;
+    int i;
+
+    for (i=0; i<OPTIMIZER_RULES; i++)
+        total += report->words_saved[i];
+    fprintf(out, "optimizer: %d word%s saved\n", total, total == 1 ? "" : "s");
+    if (total > 0)
+        fprintf(out, "  %-22s %7s %6s\n", "rule", "applied", "words");
+    for (i=0; i<OPTIMIZER_RULES; i++)
+        if (report->applied[i] > 0)
+            fprintf(out, "  %-22s %7d %6d\n",
+                    i < IMMEDIATE_RULES ? immediate_rules[i].name : move_rule_names[i - IMMEDIATE_RULES],
+                    report->applied[i], report->words_saved[i]);
+}
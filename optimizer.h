@@ -0,0 +1,18 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include <stdio.h>
+
+#define OPTIMIZER_RULES 9
+
+/* what the peephole optimizer did to a file, by rule (see immediate_rules in optimizer.c) */
+typedef struct optimizer_report {
+    int applied[OPTIMIZER_RULES];
+    int words_saved[OPTIMIZER_RULES];
+} optimizer_report;
+
+char* optimize_source(char* am_text, optimizer_report* report);
+
+void print_optimizer_report(FILE* out, optimizer_report* report);
+
+#endif
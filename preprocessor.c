@@ -3,24 +3,30 @@
 #include <stdbool.h>
 #include <string.h>
 #include "sentences.h"
+#include "errors.h"
 #include "utils.h"
+#include "data_nodes.h"
 #include "preprocessor.h"
+#include "trace.h"
+#include "counters.h"
+#include "stats.h"
+#include "alloc.h"
 
-/* +1 for the \n */
-#define MAX_LINE_LENGTH 81
+#define ALLOC_SUBSYSTEM ALLOC_PREPROCESSOR
 
 
-/* mcrNode for macro linked list */
+/* mcrNode for macro linked list (it starts like a list_node, see data_nodes.h) */
 typedef struct mcrNode {
     char* name;
-    char* macro;
+    struct name_index* index;
     struct mcrNode* next;
+    char* macro;
 } mcrNode;
 
 
 /* Function to add a new mcrNode to the end of the macro list */
 void add_macro(mcrNode** mcrHead, char* name, char* macro) {
-    mcrNode* new_node = (mcrNode*)malloc(sizeof(mcrNode)); /* allocate memory to the node */
+    mcrNode* new_node = (mcrNode*)MALLOC(sizeof(mcrNode)); /* allocate memory to the node */
     if (new_node == NULL) {
         printf("Memory allocation failed.\n");
         exit(1);
@@ -29,160 +35,137 @@ void add_macro(mcrNode** mcrHead, char* name, char* macro) {
 	/* assign the values into the new node */
     new_node->name = name;
     new_node->macro = macro;
-    new_node->next = NULL;
 	
-	/* add the new node to the list */
-    if (*mcrHead == NULL) 
-        *mcrHead = new_node; /* if the list is empty, make the new node the mcrHead */
-    else {
-        mcrNode* current = *mcrHead;
-        while (current->next != NULL) 
-            current = current->next; /* go to the end of the list */
-        current->next = new_node; /* add the new node to the end of the list */
-    }
+    append_node((list_node**)mcrHead, (list_node*)new_node); /* add the new node to the end of the list */
 }
 
 /* Function to get the macro corresponding to a given name */
 char* get_macro(mcrNode* mcrHead, char* name) {
-    mcrNode* current = mcrHead;
-    
-    while (current != NULL) { /* go through the list */
-        if (strcmp(current->name, name) == 0) { /* return the macro if the name matches */
-            return current->macro;
-        }
-        current = current->next;
-    }
-    return NULL; /* Return NULL if the name is not found */
+    mcrNode* found = (mcrNode*)find_node((list_node*)mcrHead, name);
+    return (found != NULL) ? found->macro : NULL; /* Return NULL if the name is not found */
 }
 
 /* function to free a macro list */
 void free_macro_list(mcrNode* current) {
+    free_node_index((list_node*)current);
     while (current != NULL) {
         mcrNode* temp = current;
         current = current->next;
-        free(temp->name);
-        free(temp->macro);
-        free(temp);
+        FREE(temp->name);
+        FREE(temp->macro);
+        FREE(temp);
     }
 }
 
-/* this functions returns the text in the am file after handeling the macros */
-char* create_am_file(char* text) {
-    char* am_text; /* the output */
+/* this functions returns the text in the am file after handeling the macros, errors are reported to diag */
+char* create_am_file(char* text, diagnostics* diag) {
+    text_buffer am_text; /* the output */
     mcrNode* mcrHead; /* macro list to keep track of all of the macros */
     char* macro_name;
-    char* macro; /* the content of the macro */
+    text_buffer macro; /* the content of the macro */
     int in_macro;
     int found_error;
     char* line;
+    line_reader reader;
     
-    am_text = NULL;
+    start_text(&am_text);
     mcrHead = NULL;
     macro_name = NULL;
-    macro = NULL;
+    start_text(&macro);
     in_macro = FALSE;
     found_error = FALSE;
+    STATS_ENTER(PHASE_PREPROCESSOR);
 
-    /* go through every line in the file using strtok */
-    line = strtok(text, "\n");
-    while (line != NULL) {
+    /* go through every line in the file (the text itself is read only) */
+    start_lines(&reader, text);
+    line = next_line(&reader);
+    while (line != NULL && !too_many_errors(diag)) {
     	sentence sent;
     	int line_num;
     	char* macro_content;
     	
-        line_num = find_line_number(text, line); /* get the line number */
+        line_num = reader.line_number; /* get the line number */
+        STATS_COUNT(lines);
         sent = to_sentence(line);
+        macro_content = sent.is_blank ? NULL : get_macro(mcrHead, sent.operation);
         
         /* blank lines and comments are ignored and errors are handled later */
-        if (sent.is_blank) {
-            free_sentence(sent);
-            line = strtok(NULL, "\n");
-            continue;
-        }
+        if (sent.is_blank)
+            ;
         
-        macro_content = get_macro(mcrHead, sent.operation);
-		
         /* the line can't be longer than 80 chars */
-        if (strlen(line) > MAX_LINE_LENGTH) {
-            free_sentence(sent);
-            printf("line %d: ERROR: line length exceeds 80 chars", line_num);
+        else if (strlen(line) > MAX_LINE_LENGTH) {
+            report(diag, LINE_TOO_LONG, line_num, line, NULL, NULL);
             found_error = TRUE;
-            line = strtok(NULL, "\n");
-            continue;
         }
       
         /* Copy macro to text */
-        if (macro_content != NULL) {
-        	free_sentence(sent);
-            am_text = merge_strings(am_text, macro_content); /* replace macro name with content */
-            am_text = merge_strings(am_text, "\n"); /* start new line */
-            line = strtok(NULL, "\n");
-            continue;
+        else if (macro_content != NULL) {
+            STATS_ADD(macro_lines, count_lines(macro_content));
+            add_text(&am_text, macro_content); /* replace macro name with content */
+            add_text(&am_text, "\n"); /* start new line */
         }
         
         /* set macro */
-        if (in_macro) {
+        else if (in_macro) {
             if (strcmp(sent.operation, "endmcr") == 0) {
-                if (sent.label != NULL) { /* labels on macros are ignored */
-                    printf("line %d: WARNING: Label Ignored When Put On endmcr Lines.", line_num);
-                }
+                if (sent.label != NULL) /* labels on macros are ignored */
+                    report(diag, LABEL_IGNORED, line_num, line, sent.label, "endmcr");
+                
                 if (sent.argc != 0) { /* endmcr shouldn't have any arguments */
-                    sent.err = "Too Many Arguments (0 Argument Expected)";
-                    printf("line %d: ERROR: Too Many Arguments (0 Argument Expected)", line_num);
-                    free_sentence(sent);
+                    report(diag, ENDMCR_ARGUMENTS, line_num, line, sent.argv[0], NULL);
                     found_error = TRUE;
-                    line = strtok(NULL, "\n");
-                    continue;
                 }
-                add_macro(&mcrHead, macro_name, macro); /* add macro to the list */
-                macro_name = NULL; /* reset macro name and content */
-                macro = NULL;
-                in_macro = FALSE;
+                else {
+                    add_macro(&mcrHead, macro_name, macro.text); /* add macro to the list */
+                    macro_name = NULL; /* reset macro name and content */
+                    start_text(&macro);
+                    in_macro = FALSE;
+                }
             } else { /* we are in the macro and it didn't end */
                 /* add line to the macros content */
-                macro = merge_strings(macro, line);
-                macro = merge_strings(macro, "\n");
+                add_text(&macro, line);
+                add_text(&macro, "\n");
             }
         } else { /* not in a macro */
             if (strcmp(sent.operation, "mcr") == 0) { /* macro has started */
-                if (sent.label != NULL) { /* labels on macros are ignored */
-                    printf("line %d: WARNING: Label Ignored When Put On mcr Lines.", line_num);
-                }
+                if (sent.label != NULL) /* labels on macros are ignored */
+                    report(diag, LABEL_IGNORED, line_num, line, sent.label, "mcr");
 
                 /* macro must have 1 argument which is its name */
                 if (sent.argc == 0) { /* handle 0 args */
-                    printf("line %d: error: Missing Macro Name", line_num);
-                    free_sentence(sent);
+                    report(diag, MISSING_MACRO_NAME, line_num, line, sent.operation, NULL);
                     found_error = TRUE;
-                    line = strtok(NULL, "\n");
-                    continue;
                 } else if (sent.argc > 1) { /* handle more than one args */
-                    printf("line %d: error: Too Many Arguments (1 Argument Expected)", line_num);
-                    free_sentence(sent);
+                    report(diag, MCR_ARGUMENTS, line_num, line, sent.argv[1], NULL);
                     found_error = TRUE;
-                    line = strtok(NULL, "\n");
-                    continue;
+                } else {
+                    macro_name = STRDUP(sent.argv[0]); /* set macro name to be the first arg */
+                    in_macro = TRUE;
                 }
-                macro_name = strdup(sent.argv[0]); /* set macro name to be the first arg */
-                in_macro = TRUE;
             } else { /* not in a macro and the line doesn't use a macro */
-                am_text = merge_strings(am_text, line); /* add unmodified line to the am file */
-                am_text = merge_strings(am_text, "\n"); /* start new line */
+                add_text(&am_text, line); /* add unmodified line to the am file */
+                add_text(&am_text, "\n"); /* start new line */
             }
         }
         free_sentence(sent); /* free allocated memory for the sentence */
-        line = strtok(NULL, "\n");
+        line = next_line(&reader);
     }
 
-    /* Free memory allocated for the linked list */
+    end_lines(&reader);
+
+    /* Free memory allocated for the linked list (and a macro the file ended in) */
     free_macro_list(mcrHead);
+    FREE(macro_name);
+    FREE(macro.text);
+    STATS_LEAVE();
 	
     /* return am_text only if no errors were found */
     if (!found_error)
-        return am_text;
+        return am_text.text;
 	
     /* return null if errors were found */
-    free(am_text);
+    FREE(am_text.text);
     return NULL;
 }
 
@@ -1 +1,4 @@
-char* create_am_file();
\ No newline at end of file
+/* the longest line the preprocessor accepts (+1 for the \n) */
+#define MAX_LINE_LENGTH 81
+
+char* create_am_file(char* text, diagnostics* diag);
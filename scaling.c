@@ -0,0 +1,223 @@
+/* the scaling check (make scaling), it makes sure no phase of the assembler grows faster than n log n:
+ *
+ *     scaling [--start=lines] [--steps=N] [--repetitions=N] [stressors]
+ *
+ * every stressor is a mix of lines for the corpus generator (see corpus.c) that piles up one kind of work:
+ * many lines, many labels, many macros, many externs, many entries, long .data and lines that repeat (the error
+ * lines are the same few lines over and over, and every one of them is looked up in the .as text for its message).
+ * the files are assembled in memory at doubling sizes with the stats on, the fastest repetition of every size is kept,
+ * and the growth exponent of every phase is fitted (the slope of log(time) over log(lines)).
+ * a phase that takes long enough to be judged fails if its exponent is over the one of n log n by more than
+ * SCALING_TOLERANCE. returns 1 if any phase failed */
+
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "sentences.h"
+#include "errors.h"
+#include "utils.h"
+#include "data_nodes.h"
+#include "preprocessor.h"
+#include "assembler.h"
+#include "trace.h"
+#include "counters.h"
+#include "stats.h"
+#include "alloc.h"
+
+#define ALLOC_SUBSYSTEM ALLOC_DRIVER
+
+
+#define DEFAULT_START_LINES 4000
+#define DEFAULT_STEPS 5
+#define DEFAULT_REPETITIONS 3
+#define MAX_STEPS 16
+
+/* how much faster than n log n a phase may seem to grow (the times of small files are noisy) */
+#define SCALING_TOLERANCE 0.35
+
+/* a phase that takes less than this on the biggest file is too fast to be judged */
+#define MIN_JUDGED_MICROSECONDS 3000
+
+/* where the generated files go */
+#define SCALING_DIR "scaling_corpus"
+
+struct stressor {
+    char* name;
+    char* mix; /* for corpus --mix */
+} stressors[] = {
+    {"lines", "instruction:70,data:8,string:3,define:2,macro:4,extern:2,entry:2,comment:9"},
+    {"labels", "instruction:30,data:70,comment:0,macro:0,string:0,define:0,extern:0,entry:0"},
+    {"macros", "macro:80,instruction:20,comment:0,data:2,string:0,define:0,extern:0,entry:0"},
+    {"externs", "extern:40,instruction:60,comment:0,data:0,string:0,define:0,macro:0,entry:0"},
+    {"entries", "entry:30,data:30,instruction:40,comment:0,string:0,define:0,macro:0,extern:0"},
+    {"data", "data:100,instruction:0,comment:0,string:0,define:1,macro:0,extern:0,entry:0"},
+    {"duplicates", "error:60,instruction:40,comment:0,data:2,string:0,define:0,macro:0,extern:0,entry:0"}
+};
+
+#define STRESSOR_COUNT 7
+
+/* the phases that are judged, and the whole compilation */
+stats_phase judged_phases[] = {PHASE_PREPROCESSOR, PHASE_FIRST_PASS, PHASE_SECOND_PASS, PHASE_OB_FILE};
+
+#define JUDGED_COUNT 4
+
+
+/* assembles the file in memory once and puts the time of every phase in times (the last one is the total) */
+void assemble_once(char* filename, double times[JUDGED_COUNT + 1]) {
+    source_file source;
+    diagnostics diag;
+    char* am_text;
+    int i;
+
+    start_diagnostics(&diag, filename, 0);
+    start_stats();
+    if (!read_file(filename, &source)) {
+        printf("error: can't read %s\n", filename);
+        exit(1);
+    }
+    am_text = create_am_file(source.text, &diag);
+    if (am_text != NULL) {
+        char* ob_image = NULL;
+        second_pass_result* result = assemble(source.text, am_text, NULL, &ob_image, NULL, NULL, &diag);
+
+        if (result != NULL) {
+            FREE(result->ent_file);
+            FREE(result->ext_file);
+            FREE(result);
+        }
+        FREE(ob_image);
+        FREE(am_text);
+    }
+    close_file(&source);
+    stop_stats();
+    free_diagnostics(&diag);
+
+    times[JUDGED_COUNT] = 0;
+    for (i=0; i<PHASE_COUNT; i++)
+        times[JUDGED_COUNT] += stats.microseconds[i];
+    for (i=0; i<JUDGED_COUNT; i++)
+        times[i] = stats.microseconds[judged_phases[i]];
+}
+
+/* the slope of the line that fits log(y) over log(x) best */
+double fit_exponent(double* x, double* y, int count) {
+    double sum_x = 0;
+    double sum_y = 0;
+    double sum_xx = 0;
+    double sum_xy = 0;
+    int i;
+
+    for (i=0; i<count; i++) {
+        double lx = log(x[i]);
+        double ly = log(y[i] > 1 ? y[i] : 1);
+        sum_x += lx;
+        sum_y += ly;
+        sum_xx += lx * lx;
+        sum_xy += lx * ly;
+    }
+    return (count * sum_xy - sum_x * sum_y) / (count * sum_xx - sum_x * sum_x);
+}
+
+/* runs one stressor, returns how many of its phases grow too fast */
+int run_stressor(struct stressor* stressor, long start, int steps, int repetitions) {
+    double lines[MAX_STEPS];
+    double times[JUDGED_COUNT + 1][MAX_STEPS];
+    double limit;
+    int failed;
+    int step;
+    int i;
+
+    for (step = 0; step < steps; step++) {
+        char filename[128];
+        char command[512];
+        int repetition;
+
+        lines[step] = (double)(start << step);
+        sprintf(filename, "%s/%s%ld.as", SCALING_DIR, stressor->name, start << step);
+        sprintf(command, "./corpus --seed=%d --mix=%s %ld %s", step + 1, stressor->mix, start << step, filename);
+        if (system(command) != 0) {
+            printf("error: can't generate %s (was corpus built?)\n", filename);
+            exit(1);
+        }
+
+        for (repetition = 0; repetition < repetitions; repetition++) {
+            double once[JUDGED_COUNT + 1];
+
+            assemble_once(filename, once);
+            for (i=0; i<=JUDGED_COUNT; i++)
+                if (repetition == 0 || once[i] < times[i][step])
+                    times[i][step] = once[i];
+        }
+        remove(filename);
+    }
+
+    /* the exponent n log n seems to have between the smallest and the biggest file */
+    limit = log(lines[steps-1] * log(lines[steps-1]) / (lines[0] * log(lines[0]))) / log(lines[steps-1] / lines[0]);
+    limit += SCALING_TOLERANCE;
+
+    printf("%s (%ld to %ld lines, the limit is %.2f):\n", stressor->name, start, start << (steps - 1), limit);
+    failed = 0;
+    for (i=0; i<=JUDGED_COUNT; i++) {
+        char* name = (i < JUDGED_COUNT) ? phase_names[judged_phases[i]] : "total";
+        double exponent = fit_exponent(lines, times[i], steps);
+        int judged = times[i][steps-1] >= MIN_JUDGED_MICROSECONDS;
+
+        printf("  %-16s %10.2f ms -> %10.2f ms  exponent %5.2f  %s\n", name, times[i][0] / 1000, times[i][steps-1] / 1000,
+               exponent, !judged ? "(too fast to judge)" : exponent > limit ? "FAILED" : "ok");
+        if (judged && exponent > limit)
+            failed++;
+    }
+    return failed;
+}
+
+int main(int argc, char* argv[]) {
+    long start;
+    int steps;
+    int repetitions;
+    int failed;
+    int ran;
+    int i;
+    int j;
+
+    start = DEFAULT_START_LINES;
+    steps = DEFAULT_STEPS;
+    repetitions = DEFAULT_REPETITIONS;
+    for (i = 1; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+        if (strncmp(argv[i], "--start=", 8) == 0 && atol(argv[i] + 8) > 0)
+            start = atol(argv[i] + 8);
+        else if (strncmp(argv[i], "--steps=", 8) == 0 && atoi(argv[i] + 8) >= 2 && atoi(argv[i] + 8) <= MAX_STEPS)
+            steps = atoi(argv[i] + 8);
+        else if (strncmp(argv[i], "--repetitions=", 14) == 0 && atoi(argv[i] + 14) > 0)
+            repetitions = atoi(argv[i] + 14);
+        else {
+            printf("error: unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    stats_enabled = TRUE;
+    failed = 0;
+    ran = 0;
+    for (j = 0; j < STRESSOR_COUNT; j++) {
+        int k;
+        int selected = (i == argc);
+
+        for (k = i; k < argc; k++)
+            if (strcmp(argv[k], stressors[j].name) == 0)
+                selected = TRUE;
+        if (!selected)
+            continue;
+        failed += run_stressor(&stressors[j], start, steps, repetitions);
+        ran++;
+        fflush(stdout);
+    }
+
+    if (ran == 0) {
+        printf("error: no such stressor\n");
+        return 1;
+    }
+    printf(failed > 0 ? "%d phases grow faster than n log n\n" : "every phase grows at most like n log n\n", failed);
+    return failed > 0;
+}
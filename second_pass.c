@@ -3,17 +3,24 @@
 #include <string.h>
 #include <ctype.h>
 #include "sentences.h"
-#include "utils.h"
 #include "errors.h"
+#include "utils.h"
 #include "arguments.h"
 #include "preprocessor.h"
 #include "data_nodes.h"
 #include "first_pass.h"
+#include "ob_file.h"
 #include "second_pass.h"
+#include "alloc.h"
+
+#define ALLOC_SUBSYSTEM ALLOC_SECOND_PASS
 
 /* macro to add a string to the end of the result */
 #define ADD_TO_RESULT(str) result = merge_strings(result, str)
 
+/* the line number of the current line, it is only looked up (once) when a message is reported */
+#define LINE_NUMBER (line_num != 0 ? line_num : (line_num = find_mapped_line(&as_lines, line)))
+
 
 /* a list containing the binary opcode for every instruction operation */
 struct opcode_list_struct opcode_list[16] = {
@@ -65,7 +72,7 @@ char* decimal_to_n_bit_binary(int num, int num_bits) {
     char* result;
     int i;
     
-    result = (char*)malloc((num_bits + 1) * sizeof(char)); /* +1 for null terminator */
+    result = (char*)MALLOC((num_bits + 1) * sizeof(char)); /* +1 for null terminator */
     
     if (result == NULL) {
         printf("Memory allocation failed\n");
@@ -137,7 +144,7 @@ char* get_array_name(char* str) {
     lengthUntilBracket = bracketPos - str;
 
     /* Allocate memory for a new string to store the result */
-    result = (char*)malloc(lengthUntilBracket + 1);
+    result = (char*)MALLOC(lengthUntilBracket + 1);
 
     /* Copy characters from the original string until '[' */
     strncpy(result, str, lengthUntilBracket);
@@ -168,7 +175,7 @@ char* get_array_index(char* arg) {
     indexLength = indexEnd - indexStart;
 
     /* Allocate memory for the index */
-    index = (char*)malloc(indexLength + 1);
+    index = (char*)MALLOC(indexLength + 1);
 
     /* Copy the index characters into the new string */
     strncpy(index, indexStart, indexLength);
@@ -189,7 +196,7 @@ char* get_array_index(char* arg) {
 	
     /* If the trimmed index is empty, return NULL */
     if (strlen(trimmedIndex) == 0) {
-        free(index);
+        FREE(index);
         return NULL;
     }
 	
@@ -200,7 +207,7 @@ char* get_array_index(char* arg) {
 /* turns the given int to a 4 digit string, if the number's length is less that 4, before the numbers there are zeros untill it's 4 digits long */
 char* int_to_four_digit_string(int number) {
     /* Allocate memory for the resulting string (plus one for the null terminator) */
-    char* result = (char*)malloc(5 * sizeof(char));
+    char* result = (char*)MALLOC(5 * sizeof(char));
     if (result == NULL) {
         printf("Memory allocation failed.\n");
         exit(EXIT_FAILURE);
@@ -247,7 +254,7 @@ char* to_words(sentence s, label_node** label_head, extern_node** extern_head, e
             ADD_TO_RESULT(num_in_binary);
             ADD_TO_RESULT("\n"); /* start new word */
             
-            free(num_in_binary); /* free allocated memory for num_in_binary */
+            FREE(num_in_binary); /* free allocated memory for num_in_binary */
         }
         return result;
     }
@@ -265,7 +272,7 @@ char* to_words(sentence s, label_node** label_head, extern_node** extern_head, e
             ADD_TO_RESULT(num_in_binary);
             ADD_TO_RESULT("\n"); /* start new word */
             
-            free(num_in_binary); /* free allocated memory for num_in_binary */
+            FREE(num_in_binary); /* free allocated memory for num_in_binary */
             temp++; /* advance to the next char */
         }
         ADD_TO_RESULT("00000000000000\n"); /* add the null terminator */
@@ -317,7 +324,7 @@ char* to_words(sentence s, label_node** label_head, extern_node** extern_head, e
             ADD_TO_RESULT(num_in_binary); /* add the number in 12 bits */
             ADD_TO_RESULT("00"); /* add the are field which is 00 for a number argument */
             
-            free(num_in_binary);
+            FREE(num_in_binary);
         }
         else if (type == VARIABLE) {
         	int label_address;
@@ -335,7 +342,7 @@ char* to_words(sentence s, label_node** label_head, extern_node** extern_head, e
             ADD_TO_RESULT(num_in_binary);
             ADD_TO_RESULT("10"); /* add the ARE field of a relocatable memory address */
             
-            free(num_in_binary);
+            FREE(num_in_binary);
         }
         else if (type == ARRAY_AND_INDEX) {
 
@@ -362,7 +369,7 @@ char* to_words(sentence s, label_node** label_head, extern_node** extern_head, e
                 ADD_TO_RESULT(num_in_binary);
                 ADD_TO_RESULT("10\n"); /* add the ARE field of a relocatable memory address */
                 
-                free(num_in_binary);
+                FREE(num_in_binary);
             }
             
             /* add the index as a word */
@@ -376,9 +383,9 @@ char* to_words(sentence s, label_node** label_head, extern_node** extern_head, e
             ADD_TO_RESULT(num_in_binary); /* add the index in 12 bits */
             ADD_TO_RESULT("00"); /* add the are field which is 00 for an index */
             
-            free(num_in_binary);
-            free(array_index);
-            free(array_name);
+            FREE(num_in_binary);
+            FREE(array_index);
+            FREE(array_name);
         }
         else { /* meaning the arg is a register */
             if (s.argc==1){
@@ -412,419 +419,469 @@ char* to_words(sentence s, label_node** label_head, extern_node** extern_head, e
 }
 
 
-/* recieves a machine word and returns the word in encrypted 4 bit */
-char* to_encrypted_four_bit(char* word) {
-    char* result = NULL;
-    
-    while (*word != '\0') { /* untill the end of the word */
-        if (*word == '0') { /* the left bit of the current 2 bits is 0 */
-            word++;
-            if (*word=='0') /* the right bit of the current two bits is 0 */
-                ADD_TO_RESULT("*"); /* because '*' is "00" in the encryption */
-            else /* the right bit of the current two bits is 1 */
-                ADD_TO_RESULT("#"); /* because '#' is "01" in the encryption */
-        }
-        else { /* the left bit of the current 2 bits is 1 */
-            word++;
-            if (*word=='0') /* the right bit of the current two bits is 0 */
-                ADD_TO_RESULT("%"); /* because '%' is "10" in the encryption */
-            else /* the right bit of the current two bits is 1 */
-                ADD_TO_RESULT("!"); /* because '!' is "11" in the encryption */
-        }
-        word++;
-    }
+/* returns the index of the name in a list of names (-1 if it isn't there) */
+int find_name(char* name, char** names, int count) {
+    int i;
+    for (i=0; i<count; i++)
+        if (strcmp(name, names[i])==0)
+            return i;
+    return -1;
+}
 
-    return result;
+char* opcode_names[16] = {"mov", "cmp", "add", "sub", "not", "clr", "lea", "inc", "dec", "jmp", "bne", "red", "prn", "jst", "rts", "hlt"};
+
+/* the value of a defined name or of an integer, like to_words finds it */
+int value_of(char* arg, define_node** define_head) {
+    define_node* n = get_define(*define_head, arg);
+    return (n != NULL) ? n->value : to_integer(arg);
 }
 
+/* the word of a label operand, like to_words encodes it. returns -1 if there is no such label (the operands are
+ * checked before they are encoded, so it is never encoded as address 0) */
+int label_word(char* name, label_node** label_head, extern_node** extern_head) {
+    label_node* l;
+
+    if (get_extern(*extern_head, name) != NULL)
+        return EXTERNAL_ARE;
+    l = get_label(*label_head, name);
+    if (l == NULL)
+        return -1;
+    return ((l->line & 0xFFF) << 2) | RELOCATABLE_ARE;
+}
 
-/* formats the IC and DC to be put at the top of the .ob file */
-char* format_IC_DC(int IC, int DC) {
-	char* str;
-	
-    /* Allocate memory for the resulting string */
-    str = (char*)malloc(12 * sizeof(char)); /* 3 spaces + 2, 4 digit integers (maximum) + 1 string terminator = 12 */
-    if (str == NULL) {
-        printf("Memory allocation failed\n");
-        exit(EXIT_FAILURE);
+/* encodes the sentence straight into the values of its words (the same words as to_words, without the binary strings),
+ * returns the amount of words, -1 if they might not fit (MAX_SENTENCE_WORDS) or -2 if an operand is an unknown label */
+int encode_sentence(sentence s, label_node** label_head, extern_node** extern_head, define_node** define_head, int* words) {
+    int count;
+    int i;
+
+    if (s.is_blank || strcmp(s.operation, ".extern")==0 || strcmp(s.operation, ".entry")==0)
+        return 0;
+
+    if (strcmp(s.operation, ".data")==0) {
+        if (s.argc > MAX_SENTENCE_WORDS)
+            return -1;
+        for (i=0; i<s.argc; i++)
+            words[i] = value_of(s.argv[i], define_head) & 0x3FFF;
+        return s.argc;
+    }
+    if (strcmp(s.operation, ".string")==0) {
+        char* c = s.argv[0] + 1; /* +1 to skip the '"' */
+
+        if ((int)strlen(c) + 1 > MAX_SENTENCE_WORDS)
+            return -1;
+        for (count = 0; *c != '\0'; c++)
+            words[count++] = (int)*c & 0x3FFF;
+        words[count++] = 0; /* the null terminator */
+        return count;
     }
 
-    /* Format the integers into the string */
-    sprintf(str, "  %d %d\n", IC, DC);
+    /* the first word: the opcode and the addressing modes of the operands */
+    words[0] = find_name(s.operation, opcode_names, 16) << 6;
+    if (s.argc == 1)
+        words[0] |= get_arg_type(s.argv[0]) << 2;
+    else if (s.argc == 2)
+        words[0] |= (get_arg_type(s.argv[0]) << 4) | (get_arg_type(s.argv[1]) << 2);
+    count = 1;
 
-    return str;
-}
+    for (i=0; i<s.argc; i++) {
+        char* arg = s.argv[i];
+        arg_type type = get_arg_type(arg);
 
+        if (type == NUMBER)
+            words[count++] = (value_of(arg + 1, define_head) & 0xFFF) << 2;
+        else if (type == VARIABLE) {
+            if ((words[count++] = label_word(arg, label_head, extern_head)) < 0)
+                return -2;
+        }
+        else if (type == ARRAY_AND_INDEX) {
+            char* name = get_array_name(arg);
+            char* index = get_array_index(arg);
+
+            words[count++] = label_word(name, label_head, extern_head);
+            words[count++] = (value_of(index, define_head) & 0xFFF) << 2;
+            FREE(index);
+            FREE(name);
+            if (words[count - 2] < 0)
+                return -2;
+        }
+        else { /* a register */
+            int r = find_name(arg, registers, 8);
 
-/* recieves the machine words in binary and returns the final .ob text */
-char* to_ob_file(char* machine_words, int IC, int DC) {
-    int address_counter;
-    char* result; /* the output */
-    char* formatted_IC_DC;
-    char* word;
-    
-    address_counter = 100; /* addresses start at 100 */
-    result = NULL;
+            if (s.argc == 2 && i == 0 && get_arg_type(s.argv[1]) == REGISTER) { /* two registers share a word */
+                words[count++] = (r << 5) | (find_name(s.argv[1], registers, 8) << 2);
+                break;
+            }
+            words[count++] = (s.argc == 2 && i == 0) ? r << 5 : r << 2;
+        }
+    }
+    return count;
+}
 
-    formatted_IC_DC = format_IC_DC(IC, DC);
-    ADD_TO_RESULT(formatted_IC_DC); /* add the IC and DC to the result */
-    free(formatted_IC_DC);
+/* writes the given machine words in binary (one word per line) to the .ob file starting at the given address,
+ * returns the amount of words that were written */
+int write_words(ob_writer* writer, int address, char* words) {
+    int count;
     
-    /* split every line with strtok */
-    word = strtok(machine_words, "\n");
-    while (word != NULL) {
-    	char* four_digit_string;
-    	char* encrypted_4_bit_word;
+    count = 0;
+    while (words != NULL && *words != '\0') {
+        char* word_end = strchr(words, '\n');
         
-        four_digit_string = int_to_four_digit_string(address_counter);
-        ADD_TO_RESULT(four_digit_string); /* add the line number */
-        ADD_TO_RESULT(" "); /* add spaces */
-        encrypted_4_bit_word = to_encrypted_four_bit(word); /* encrypt word */
-        ADD_TO_RESULT(encrypted_4_bit_word); /* add the encrypted word */
-        ADD_TO_RESULT("\n"); /* start new line */
-
-        address_counter++;
+        if (word_end != NULL)
+            *word_end = '\0'; /* the words belong to us so they can be split in place */
         
-        /* free allocated space for the encrypted word */
-        free(four_digit_string);
-        free(encrypted_4_bit_word);
+        if (writer != NULL)
+            write_ob_word(writer, address + count, words);
+        count++;
         
-        word = strtok(NULL, "\n");
+        words = (word_end != NULL) ? word_end + 1 : NULL;
     }
     
-    return result;
+    return count;
 }
 
 
-second_pass_result* second_pass(char* as_text, char* am_text, int IC, int DC, int has_error, label_node** label_head, extern_node** extern_head, entry_node** entry_head) {
+/* adds every operand of the instruction at the address that is an external to the list, with the address of its word.
+ * unlike the .ext text every external operand is added, each with the address of its own word */
+void add_external_words(sentence s, int address, extern_node* extern_head, symbol_node** externals) {
+    int word; /* the address of the operand's first word */
+    int i;
     
-    char* result;
+    word = address + 1;
+    for (i=0; i<s.argc && i<2; i++) {
+        arg_type type = get_arg_type(s.argv[i]);
+        
+        if (type == VARIABLE && get_extern(extern_head, s.argv[i]) != NULL)
+            add_symbol_node(externals, s.argv[i], word);
+        else if (type == ARRAY_AND_INDEX) {
+            char* name = get_array_name(s.argv[i]);
+            if (get_extern(extern_head, name) != NULL)
+                add_symbol_node(externals, name, word);
+            FREE(name);
+        }
+        word += number_of_machine_words_one_arg(type);
+    }
+}
+
+/* puts count words into place, from values or (when values is NULL) from the binary strings that write_words split */
+void put_object_words(int* place, int* values, char* binary, int count) {
+    int i;
+    for (i=0; i<count; i++) {
+        if (values != NULL)
+            place[i] = values[i];
+        else {
+            place[i] = (int)strtol(binary, NULL, 2);
+            binary += strlen(binary) + 1;
+        }
+    }
+}
+
+/* this function performs the second pass, it encodes every sentence and writes the words to the .ob file as soon as they are encoded.
+ * writer is the .ob writer (NULL when nothing is encoded: the first pass found an error or only the errors are wanted), errors are reported to diag,
+ * options are how the words are encoded (NULL for the defaults),
+ * it returns the .ent and .ext texts or NULL if an error was found (and then the .ob file should be thrown away) */
+second_pass_result* second_pass(char* as_text, char* am_text, int IC, int DC, int has_error, label_node** label_head, extern_node** extern_head, entry_node** entry_head, ob_writer* writer, pass_options* options, diagnostics* diag) {
+    
+    int address; /* the address of the next word */
+    
+    text_buffer ent_text;
+    text_buffer ext_text;
+    symbol_node* entries;
+    symbol_node* externals;
     
-    char* ent_text;
-    char* ext_text;
+    /* the words of the binary object are where the addresses of the labels put them, the code words one after the other
+     * from FIRST_ADDRESS and the data words after all of the code. the .ob file has them in the order of the source,
+     * so the two only differ when data comes before code */
+    int* object_words;
+    int code_address;
+    int data_address;
     
     define_node* define_n;
     define_node** define_head;
     
     char* line;
+    line_reader reader;
+    line_map as_lines; /* the line numbers of the messages */
+    pass_options default_options;
     
     
-    result = NULL;
+    address = FIRST_ADDRESS;
+    start_line_map(&as_lines, as_text);
     
-    ent_text = NULL;
-    ext_text = NULL;
+    start_text(&ent_text);
+    start_text(&ext_text);
+    entries = NULL;
+    externals = NULL;
+    object_words = NULL;
+    code_address = FIRST_ADDRESS;
+    data_address = FIRST_ADDRESS + IC;
+    if (options == NULL) {
+        memset(&default_options, 0, sizeof(pass_options));
+        options = &default_options;
+    }
+    if (options->collect_symbols && writer != NULL && !has_error) {
+        object_words = (int*)MALLOC((IC + DC + 1) * sizeof(int)); /* +1 so an empty program still gets an array */
+        if (object_words == NULL) {
+            printf("Memory allocation failed\n");
+            exit(EXIT_FAILURE);
+        }
+    }
     
     define_n = NULL;
     define_head = &define_n; /* create .define list */
     
-    /* Using strtok to split the string every new line */
-    line = strtok(am_text, "\n");
+    /* go through every line of the .am text */
+    start_lines(&reader, am_text);
+    line = next_line(&reader);
     
-    while (line != NULL) {
+    while (line != NULL && !too_many_errors(diag)) {
     	int line_num;
+    	int line_error; /* the line has an error (it was reported), nothing more is done with it */
         int i;
         sentence s;
     	
-        line_num = find_line_number(as_text, line);
+        line_num = 0; /* looked up only when a message is reported (see LINE_NUMBER) */
+        line_error = FALSE;
 
         s = to_sentence(line);
 
-        if (s.is_blank || strcmp(s.operation, ".extern")==0) {
-        	free_sentence(s);
-            line = strtok(NULL, "\n");
-            continue;
-        }
+        if (s.is_blank || strcmp(s.operation, ".extern")==0)
+            ; /* nothing to encode */
         
-        if (strcmp(s.operation, ".define")==0) { /* if the line is a define statement */
+        else if (strcmp(s.operation, ".define")==0) { /* if the line is a define statement */
         	char* name;
         	char* value;
 			
-			
-			if (s.label != NULL) { /* the defined value must be an integer */
-                printf("line %d: warning: labels ignored when put on define statements\n", line_num);
-                has_error = TRUE;
-                free_sentence(s);
-                line = strtok(NULL, "\n");
-                continue;
+            if (s.label != NULL) { /* labels can't be put on define statements */
+                report(diag, DEFINE_WITH_LABEL, LINE_NUMBER, line, s.label, NULL);
+                line_error = TRUE;
             }
-			
-			
-            /* check arguments validity */
-            if (s.argc != 2) { /* if there arn't the expected 2 arguments */
-                printf("line %d: error: define statement should be structured as such: \".define <name>=<value>\"\n", line_num);
-                has_error = TRUE;
-                free_sentence(s);
-                line = strtok(NULL, "\n");
-                continue;
-            }
-            
-            name = s.argv[0];
-            value = s.argv[1];
-
-            if (!is_valid_name(name)) { /* if the name isn't valid */
-                printf("line %d: error: Name Must Strart With A Latin Letter And Consist Of Only Latin Letters Or Numbers\n", line_num);
-                has_error = TRUE;
-                free_sentence(s);
-                line = strtok(NULL, "\n");
-                continue;
+            else if (s.argc != 2) { /* if there arn't the expected 2 arguments */
+                report(diag, DEFINE_STRUCTURE, LINE_NUMBER, line, NULL, NULL);
+                line_error = TRUE;
             }
-            
-            if (is_conserved_word(name)) { /* if the name is a conserved word */
-                printf("line %d: error: instructions, operations, registers and other conserved words can't be defined\n", line_num);
-                has_error = TRUE;
-                free_sentence(s);
-                line = strtok(NULL, "\n");
-                continue;
-            }
-            
-            if (!is_integer(value)) { /* the defined value must be an integer */
-                printf("line %d: error: the defined value must be an integer\n", line_num);
-                has_error = TRUE;
-                free_sentence(s);
-                line = strtok(NULL, "\n");
-                continue;
-            }
-            
-            add_define(define_head, name, to_integer(value)); /* if no errors were found, add the definition to the list */
-            free_sentence(s);
-            line = strtok(NULL, "\n");
-            continue;
-        }
+            else {
+                name = s.argv[0];
+                value = s.argv[1];
 
-        /* turns all of the data that uses a defined variable into the appropriate integers */
-        else if (strcmp(s.operation, ".data")==0) {
-            for (i=0; i<s.argc; i++) {
-            	char* arg;
-            	define_node* n;
-            	
-                arg = s.argv[i];
-                n = get_define(*define_head, arg);
-                if (n!=NULL) { /* if the arg is a defined value */
-                    free(s.argv[i]);
-                    s.argv[i] = data_number_to_string(n->value); /* put the integer into its place */
+                if (!is_valid_name(name)) { /* if the name isn't valid */
+                    report(diag, DEFINE_INVALID_NAME, LINE_NUMBER, line, name, NULL);
+                    line_error = TRUE;
+                }
+                else if (is_conserved_word(name)) { /* if the name is a conserved word */
+                    report(diag, DEFINE_CONSERVED_WORD, LINE_NUMBER, line, name, NULL);
+                    line_error = TRUE;
                 }
+                else if (!is_integer(value)) { /* the defined value must be an integer */
+                    report(diag, DEFINE_NOT_INTEGER, LINE_NUMBER, line, value, NULL);
+                    line_error = TRUE;
+                }
+                else
+                    add_define(define_head, name, to_integer(value)); /* if no errors were found, add the definition to the list */
             }
         }
-		
+
         else if (strcmp(s.operation, ".entry")==0) { /* if the operation is .entry */
         	char* name;
         	label_node* l;
         	
-        	int length;
-        	int spacing;
-        	
-        	char* four_digit_string;
-        
-            name = s.argv[0];
-
-           	l = get_label(*label_head, name);
+            name = (s.argc == 1) ? s.argv[0] : NULL;
+           	l = (name != NULL) ? get_label(*label_head, name) : NULL;
             
-            if (l==NULL) { /* if the entry is not defined in file */
-                printf("line %d: error: cannot use .entry on a non existent label\n", line_num);
-                has_error = TRUE;
-                free_sentence(s);
-                line = strtok(NULL, "\n");
-                continue;
+            if (name == NULL) { /* a .entry without its one name was reported by the first pass (see find_error) */
+                line_error = TRUE;
             }
+            else if (l==NULL) { /* if the entry is not defined in file */
+                report(diag, UNKNOWN_ENTRY, LINE_NUMBER, line, name, NULL);
+                line_error = TRUE;
+            }
+            else { /* add the entry to the ent text */
+            	int length;
+            	int spacing;
+            	char* four_digit_string;
             
-            
-            /* add the entry to the ent text */
-            
-            ent_text = merge_strings(ent_text, name); /* add the name to the ent text */
+                add_text(&ent_text, name); /* add the name to the ent text */
 
-            /* put spaces between the name and the line number */
-            length = strlen(name);
-            spacing = length>9 ? 1 : 10-length;
-            for (i=0; i<spacing; i++) 
-                ent_text = merge_strings(ent_text, " ");
-            
-            four_digit_string = int_to_four_digit_string(l->line);
-            
-            ent_text = merge_strings(ent_text, four_digit_string); /* add the line number */
-            ent_text = merge_strings(ent_text, "\n"); /* start new line */
-            
-            free(four_digit_string);
-            
-            free_sentence(s);
-            line = strtok(NULL, "\n");
-            continue;
-        }
-        
-        for (i=0; i<s.argc; i++) { /* go through every argument in the current sentence */
-        	char* arg;
-        	arg_type type;
-        	
-            arg = s.argv[i];
-            type = get_arg_type(arg);
-            
-            if (type == NUMBER) { /* if the arg is a number */
-            	define_node* n;
-            	
-                arg++;
+                /* put spaces between the name and the line number */
+                length = strlen(name);
+                spacing = length>9 ? 1 : 10-length;
+                for (i=0; i<spacing; i++) 
+                    add_text(&ent_text, " ");
                 
-                n = get_define(*define_head, arg);
+                four_digit_string = int_to_four_digit_string(l->line);
                 
-                if (n!=NULL) { /* if the number is a defined value, change it back to the integer */
-                    free(s.argv[i]);
-                    s.argv[i] = number_to_string(n->value);
-                }
+                add_text(&ent_text, four_digit_string); /* add the line number */
+                add_text(&ent_text, "\n"); /* start new line */
                 
-                else if (!is_integer(arg) && get_define(*define_head, arg)==NULL) { /* if the arg is not defined and is not a number, output an error */
-                    printf("line %d: error: invalid integer\n", line_num);
-                    has_error = TRUE;
-                    free_sentence(s);
-                    line = strtok(NULL, "\n");
-                    continue;
+                FREE(four_digit_string);
+                if (options->collect_symbols)
+                    add_symbol_node(&entries, name, l->line);
+            }
+        }
+        
+        else { /* an instruction or data */
+            int external_written = FALSE; /* only the first external operand of a sentence is in the .ext text */
+
+            /* turns all of the data that uses a defined variable into the appropriate integers */
+            if (strcmp(s.operation, ".data")==0) {
+                for (i=0; i<s.argc; i++) {
+                	define_node* n = get_define(*define_head, s.argv[i]);
+                    if (n!=NULL) { /* if the arg is a defined value */
+                        FREE(s.argv[i]);
+                        s.argv[i] = data_number_to_string(n->value); /* put the integer into its place */
+                    }
                 }
             }
-            else if (type == VARIABLE) { /* if the type of the arg is a variable */
-				
-                extern_node* ext_n = get_extern(*extern_head, arg);
-                if (ext_n != NULL) { /* if the variable is external */
+            
+            for (i=0; i<s.argc && !line_error; i++) { /* go through every argument in the current sentence */
+            	char* arg;
+            	char* name; /* the variable the argument uses (NULL if none) */
+            	char* index;
+            	arg_type type;
+            	
+                arg = s.argv[i];
+                type = get_arg_type(arg);
+                name = NULL;
+                index = NULL;
                 
-                	int length;
-                	int spacing;
+                if (type == NUMBER) { /* if the arg is a number */
+                	define_node* n;
                 	
-                    ext_text = merge_strings(ext_text, arg); /* add the name to the ext text */
+                    arg++;
+                    n = get_define(*define_head, arg);
                     
-                    /* put spaces between the name and the line number */
-                    length = strlen(arg);
-                    spacing = length>9 ? 1 : 10-length;
-
-                    for (i=0; i<spacing; i++) 
-                        ext_text = merge_strings(ext_text, " ");
-
-                    if (i==0){ /* if it is the first operator */
-                        char* memory_address;
-                        memory_address = int_to_four_digit_string(100+count_lines(result));
-                        ext_text = merge_strings(ext_text, memory_address); /* add the line number */
-                        ext_text = merge_strings(ext_text, "\n"); /* start new line */
-                        free(memory_address);
-                    } else { /* if it's the second operator */
-                    	int first_op_len;
-                    	char* memory_address;
-                    	
-                        first_op_len = number_of_machine_words_one_arg(get_arg_type(s.argv[0])); /* length (in machine words) of the first operator */
-                        memory_address = int_to_four_digit_string(100+first_op_len+count_lines(result));
-                        ext_text = merge_strings(ext_text, memory_address); /* add the line number */
-                        ext_text = merge_strings(ext_text, "\n"); /* start new line */
-                        free(memory_address);
+                    if (n!=NULL) { /* if the number is a defined value, change it back to the integer */
+                        FREE(s.argv[i]);
+                        s.argv[i] = number_to_string(n->value);
                     }
+                    else if (!is_integer(arg)) { /* if the arg is not defined and is not a number, output an error */
+                        report(diag, INVALID_INTEGER, LINE_NUMBER, line, arg, NULL);
+                        line_error = TRUE;
+                    }
+                    continue;
                 }
                 
-                else if (get_label(*label_head, arg)==NULL) { /* if the variable doesn't exist, raise an error */
-                    printf("line %d: error: unknown variable: %s\n", line_num, arg);
-                    has_error = TRUE;
-                    free_sentence(s);
-                    line = strtok(NULL, "\n");
-                    break;
+                if (type == VARIABLE) /* if the type of the arg is a variable */
+                    name = arg;
+                else if (type == ARRAY_AND_INDEX) { /* if the variable is an array and index, seperate the name and the index */
+                    name = get_array_name(arg);
+                    index = get_array_index(arg);
                 }
-            }
-            else if (type == ARRAY_AND_INDEX) { /* if the variable is an array and index */
-            	char* name;
-            	char* index;
-            	
-            	extern_node* ext_n;
-				define_node* n;
+                else
+                    continue;
                 
-                /* seperate the name and the index */
-                name = get_array_name(arg);
-                index = get_array_index(arg);
-				
-				ext_n = get_extern(*extern_head, name);
-				
-                if (ext_n != NULL) { /* if the array is external */
+                if (get_extern(*extern_head, name) != NULL && !external_written) { /* if the variable is external */
                 	int length;
                 	int spacing;
+                	int j;
+                	char* memory_address;
                 	
-                    ext_text = merge_strings(ext_text, name); /* add the name to the ext text */
-
+                    add_text(&ext_text, name); /* add the name to the ext text */
+                    
                     /* put spaces between the name and the line number */
                     length = strlen(name);
                     spacing = length>9 ? 1 : 10-length;
+                    for (j=0; j<spacing; j++) 
+                        add_text(&ext_text, " ");
+
+                    /* the address is the one after the words of the first operand, and only the first external operand of
+                     * a sentence is written (the .ext files have always been written this way) */
+                    memory_address = int_to_four_digit_string(address + number_of_machine_words_one_arg(get_arg_type(s.argv[0])));
+                    add_text(&ext_text, memory_address); /* add the line number */
+                    add_text(&ext_text, "\n"); /* start new line */
+                    FREE(memory_address);
+                    external_written = TRUE;
+                }
+                else if (get_extern(*extern_head, name) == NULL && get_label(*label_head, name)==NULL) { /* if the variable doesn't exist, raise an error */
+                    report(diag, UNKNOWN_VARIABLE, LINE_NUMBER, line, name, name);
+                    line_error = TRUE;
+                }
 
-                    for (i=0; i<spacing; i++) 
-                        ext_text = merge_strings(ext_text, " ");
-
-                    if (i==0){ /* if it is the first operator */
-                        char* memory_address;
-                        memory_address = int_to_four_digit_string(100+count_lines(result));
-                        ext_text = merge_strings(ext_text, memory_address); /* add the line number */
-                        ext_text = merge_strings(ext_text, "\n"); /* start new line */
-                        free(memory_address);
-                    } else { /* if it's the second operator */
-                    	int first_op_len;
-                    	char* memory_address;
+                /* check if the index is valid */
+                if (index != NULL && !line_error) {
+                    define_node* n = get_define(*define_head, index);
                     
-                        first_op_len = number_of_machine_words_one_arg(get_arg_type(s.argv[0])); /* length (in machine words) of the first operator */
-                        memory_address = int_to_four_digit_string(100+first_op_len+count_lines(result));
-                        ext_text = merge_strings(ext_text, memory_address); /* add the line number */
-                        ext_text = merge_strings(ext_text, "\n"); /* start new line */
-                        free(memory_address);
+                    if (n!=NULL) { /* if the index is a define, turn it to an integer */
+                        FREE(s.argv[i]);
+                        s.argv[i] = reformed_array_and_index(name, n->value);
+                    }
+                    else if (!is_integer(index)) { /* if the index is not an integer, raise an error */
+                        report(diag, INVALID_INDEX, LINE_NUMBER, line, index, NULL);
+                        line_error = TRUE;
                     }
                 }
                 
-                else if (get_label(*label_head, name)==NULL) { /* if the array name doesn't exist, raise an error */
-                    printf("line %d: error: unknown variable: %s\n", line_num, name);
-                    has_error = TRUE;
-                    free_sentence(s);
-                    line = strtok(NULL, "\n");
-                    continue;
+                if (index != NULL) {
+                    FREE(name);
+                    FREE(index);
                 }
-
-
-                /* check if the index is valid */
-                
-                n = get_define(*define_head, index);
+            }
+            
+            if (!line_error && !has_error && writer != NULL) { /* generate the output file only if there in no error (and there is one) */
+                int values[MAX_SENTENCE_WORDS];
+                int count = options->reference_engine ? -1 : encode_sentence(s, label_head, extern_head, define_head, values);
+                char* words = NULL;
                 
-                if (n!=NULL) { /* if the index is a define, turn it to an integer */
-                    free(s.argv[i]);
-                    s.argv[i] = reformed_array_and_index(name, n->value);
+                if (count == -2) { /* can't happen, the operands were checked above */
+                    has_error = TRUE;
+                    count = 0;
+                }
+                else if (count < 0) {
+                    words = to_words(s, label_head, extern_head, entry_head, define_head);
+                    count = write_words(writer, address, words); /* write the words right away */
                 }
+                else {
+                    for (i=0; i<count; i++)
+                        write_ob_value(writer, address + i, values[i]);
+                }
+                address += count;
                 
-                if (!is_integer(index) && n==NULL) { /* if the index is not an integer, raise an error */
-                    printf("line %d: error: invalid index\n", line_num);
-                    has_error = TRUE;
-                    free_sentence(s);
-                    line = strtok(NULL, "\n");
-                    break;
+                if (object_words != NULL) {
+                    int is_data = (s.operation[0] == '.');
+                    int* next = is_data ? &data_address : &code_address;
+                    
+                    if (*next + count <= FIRST_ADDRESS + IC + DC)
+                        put_object_words(object_words + (*next - FIRST_ADDRESS), words == NULL ? values : NULL, words, count);
+                    if (!is_data && *extern_head != NULL)
+                        add_external_words(s, *next, *extern_head, &externals);
+                    *next += count;
                 }
-                free(name);
-                free(index);
+                FREE(words);
             }
         }
-        if (i<s.argc) continue;
         
-        if (!has_error) { /* generate the output file only if there in no error */
-        	char* words = to_words(s, label_head, extern_head, entry_head, define_head);
-            ADD_TO_RESULT(words);
-            free(words);
-        }
+        if (line_error)
+            has_error = TRUE;
         
         /* free the sentence */
         free_sentence(s);
-        line = strtok(NULL, "\n");
+        line = next_line(&reader);
     }
+    end_lines(&reader);
+    free_line_map(&as_lines);
 	
 	/* free the define list */
     free_defines(*define_head);
     
     if (!has_error) { /* if no error was found, we output result to be created into output files */
-        second_pass_result* output = (second_pass_result*)malloc(sizeof(second_pass_result));
-		
-        char* encrypted_result = to_ob_file(result, IC, DC); /* encrypt all of the words and memory addresses */
-        free(result); /* free allocated memory for the unencrypted result */
+        second_pass_result* output = (second_pass_result*)MALLOC(sizeof(second_pass_result));
 
-        output->machine_code = encrypted_result;
-        output->ent_file = ent_text;
-        output->ext_file = ext_text;
+        output->ent_file = ent_text.text;
+        output->ext_file = ext_text.text;
+        output->IC = IC;
+        output->DC = DC;
+        output->words = object_words;
+        output->entries = entries;
+        output->externals = externals;
 
         return output; /* return all of the output files */
     }
     
-    free(result);
-    free(ext_text);
-    free(ent_text);
+    FREE(ext_text.text);
+    FREE(ent_text.text);
+    FREE(object_words);
+    free_symbol_nodes(entries);
+    free_symbol_nodes(externals);
     
     return NULL; /* return NULL if an error was found */
 }
@@ -1,7 +1,22 @@
 typedef enum {ABSOLUTE_ARE=0, EXTERNAL_ARE=1, RELOCATABLE_ARE=2} ARE_field;
 
+/* the most words a sentence is encoded into (a .string of a whole line and its null terminator) */
+#define MAX_SENTENCE_WORDS 82
 
-second_pass_result* second_pass(char* as_text, char* am_text, int IC, int DC, int has_error, label_node** label_head, extern_node** extern_head, entry_node** entry_head);
+
+char* decimal_to_n_bit_binary(int num, int num_bits);
+
+char* get_array_name(char* str);
+
+char* get_array_index(char* arg);
+
+char* to_words(sentence s, label_node** label_head, extern_node** extern_head, entry_node** entry_head, define_node** define_head);
+
+int encode_sentence(sentence s, label_node** label_head, extern_node** extern_head, define_node** define_head, int* words);
+
+int write_words(ob_writer* writer, int address, char* words);
+
+second_pass_result* second_pass(char* as_text, char* am_text, int IC, int DC, int has_error, label_node** label_head, extern_node** extern_head, entry_node** entry_head, ob_writer* writer, pass_options* options, diagnostics* diag);
 
 
 extern struct opcode_list_struct {
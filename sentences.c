@@ -2,6 +2,9 @@
 #include <stdlib.h>
 #include <string.h>
 #include "sentences.h"
+#include "alloc.h"
+
+#define ALLOC_SUBSYSTEM ALLOC_SENTENCES
 
 
 /* macro for skipping all white characters in a string */
@@ -27,6 +30,7 @@ sentence create_sentence() {
     s.argv = NULL;
     s.is_blank = FALSE;
     s.err = NULL;
+    s.err_token = NULL;
     
     return s;
 }
@@ -34,9 +38,9 @@ sentence create_sentence() {
 /* Function to add an argument to the sentence */
 void add_arg(sentence *sent, char *arg) {
     if (sent->argc == 0) { /* if this is the first argument, regular mallloc */
-        sent->argv = malloc(sizeof(char*));
+        sent->argv = MALLOC(sizeof(char*));
     } else { /* else, realloc */
-        sent->argv = realloc(sent->argv, (sent->argc + 1) * sizeof(char*));
+        sent->argv = REALLOC(sent->argv, (sent->argc + 1) * sizeof(char*));
     }
     if (sent->argv == NULL) { /* Handle memory allocation failure */
         printf("Error: Memory allocation failed\n");
@@ -51,15 +55,16 @@ void free_sentence(sentence sntnc) {
 	int i;
 	
     /* Free dynamically allocated memory for label and operation */
-    free(sntnc.label);
-    free(sntnc.operation);
+    FREE(sntnc.label);
+    FREE(sntnc.operation);
+    FREE(sntnc.err_token);
 	
     /* Free dynamically allocated memory for each argument */
     if (sntnc.argc > 0 && sntnc.argv != NULL) {
         for (i = 0; i < sntnc.argc; i++) {
-            free(sntnc.argv[i]);
+            FREE(sntnc.argv[i]);
         }
-        free(sntnc.argv);
+        FREE(sntnc.argv);
     }
 }
 
@@ -69,6 +74,23 @@ int isBlank(char *line) {
     return (*line=='\0' || *line==';');
 }
 
+/* returns a copy of the first length chars of the text (the part of the line an error is about) */
+char* copy_token(char* text, int length) {
+    char* token;
+
+    /* without the spaces after it */
+    while (length > 0 && (text[length-1] == ' ' || text[length-1] == '\t' || text[length-1] == '\n'))
+        length--;
+    token = (char*)MALLOC(length + 1);
+    if (token == NULL) {
+        printf("memory allocation failed\n");
+        exit(1);
+    }
+    strncpy(token, text, length);
+    token[length] = '\0';
+    return token;
+}
+
 /* the given line is expected to start from the name and the given sentence already has ".define" as the operation */
 void to_define_sentence(sentence* sent, char* line) {
 	int length;
@@ -85,7 +107,7 @@ void to_define_sentence(sentence* sent, char* line) {
     }
 
     /* malloc for the name */
-    name = (char*)malloc((length + 1) * sizeof(char));
+    name = (char*)MALLOC((length + 1) * sizeof(char));
     if (name == NULL) {
         printf("memory allocation failed\n");
         exit(1);
@@ -97,7 +119,7 @@ void to_define_sentence(sentence* sent, char* line) {
     
     SKIP_SPACES(temp);
     if (*temp != '=') { /* if the next char after the name isn't '=' raise error */
-        free(name);
+        FREE(name);
         sent->err = "Invalid .define statement, Expected: \".define <name> = <value>\"";
         return;
     }
@@ -113,7 +135,7 @@ void to_define_sentence(sentence* sent, char* line) {
     }
     
     /* malloc for the value */
-    value = (char*)malloc((length + 1) * sizeof(char));
+    value = (char*)MALLOC((length + 1) * sizeof(char));
     if (value == NULL) {
         printf("memory allocation failed\n");
         exit(1);
@@ -125,8 +147,8 @@ void to_define_sentence(sentence* sent, char* line) {
 
     SKIP_SPACES(temp);
     if (*temp != '\0') { /* if the line didn't end after the value there is a problem with the statement */
-        free(value);
-        free(name);
+        FREE(value);
+        FREE(name);
         sent->err = "Invalid .define statement, Expected: \".define <name> = <value>\"";
         return;
     }
@@ -162,7 +184,7 @@ sentence to_sentence_no_label(char* line) {
     }
 
     /* Allocate memory for the operation plus the null terminator */
-    operation = (char*)malloc((length + 1) * sizeof(char));
+    operation = (char*)MALLOC((length + 1) * sizeof(char));
     if (operation == NULL) {
         printf("memory allocation failed\n");
         exit(1);
@@ -197,6 +219,7 @@ sentence to_sentence_no_label(char* line) {
                 while (*temp!=']') {
                     if (*temp=='\0') {
                         sent.err="Unclosed Square Brackets";
+                        sent.err_token = copy_token(line, strlen(line)); /* the argument */
                         return sent;
                     }
                     length++;
@@ -209,6 +232,7 @@ sentence to_sentence_no_label(char* line) {
                 while (*temp!='"') {
                     if (*temp=='\0') {
                         sent.err="Unclosed Quotes";
+                        sent.err_token = copy_token(line, strlen(line));
                         return sent;
                     }
                     length++;
@@ -219,7 +243,7 @@ sentence to_sentence_no_label(char* line) {
             temp++;
         }
         /* Allocate memory for the operation plus the null terminator */
-        arg = (char*)malloc((length + 1) * sizeof(char));
+        arg = (char*)MALLOC((length + 1) * sizeof(char));
         if (arg == NULL) {
             printf("memory allocation failed");
             exit(1);
@@ -239,6 +263,7 @@ sentence to_sentence_no_label(char* line) {
         
         if (*line != ',') { /* if the next argument apears without a comma it's an argument error */
             sent.err = "Missing Comma Between Arguments";
+            sent.err_token = copy_token(line, strcspn(line, " \t\n,")); /* the argument after the missing comma */
             return sent;
         }
         line++;
@@ -285,7 +310,7 @@ sentence to_sentence(char *line) {
         error = "':' Must Be Attached To The End Of The Label";
     }
     /* Allocate memory for the operation plus the null terminator */
-    label = (char*)malloc((length + 1) * sizeof(char));
+    label = (char*)MALLOC((length + 1) * sizeof(char));
     if (label == NULL) return create_sentence(); /* Memory allocation failed */
 
     /* Copy the operation into the dynamically allocated memory */
@@ -298,6 +323,8 @@ sentence to_sentence(char *line) {
     
     s = to_sentence_no_label(line);
     s.err = error;
+    FREE(s.err_token); /* the error of the label replaces the one of the rest of the line */
+    s.err_token = (error != NULL) ? copy_token(label, length) : NULL;
     s.label = label;
     return s;
 }
@@ -11,6 +11,7 @@ typedef struct {
     char **argv; /* all provided arguments */
     int is_blank; /* is the line blank or a comment */
     char* err; /* the error message */
+    char* err_token; /* a copy of the part of the line the error is about, NULL when it's about the whole line */
 } sentence;
 
 
@@ -0,0 +1,218 @@
+/* checks the assembler server against requests that used to break it (make server-test):
+ *
+ *     server_test [assembler]
+ *
+ * the assembler (./all when not given) is started with --serve on SERVER_TEST_SOCKET and every request is sent to it
+ * the way a client would. a request must get the expected response, or have its connection closed, and the server must
+ * still be running after it. returns 1 if any of them went wrong */
+
+#define _GNU_SOURCE /* for memfd_create */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include "sentences.h"
+#include "daemon.h"
+#include "alloc.h"
+
+#define ALLOC_SUBSYSTEM ALLOC_DRIVER
+
+
+#define SERVER_TEST_SOCKET "server_test.sock"
+
+/* a file for the requests that pass a descriptor */
+#define SERVER_TEST_FILE "server_test.as"
+
+/* the requests with a file that is truncated right after it was sent */
+#define TRUNCATED_REQUESTS 200
+#define LONG_SOURCE_LINES 2000
+
+/* how long a response can take before the server is considered stuck */
+#define RESPONSE_SECONDS 5
+
+pid_t server;
+int running = TRUE; /* FALSE once the server's exit was seen */
+
+
+/* connects to the server, waiting for it to start. returns the socket or -1 */
+int connect_waiting(void) {
+    struct timespec pause;
+    struct timeval timeout;
+    int fd;
+    int i;
+
+    pause.tv_sec = 0;
+    pause.tv_nsec = 100000000;
+    for (i=0; i<50 && (fd = connect_to_server(SERVER_TEST_SOCKET)) < 0; i++)
+        nanosleep(&pause, NULL);
+    if (fd < 0)
+        return -1;
+
+    /* a server that doesn't answer fails the test instead of blocking it */
+    timeout.tv_sec = RESPONSE_SECONDS;
+    timeout.tv_usec = 0;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return fd;
+}
+
+/* returns whether the server process is still running */
+int server_running(void) {
+    int status;
+    if (!running || waitpid(server, &status, WNOHANG) == 0)
+        return running;
+    running = FALSE;
+    if (WIFSIGNALED(status))
+        printf("the server was killed by signal %d\n", WTERMSIG(status));
+    else
+        printf("the server exited with %d\n", WEXITSTATUS(status));
+    return FALSE;
+}
+
+/* sends the source inline or in the descriptor source_fd (when it isn't -1) and checks the response.
+ * the status must be the expected one and the messages must have the text expected in them,
+ * an expected status of -1 means the server must close the connection. returns whether it did */
+int check_request(char* name, char* source, int source_fd, int expected_status, char* expected) {
+    response r;
+    int fd;
+    int sent;
+    int passed;
+
+    fd = connect_waiting();
+    if (fd < 0) {
+        printf("%s: can't connect to the server\n", name);
+        return FALSE;
+    }
+
+    if (source_fd != -1)
+        sent = send_header(fd, "fd", 0, source_fd);
+    else
+        sent = send_header(fd, "source", strlen(source), -1) && send_all(fd, source, strlen(source));
+
+    if (!sent || !receive_response(fd, &r)) /* the server closed the connection, or didn't answer in time */
+        passed = (expected_status == -1) && errno != EAGAIN && errno != EWOULDBLOCK;
+    else {
+        passed = r.status == expected_status &&
+                 (expected == NULL || (r.sections[0] != NULL && strstr(r.sections[0], expected) != NULL));
+        free_response(&r);
+    }
+    close(fd);
+
+    passed = server_running() && passed;
+    printf("%s: %s\n", name, passed ? "passed" : "failed");
+    return passed;
+}
+
+/* sends the file in fd and truncates it right away, any response is fine (the file may be read before or after).
+ * returns FALSE if the server couldn't be reached */
+int send_truncated(int source_fd) {
+    response r;
+    int fd;
+
+    fd = connect_waiting();
+    if (fd < 0)
+        return FALSE;
+    if (send_header(fd, "fd", 0, source_fd) && ftruncate(source_fd, 0) == 0 && receive_response(fd, &r))
+        free_response(&r);
+    close(fd);
+    return TRUE;
+}
+
+/* writes the source to SERVER_TEST_FILE and returns it open for reading (-1 if it can't) */
+int source_file_fd(char* source) {
+    FILE* file = fopen(SERVER_TEST_FILE, "w");
+    if (file == NULL)
+        return -1;
+    fputs(source, file);
+    fclose(file);
+    return open(SERVER_TEST_FILE, O_RDONLY);
+}
+
+int main(int argc, char* argv[]) {
+    char* assembler;
+    char long_source[LONG_SOURCE_LINES * 8 + 1];
+    int failed;
+    int fd;
+    int i;
+
+    assembler = (argc > 1) ? argv[1] : "./all";
+
+    /* a source of a few pages, so it is still being read when it is truncated */
+    for (i=0; i<LONG_SOURCE_LINES; i++)
+        strcpy(long_source + i * 8, "    hlt\n");
+
+    server = fork();
+    if (server < 0) {
+        perror("fork");
+        return 1;
+    }
+    if (server == 0) {
+        freopen("/dev/null", "w", stdout);
+        execl(assembler, assembler, "--serve", SERVER_TEST_SOCKET, "2", (char*)NULL);
+        perror(assembler);
+        exit(1);
+    }
+
+    failed = 0;
+
+    /* a .entry or .extern without a name, the second pass used to read the name anyway */
+    failed += !check_request("bare .entry", "MAIN: mov r1, r2\n.entry\n    hlt\n", -1, 1, "[E213]");
+    failed += !check_request("bare .extern", "MAIN: mov r1, r2\n.extern\n    hlt\n", -1, 1, "[E213]");
+    fd = source_file_fd("MAIN: mov r1, r2\n.entry\n    hlt\n");
+    failed += !check_request("bare .entry in a file", NULL, fd, 1, "[E213]");
+    if (fd >= 0)
+        close(fd);
+
+    /* a pipe that is never closed used to block a worker forever */
+    {
+        int ends[2];
+        if (pipe(ends) == 0) {
+            write(ends[1], "    hlt\n", 8);
+            failed += !check_request("pipe", NULL, ends[0], -1, NULL);
+            close(ends[0]);
+            close(ends[1]);
+        }
+        else
+            failed++;
+    }
+
+    /* a file that is truncated while the server reads it used to raise SIGBUS in a mapping of it */
+    for (i=0; i<TRUNCATED_REQUESTS && server_running(); i++) {
+        fd = source_file_fd(long_source);
+        if (fd < 0 || !send_truncated(fd))
+            failed++;
+        if (fd >= 0)
+            close(fd);
+    }
+    failed += !check_request("truncated files", "    hlt\n", -1, 2, NULL);
+
+#ifdef MFD_ALLOW_SEALING
+    /* a sealed memfd is mapped */
+    fd = memfd_create("server-test", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd >= 0 && write(fd, "MAIN: mov r1, r2\n.entry MAIN\n    hlt\n", 37) == 37 &&
+        fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE) == 0)
+        failed += !check_request("sealed memfd", NULL, fd, 2, NULL);
+    else
+        failed++;
+    if (fd >= 0)
+        close(fd);
+#endif
+
+    /* the server still answers after all of them */
+    failed += !check_request("valid source", "MAIN: mov r1, r2\n.entry MAIN\n    hlt\n", -1, 2, NULL);
+
+    kill(server, SIGTERM);
+    waitpid(server, NULL, 0);
+    remove(SERVER_TEST_FILE);
+    remove(SERVER_TEST_SOCKET);
+
+    printf("%d of the server's checks failed\n", failed);
+    return failed > 0;
+}
@@ -0,0 +1,339 @@
+/* the differential check of the incremental sessions (make session-differential):
+ *
+ *     session_differential [--seeds=N] [--edits=N] [--lines=N] [files.as]
+ *
+ * every given file and N generated ones (see corpus.c, without macros so the sessions stay incremental) are loaded
+ * into a session (see asm_session.c) and edited N times at random: lines are replaced, inserted and removed, with lines
+ * of the file itself and with lines that only some places accept (names that are defined later or never).
+ * after every edit asm_session_result must give the same result as asm_compile_buffer of the same text,
+ * the first edit where it doesn't is printed. returns 1 if any of them was different */
+
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "sentences.h"
+#include "utils.h"
+#include "asm.h"
+#include "alloc.h"
+
+#define ALLOC_SUBSYSTEM ALLOC_DRIVER
+
+
+#define DEFAULT_SEEDS 10
+#define DEFAULT_EDITS 500
+#define DEFAULT_LINES 300
+
+/* where the generated files go */
+#define DIFFERENTIAL_DIR "differential_corpus"
+
+/* room for the lines of an edit, at most 3 lines of at most 200 characters */
+#define UNDO_LENGTH 1024
+
+/* lines that are added besides the lines of the file */
+#define EXTRA_LINES 12
+
+char* extra_lines[EXTRA_LINES] = {
+    "    .data k9", /* k9 is never defined, or only after the line */
+    "K9LATE: .data k9, 1",
+    ".define k9 = 3",
+    "    .data 1, -2, 3",
+    "XNEW: mov r1, r2",
+    "    inc XNEW",
+    "    jmp XNEW",
+    "XSTR: .string \"abc\"",
+    "    prn #-1",
+    "    mov XSTR[1], r3",
+    "",
+    "; a comment"
+};
+
+/* the lines of the text the session should have */
+typedef struct text_lines {
+    char** lines;
+    int count;
+    int capacity;
+} text_lines;
+
+unsigned long random_state;
+
+int next_random(int limit) {
+    random_state = random_state * 1103515245 + 12345;
+    return (int)((random_state >> 16) % limit);
+}
+
+void split_text(char* text, text_lines* t) {
+    t->count = 0;
+    t->capacity = 16;
+    t->lines = (char**)MALLOC(t->capacity * sizeof(char*));
+    while (t->lines != NULL && *text != '\0') {
+        int length = strcspn(text, "\n");
+        if (t->count == t->capacity) {
+            t->capacity *= 2;
+            t->lines = (char**)REALLOC(t->lines, t->capacity * sizeof(char*));
+            if (t->lines == NULL)
+                break;
+        }
+        t->lines[t->count] = (char*)MALLOC(length + 1);
+        if (t->lines[t->count] == NULL)
+            break;
+        memcpy(t->lines[t->count], text, length);
+        t->lines[t->count++][length] = '\0';
+        text += length + (text[length] == '\n');
+    }
+    if (t->lines == NULL) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+}
+
+/* returns the text of the lines (allocated) */
+char* join_text(text_lines* t, long* length) {
+    char* text;
+    int i;
+
+    *length = 0;
+    for (i=0; i<t->count; i++)
+        *length += strlen(t->lines[i]) + 1;
+    text = (char*)MALLOC(*length + 1);
+    if (text == NULL) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    text[0] = '\0';
+    *length = 0;
+    for (i=0; i<t->count; i++)
+        *length += sprintf(text + *length, "%s\n", t->lines[i]);
+    return text;
+}
+
+void free_text_lines(text_lines* t) {
+    int i;
+    for (i=0; i<t->count; i++)
+        FREE(t->lines[i]);
+    FREE(t->lines);
+}
+
+/* replaces removed lines from the index first with the lines of the text (every one of them ends with a new line) */
+void edit_text(text_lines* t, int first, int removed, char* text) {
+    int added;
+    int i;
+
+    for (i=first; i<first+removed; i++)
+        FREE(t->lines[i]);
+    memmove(t->lines + first, t->lines + first + removed, (t->count - first - removed) * sizeof(char*));
+    t->count -= removed;
+
+    for (added=0; *text != '\0'; added++) {
+        int length = strcspn(text, "\n");
+        if (t->count == t->capacity) {
+            t->capacity *= 2;
+            t->lines = (char**)REALLOC(t->lines, t->capacity * sizeof(char*));
+            if (t->lines == NULL) {
+                printf("Memory allocation failed\n");
+                exit(1);
+            }
+        }
+        memmove(t->lines + first + added + 1, t->lines + first + added, (t->count - first - added) * sizeof(char*));
+        t->lines[first + added] = (char*)MALLOC(length + 1);
+        if (t->lines[first + added] == NULL) {
+            printf("Memory allocation failed\n");
+            exit(1);
+        }
+        memcpy(t->lines[first + added], text, length);
+        t->lines[first + added][length] = '\0';
+        t->count++;
+        text += length + 1;
+    }
+}
+
+/* returns a line of the text to add again, without its label (it would be defined twice) */
+char* copied_line(text_lines* t) {
+    char* line;
+    int length;
+
+    if (t->count == 0)
+        return "";
+    line = t->lines[next_random(t->count)];
+    for (length = 0; isalnum((unsigned char)line[length]); length++)
+        ;
+    if (length > 0 && line[length] == ':')
+        return line + length + 1;
+    return line;
+}
+
+int same_string(char* a, char* b) {
+    return (a == NULL || b == NULL) ? a == b : strcmp(a, b) == 0;
+}
+
+/* prints the first part where the results are different, returns whether they are the same */
+int same_result(char* filename, int edit, asm_result* session, asm_result* full) {
+    char* different = NULL;
+    int i;
+
+    if (session->succeeded != full->succeeded)
+        different = "succeeded";
+    else if (!same_string(session->am, full->am))
+        different = ".am";
+    else if (!same_string(session->ob, full->ob))
+        different = ".ob";
+    else if (!same_string(session->ent, full->ent))
+        different = ".ent";
+    else if (!same_string(session->ext, full->ext))
+        different = ".ext";
+    else if (session->message_count != full->message_count)
+        different = "messages";
+    for (i=0; different == NULL && i<full->message_count; i++)
+        if (session->messages[i].line != full->messages[i].line || session->messages[i].column != full->messages[i].column ||
+            strcmp(session->messages[i].code, full->messages[i].code) != 0 ||
+            strcmp(session->messages[i].message, full->messages[i].message) != 0)
+            different = "messages";
+
+    if (different != NULL)
+        printf("%s: after edit %d the %s of the session are different from assembling the whole text\n",
+               filename, edit, different);
+    return different == NULL;
+}
+
+/* edits the file in a session, returns whether every result was the same as assembling the whole text */
+int check_session(char* filename, int edits) {
+    source_file source;
+    text_lines t;
+    asm_context* context;
+    asm_session* session;
+    char undo_text[UNDO_LENGTH];
+    int undo_first;
+    int undo_removed;
+    int succeeded;
+    int same;
+    int edit;
+
+    if (!read_file(filename, &source)) {
+        printf("error: can't read %s\n", filename);
+        return FALSE;
+    }
+    split_text(source.text, &t);
+    context = asm_create_context(NULL);
+    session = asm_session_create(context);
+    asm_session_load(session, source.text, source.length);
+    close_file(&source);
+
+    same = TRUE;
+    succeeded = TRUE;
+    undo_first = 0;
+    undo_removed = 0;
+    undo_text[0] = '\0';
+    for (edit = 1; edit <= edits && same; edit++) {
+        int first;
+        int removed;
+        char text[UNDO_LENGTH];
+        asm_result session_result;
+        asm_result full_result;
+        char* full_text;
+        long length;
+        int i;
+
+        if (!succeeded) { /* an edit that breaks the source is undone, so the session gets back to being incremental */
+            first = undo_first;
+            removed = undo_removed;
+            strcpy(text, undo_text);
+        }
+        else {
+            char* line = NULL;
+            first = next_random(t.count + 1);
+            removed = 0;
+            switch (next_random(3)) {
+                case 0: /* replaces a line */
+                    removed = (first < t.count);
+                case 1: /* adds a line */
+                    line = next_random(3) == 0 ? extra_lines[next_random(EXTRA_LINES)] : copied_line(&t);
+                    break;
+                default: /* removes up to 3 lines */
+                    removed = next_random(3) + 1;
+                    if (first + removed > t.count)
+                        removed = t.count - first;
+            }
+            text[0] = '\0';
+            if (line != NULL)
+                sprintf(text, "%.200s\n", line);
+        }
+
+        /* what gives back the lines before the edit */
+        undo_first = first;
+        undo_removed = 0;
+        for (i=0; text[i] != '\0'; i++)
+            undo_removed += (text[i] == '\n');
+        undo_text[0] = '\0';
+        for (i=first; i<first+removed; i++)
+            sprintf(undo_text + strlen(undo_text), "%.200s\n", t.lines[i]);
+
+        edit_text(&t, first, removed, text);
+        asm_session_edit(session, first + 1, removed, text, strlen(text), NULL);
+
+        full_text = join_text(&t, &length);
+        asm_session_result(session, &session_result);
+        succeeded = asm_compile_buffer(context, full_text, length, &full_result);
+        same = same_result(filename, edit, &session_result, &full_result);
+        asm_free_result(context, &session_result);
+        asm_free_result(context, &full_result);
+        FREE(full_text);
+    }
+
+    asm_session_destroy(session);
+    asm_destroy_context(context);
+    free_text_lines(&t);
+    return same;
+}
+
+int main(int argc, char* argv[]) {
+    long lines;
+    int seeds;
+    int edits;
+    int failed;
+    int checked;
+    int i;
+
+    seeds = DEFAULT_SEEDS;
+    edits = DEFAULT_EDITS;
+    lines = DEFAULT_LINES;
+    for (i = 1; i < argc && strncmp(argv[i], "--", 2) == 0; i++) {
+        if (strncmp(argv[i], "--seeds=", 8) == 0 && atoi(argv[i] + 8) >= 0)
+            seeds = atoi(argv[i] + 8);
+        else if (strncmp(argv[i], "--edits=", 8) == 0 && atoi(argv[i] + 8) > 0)
+            edits = atoi(argv[i] + 8);
+        else if (strncmp(argv[i], "--lines=", 8) == 0 && atol(argv[i] + 8) > 0)
+            lines = atol(argv[i] + 8);
+        else {
+            printf("error: unknown option %s\n", argv[i]);
+            return 1;
+        }
+    }
+
+    failed = 0;
+    checked = 0;
+    random_state = 1;
+    for (; i < argc; i++, checked++)
+        if (!check_session(argv[i], edits))
+            failed++;
+
+    for (i = 1; i <= seeds; i++, checked++) {
+        char filename[128];
+        char command[256];
+
+        sprintf(filename, "%s/session%d.as", DIFFERENTIAL_DIR, i);
+        sprintf(command, "./corpus --seed=%d --mix=macro:0 %ld %s", i, lines, filename);
+        if (system(command) != 0) {
+            printf("error: can't generate %s (was corpus built?)\n", filename);
+            return 1;
+        }
+        random_state = i;
+        if (!check_session(filename, edits))
+            failed++;
+        else
+            remove(filename);
+    }
+
+    printf("%d of %d files gave the same results in a session\n", checked - failed, checked);
+    return failed > 0;
+}
@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <string.h>
+#include "trace.h"
+#include "counters.h"
+#include "stats.h"
+#include "utils.h"
+
+
+int stats_enabled = 0;
+
+compile_stats stats;
+
+/* the names of the phases (in the order of stats_phase) */
+char* phase_names[PHASE_COUNT] = {"other", "read_file", "create_am_file", "first_pass", "second_pass", "ob_file", "write_file"};
+
+/* the phases that were entered and not left yet, the time goes to the last one */
+stats_phase phase_stack[16];
+int phase_depth = 0;
+stats_phase current_phase = PHASE_OTHER;
+double phase_since; /* when the time of the current phase was last added */
+double counters_since[COUNTER_COUNT]; /* the values of the counters then */
+
+
+/* adds the time (and the counts) since phase_since to the current phase */
+void add_phase_time() {
+    double now = now_in_microseconds();
+    stats.microseconds[current_phase] += now - phase_since;
+    phase_since = now;
+
+    if (counters_enabled) {
+        double values[COUNTER_COUNT];
+        int i;
+
+        read_counters(values);
+        for (i=0; i<COUNTER_COUNT; i++) {
+            stats.counters[current_phase][i] += values[i] - counters_since[i];
+            counters_since[i] = values[i];
+        }
+    }
+}
+
+/* the time from now on goes to the phase (until stats_leave) */
+void stats_enter(stats_phase phase) {
+    add_phase_time();
+    if (phase_depth < 16)
+        phase_stack[phase_depth] = current_phase;
+    phase_depth++;
+    current_phase = phase;
+}
+
+/* the time from now on goes back to the phase that was before the last stats_enter */
+void stats_leave() {
+    add_phase_time();
+    phase_depth--;
+    current_phase = (phase_depth < 16) ? phase_stack[phase_depth] : current_phase;
+}
+
+/* starts counting the stats of a new file */
+void start_stats() {
+    memset(&stats, 0, sizeof(stats));
+    phase_depth = 0;
+    current_phase = PHASE_OTHER;
+    phase_since = now_in_microseconds();
+    if (counters_enabled)
+        read_counters(counters_since);
+}
+
+/* stops counting, the time of the phase that is running is added to it */
+void stop_stats() {
+    add_phase_time();
+}
+
+/* adds the stats of a file to the total */
+void add_stats(compile_stats* total, compile_stats* file) {
+    int i;
+    int j;
+    for (i=0; i<PHASE_COUNT; i++) {
+        total->microseconds[i] += file->microseconds[i];
+        for (j=0; j<COUNTER_COUNT; j++)
+            total->counters[i][j] += file->counters[i][j];
+    }
+    total->lines += file->lines;
+    total->macro_lines += file->macro_lines;
+    total->symbols += file->symbols;
+    total->symbol_lookups += file->symbol_lookups;
+    total->words += file->words;
+    total->bytes_written += file->bytes_written;
+}
+
+/* prints the stats of a file (name) or of all of the files (name is NULL and files is how many there were),
+ * as two lines of text or as one line of json */
+void print_stats(char* name, int files, compile_stats* s, int json, FILE* stream) {
+    char text[1024];
+    int length;
+    double total;
+    int i;
+
+    total = 0;
+    for (i=0; i<PHASE_COUNT; i++)
+        total += s->microseconds[i];
+
+    if (json) {
+        if (name != NULL)
+            length = sprintf(text, "{\"file\": \"%.200s\", \"microseconds\": {", name);
+        else
+            length = sprintf(text, "{\"files\": %d, \"microseconds\": {", files);
+        for (i=0; i<PHASE_COUNT; i++)
+            length += sprintf(text + length, "\"%s\": %.1f, ", phase_names[i], s->microseconds[i]);
+        sprintf(text + length, "\"total\": %.1f}, \"lines\": %ld, \"macro_lines\": %ld, \"symbols\": %ld, "
+                "\"symbol_lookups\": %ld, \"words\": %ld, \"bytes_written\": %ld}\n", total,
+                s->lines, s->macro_lines, s->symbols, s->symbol_lookups, s->words, s->bytes_written);
+    }
+    else {
+        char title[220];
+
+        if (name != NULL)
+            sprintf(title, "%.200s", name);
+        else
+            sprintf(title, "all %d files", files);
+
+        length = sprintf(text, "stats of %s:", title);
+        for (i=1; i<PHASE_COUNT; i++)
+            length += sprintf(text + length, " %s %.2f ms,", phase_names[i], s->microseconds[i] / 1000);
+        length += sprintf(text + length, " other %.2f ms (total %.2f ms)\n", s->microseconds[PHASE_OTHER] / 1000, total / 1000);
+        sprintf(text + length, "stats of %s: %ld lines, %ld macro lines, %ld symbols, %ld symbol lookups, %ld words, %ld bytes written\n",
+                title, s->lines, s->macro_lines, s->symbols, s->symbol_lookups, s->words, s->bytes_written);
+    }
+
+    fputs(text, stream);
+}
+
+/* prints a table of the counters of every phase of all of the files, the counters that aren't available are left out */
+void print_counters(int files, compile_stats* s, FILE* stream) {
+    double totals[COUNTER_COUNT];
+    int i;
+    int j;
+
+    fprintf(stream, "counters of all %d files%s:\n%-16s", files,
+            counters_from_rusage() ? " (perf_event_open isn't available, from getrusage)" : "", "phase");
+    for (j=0; j<COUNTER_COUNT; j++) {
+        totals[j] = 0;
+        if (counter_available((counter_kind)j))
+            fprintf(stream, " %16s", counter_names[j]);
+    }
+    fputc('\n', stream);
+
+    for (i=1; i<=PHASE_COUNT; i++) {
+        int phase = i % PHASE_COUNT; /* other comes last */
+
+        fprintf(stream, "%-16s", phase_names[phase]);
+        for (j=0; j<COUNTER_COUNT; j++) {
+            totals[j] += s->counters[phase][j];
+            if (counter_available((counter_kind)j))
+                fprintf(stream, " %16.0f", s->counters[phase][j]);
+        }
+        fputc('\n', stream);
+    }
+
+    fprintf(stream, "%-16s", "total");
+    for (j=0; j<COUNTER_COUNT; j++)
+        if (counter_available((counter_kind)j))
+            fprintf(stream, " %16.0f", totals[j]);
+    fputc('\n', stream);
+}
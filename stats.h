@@ -0,0 +1,62 @@
+/* the time every phase takes and what it goes through, for the command line (all --stats / --stats=json).
+ * nothing is counted unless stats_enabled is set, and building with -DNO_STATS removes the counting altogether
+ * (STATS_COUNT and the others become nothing).
+ * STATS_ENTER and STATS_LEAVE also mark the phases in the trace (see trace.h),
+ * and with --counters the perf counters are split between the phases the same way as the time (see counters.h) */
+
+/* the phases the time is split between, a phase's time doesn't include the phases it calls */
+typedef enum {
+    PHASE_OTHER,
+    PHASE_READ_FILE,
+    PHASE_PREPROCESSOR,
+    PHASE_FIRST_PASS,
+    PHASE_SECOND_PASS,
+    PHASE_OB_FILE,
+    PHASE_WRITE_FILE,
+    PHASE_COUNT
+} stats_phase;
+
+/* the stats of one file (or of all of them) */
+typedef struct compile_stats {
+    double microseconds[PHASE_COUNT];
+    double counters[PHASE_COUNT][COUNTER_COUNT]; /* only counted with --counters */
+    long lines; /* of the .as file */
+    long macro_lines; /* lines that were copied from macros */
+    long symbols; /* labels, externs, entries and defines */
+    long symbol_lookups;
+    long words; /* written to the .ob file */
+    long bytes_written;
+} compile_stats;
+
+extern int stats_enabled;
+
+extern char* phase_names[PHASE_COUNT];
+
+extern compile_stats stats; /* of the file that is being compiled */
+
+#ifdef NO_STATS
+#define STATS_COUNT(counter) ((void)0)
+#define STATS_ADD(counter, amount) ((void)0)
+#define STATS_ENTER(phase) TRACE_BEGIN(phase_names[phase], NULL)
+#define STATS_LEAVE() TRACE_END()
+#else
+#define STATS_COUNT(counter) (stats_enabled ? (void)stats.counter++ : (void)0)
+#define STATS_ADD(counter, amount) (stats_enabled ? (void)(stats.counter += (amount)) : (void)0)
+#define STATS_ENTER(phase) ((stats_enabled ? stats_enter(phase) : (void)0), TRACE_BEGIN(phase_names[phase], NULL))
+#define STATS_LEAVE() ((stats_enabled ? stats_leave() : (void)0), TRACE_END())
+#endif
+
+
+void stats_enter(stats_phase phase);
+
+void stats_leave();
+
+void start_stats();
+
+void stop_stats();
+
+void add_stats(compile_stats* total, compile_stats* file);
+
+void print_stats(char* name, int files, compile_stats* s, int json, FILE* stream);
+
+void print_counters(int files, compile_stats* s, FILE* stream);
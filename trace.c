@@ -0,0 +1,153 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "utils.h"
+#include "trace.h"
+
+
+int tracing = 0;
+
+/* a begin or end event, name and detail aren't copied so they must live until the trace is written */
+typedef struct trace_record {
+    char phase; /* 'B' or 'E' */
+    char* name;
+    char* detail; /* the file the event is about (NULL if none) */
+    double time;
+} trace_record;
+
+/* the events of one thread */
+typedef struct trace_buffer {
+    int thread_id;
+    trace_record* records;
+    int count;
+    int capacity;
+    struct trace_buffer* next;
+} trace_buffer;
+
+pthread_key_t trace_key; /* every thread's buffer */
+pthread_mutex_t trace_lock; /* only for adding a buffer */
+trace_buffer* trace_buffers = NULL;
+int trace_threads = 0;
+double trace_start;
+
+
+/* starts recording, it has to be called before any other thread is started */
+void start_tracing() {
+    pthread_key_create(&trace_key, NULL);
+    pthread_mutex_init(&trace_lock, NULL);
+    trace_start = now_in_microseconds();
+    tracing = 1;
+}
+
+/* returns the buffer of the calling thread, it is created on its first event */
+trace_buffer* thread_buffer() {
+    trace_buffer* buffer = (trace_buffer*)pthread_getspecific(trace_key);
+
+    if (buffer != NULL)
+        return buffer;
+
+    buffer = (trace_buffer*)malloc(sizeof(trace_buffer));
+    if (buffer == NULL) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    buffer->records = NULL;
+    buffer->count = 0;
+    buffer->capacity = 0;
+
+    pthread_mutex_lock(&trace_lock);
+    buffer->thread_id = ++trace_threads;
+    buffer->next = trace_buffers;
+    trace_buffers = buffer;
+    pthread_mutex_unlock(&trace_lock);
+
+    pthread_setspecific(trace_key, buffer);
+    return buffer;
+}
+
+/* records an event of the calling thread */
+void trace_event(char phase, char* name, char* detail) {
+    trace_buffer* buffer = thread_buffer();
+    trace_record* record;
+
+    if (buffer->count == buffer->capacity) {
+        trace_record* bigger;
+        buffer->capacity = (buffer->capacity == 0) ? TRACE_BUFFER_EVENTS : buffer->capacity * 2;
+        bigger = (trace_record*)realloc(buffer->records, buffer->capacity * sizeof(trace_record));
+        if (bigger == NULL) {
+            printf("Memory allocation failed\n");
+            exit(1);
+        }
+        buffer->records = bigger;
+    }
+
+    record = &buffer->records[buffer->count++];
+    record->phase = phase;
+    record->name = name;
+    record->detail = detail;
+    record->time = now_in_microseconds() - trace_start;
+}
+
+/* writes the string as a json string */
+void write_json_string(FILE* out, char* string) {
+    fputc('"', out);
+    for (; *string != '\0'; string++) {
+        if (*string == '"' || *string == '\\')
+            fputc('\\', out);
+        if ((unsigned char)*string >= 0x20)
+            fputc(*string, out);
+    }
+    fputc('"', out);
+}
+
+/* writes the events of every thread to the file and frees them (after all of the other threads are done).
+ * returns FALSE if the file can't be written */
+int write_trace(char* filename) {
+    FILE* out;
+    trace_buffer* buffer;
+    int first;
+    int i;
+
+    out = fopen(filename, "w");
+    if (out == NULL) {
+        perror(filename);
+        return 0;
+    }
+
+    fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    first = 1;
+    for (buffer = trace_buffers; buffer != NULL; buffer = buffer->next) {
+        fprintf(out, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": {\"name\": \"thread %d\"}}",
+                first ? "" : ",\n", buffer->thread_id, buffer->thread_id);
+        first = 0;
+
+        for (i=0; i<buffer->count; i++) {
+            trace_record* record = &buffer->records[i];
+
+            fprintf(out, ",\n{\"ph\": \"%c\", \"ts\": %.3f, \"pid\": 1, \"tid\": %d", record->phase, record->time, buffer->thread_id);
+            if (record->name != NULL) {
+                fprintf(out, ", \"name\": ");
+                write_json_string(out, record->name);
+            }
+            if (record->detail != NULL) {
+                fprintf(out, ", \"args\": {\"file\": ");
+                write_json_string(out, record->detail);
+                fputc('}', out);
+            }
+            fputc('}', out);
+        }
+    }
+    fprintf(out, "\n]}\n");
+
+    while (trace_buffers != NULL) {
+        buffer = trace_buffers->next;
+        free(trace_buffers->records);
+        free(trace_buffers);
+        trace_buffers = buffer;
+    }
+    tracing = 0;
+
+    return fclose(out) == 0;
+}
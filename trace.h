@@ -0,0 +1,24 @@
+/* a timeline of what every thread did, written in the chrome trace event format (all --trace <file>),
+ * it opens in chrome://tracing and in perfetto.
+ * every thread records its events in its own buffer, and the buffers are only put together by write_trace.
+ * nothing is recorded unless start_tracing was called, and building with -DNO_TRACE removes the recording */
+
+/* how many events a thread's buffer starts with */
+#define TRACE_BUFFER_EVENTS 4096
+
+extern int tracing;
+
+#ifdef NO_TRACE
+#define TRACE_BEGIN(name, detail) ((void)0)
+#define TRACE_END() ((void)0)
+#else
+#define TRACE_BEGIN(name, detail) (tracing ? trace_event('B', name, detail) : (void)0)
+#define TRACE_END() (tracing ? trace_event('E', NULL, NULL) : (void)0)
+#endif
+
+
+void start_tracing();
+
+void trace_event(char phase, char* name, char* detail);
+
+int write_trace(char* filename);
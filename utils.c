@@ -1,8 +1,20 @@
+#define _POSIX_C_SOURCE 200112L
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
 #include "utils.h"
+#include "trace.h"
+#include "counters.h"
+#include "stats.h"
+#include "alloc.h"
+
+#define ALLOC_SUBSYSTEM ALLOC_UTILS
 
 
 #define TRUE 1
@@ -27,7 +39,7 @@ char* merge_strings(char* str1, char* str2) {
     new_size = str_length + line_length + 1; /* +1 for the null terminator */
 
     /* Reallocate memory for the concatenated string */
-    new_str = (char*)realloc(str1, new_size);
+    new_str = (char*)REALLOC(str1, new_size);
     if (new_str == NULL) {
         printf("Memory allocation failed.\n");
         exit(1);
@@ -90,6 +102,36 @@ int is_valid_name(char* name) {
 }
 
 
+/* starts an empty text */
+void start_text(text_buffer* buffer) {
+    buffer->text = NULL;
+    buffer->length = 0;
+    buffer->capacity = 0;
+}
+
+/* makes room for size more characters (and the null terminator), returns where they go */
+char* reserve_text(text_buffer* buffer, long size) {
+    if (buffer->length + size + 1 > buffer->capacity) {
+        char* bigger;
+        buffer->capacity = (buffer->length + size + 1) * 2;
+        bigger = (char*)REALLOC(buffer->text, buffer->capacity);
+        if (bigger == NULL) {
+            printf("Memory allocation failed\n");
+            exit(1);
+        }
+        buffer->text = bigger;
+    }
+    return buffer->text + buffer->length;
+}
+
+/* adds the string to the end of the text */
+void add_text(text_buffer* buffer, char* text) {
+    long length = strlen(text);
+    memcpy(reserve_text(buffer, length), text, length + 1);
+    buffer->length += length;
+}
+
+
 /* returns the amount od lines in a given string */
 int count_lines(char* str) {
 	int count;
@@ -138,49 +180,283 @@ int find_line_number(char* str, char* line) {
     }
 
 
-/* this function returns the contens of a given file as a string */
-char* read_file(char* filename) {
-    FILE *file;
-    char *file_contents;
-    long file_size;
-    
-    file = fopen(filename, "r");
-    if (file == NULL) {
-        return NULL;
+/* a line in a line_map */
+struct mapped_line {
+    char* start; /* in the text */
+    long length;
+    int number; /* 0 for an empty place in the table */
+};
+
+unsigned long hash_line(char* line, long length) {
+    unsigned long hash = 5381;
+    long i;
+    for (i=0; i<length; i++)
+        hash = hash * 33 + (unsigned char)line[i];
+    return hash;
+}
+
+/* prepares a map of the lines of the text, nothing is done until a line is looked up */
+void start_line_map(line_map* map, char* text) {
+    map->text = text;
+    map->table = NULL;
+    map->size = 0;
+}
+
+/* puts the first line of every content into the table */
+void fill_line_map(line_map* map) {
+    char* p;
+    long lines;
+    int number;
+
+    lines = 1;
+    for (p = map->text; *p != '\0'; p++)
+        if (*p == '\n')
+            lines++;
+    for (map->size = 16; map->size < lines * 2; map->size *= 2)
+        ;
+    map->table = (struct mapped_line*)CALLOC(map->size, sizeof(struct mapped_line));
+    if (map->table == NULL) {
+        printf("Memory allocation failed\n");
+        exit(1);
     }
 
-    /* Determine the file size */
-    fseek(file, 0, SEEK_END);
-    file_size = ftell(file);
-    fseek(file, 0, SEEK_SET);
+    p = map->text;
+    for (number = 1; *p != '\0'; number++) {
+        char* end = strchr(p, '\n');
+        struct mapped_line* place;
+        long length;
+
+        if (end == NULL)
+            end = p + strlen(p);
+        length = end - p;
+
+        place = &map->table[hash_line(p, length) & (map->size - 1)];
+        while (place->number != 0 && !(place->length == length && strncmp(place->start, p, length) == 0))
+            place = (place + 1 == map->table + map->size) ? map->table : place + 1;
+        if (place->number == 0) { /* only the first line with this content is kept */
+            place->start = p;
+            place->length = length;
+            place->number = number;
+        }
 
-    /* Allocate memory for the file contents */
-    file_contents = (char*)malloc(file_size + 1); /* +1 for null terminator */
-    if (file_contents == NULL) {
-        fclose(file);
+        if (*end == '\0')
+            break;
+        p = end + 1;
+    }
+}
+
+/* returns the same as find_line_number(map->text, line), without going through the text every time */
+int find_mapped_line(line_map* map, char* line) {
+    struct mapped_line* place;
+    long length;
+
+    if (map->table == NULL)
+        fill_line_map(map);
+
+    length = strlen(line);
+    place = &map->table[hash_line(line, length) & (map->size - 1)];
+    while (place->number != 0) {
+        if (place->length == length && strncmp(place->start, line, length) == 0)
+            return place->number;
+        place = (place + 1 == map->table + map->size) ? map->table : place + 1;
+    }
+    return -1;
+}
+
+void free_line_map(line_map* map) {
+    FREE(map->table);
+    map->table = NULL;
+}
+
+
+/* reads everything left in the given file descriptor into a null terminated buffer, works for pipes and special files whose size isn't known in advance */
+int read_stream(int fd, source_file* file) {
+    char* buffer;
+    long size;
+    long capacity;
+    
+    capacity = 4096;
+    size = 0;
+    buffer = (char*)MALLOC(capacity);
+    if (buffer == NULL) {
         perror("Memory allocation error");
-        return NULL;
+        return FALSE;
+    }
+    
+    while (1) {
+        long count;
+        
+        /* keep room for the null terminator */
+        if (size + 1 >= capacity) {
+            char* bigger;
+            capacity *= 2;
+            bigger = (char*)REALLOC(buffer, capacity);
+            if (bigger == NULL) {
+                FREE(buffer);
+                perror("Memory allocation error");
+                return FALSE;
+            }
+            buffer = bigger;
+        }
+        
+        count = read(fd, buffer + size, capacity - size - 1);
+        if (count == 0) /* end of file */
+            break;
+        if (count < 0) {
+            FREE(buffer);
+            perror("Error reading file");
+            return FALSE;
+        }
+        size += count;
     }
+    
+    /* Null-terminate the string */
+    buffer[size] = '\0';
+    
+    file->text = buffer;
+    file->length = size;
+    file->is_mapped = FALSE;
+    return TRUE;
+}
 
-    /* Read the file contents into the allocated memory */
-    if (fread(file_contents, 1, file_size, file) != file_size) {
-        fclose(file);
-        free(file_contents);
-        perror("Error reading file");
+/* loads the contents of an open file descriptor into a read only view.
+ * regular files are mapped into memory so no copy is made, everything else is read with read_stream */
+int read_fd(int fd, source_file* file) {
+    struct stat info;
+    
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0) {
+        long page_size = sysconf(_SC_PAGESIZE);
+        
+        /* the rest of the last page after the end of the file reads as zeros, so the mapping is already null terminated.
+         * a file that fills its last page exactly has no room for the terminator so it is read instead */
+        if (page_size > 0 && info.st_size % page_size != 0) {
+            void* map = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            
+            if (map != MAP_FAILED) {
+                posix_madvise(map, info.st_size, POSIX_MADV_SEQUENTIAL); /* the file is read once from start to end */
+                file->text = (char*)map;
+                file->length = info.st_size;
+                file->is_mapped = TRUE;
+                return TRUE;
+            }
+        }
+    }
+    
+    return read_stream(fd, file);
+}
+
+/* this function gives a read only view of the contents of a given file, returns FALSE if the file can't be opened */
+int read_file(char* filename, source_file* file) {
+    int fd;
+    int found;
+    
+    STATS_ENTER(PHASE_READ_FILE);
+    fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        STATS_LEAVE();
+        return FALSE;
+    }
+    
+    found = read_fd(fd, file);
+    
+    close(fd);
+    STATS_LEAVE();
+    return found;
+}
+
+/* releases a view created by read_file or read_fd */
+void close_file(source_file* file) {
+    if (file->text == NULL)
+        return;
+    
+    if (file->is_mapped)
+        munmap(file->text, file->length);
+    else
+        FREE(file->text);
+    
+    file->text = NULL;
+    file->length = 0;
+}
+
+
+/* prepares a reader to go through the lines of the given text */
+void start_lines(line_reader* reader, char* text) {
+    reader->next = text;
+    reader->line = NULL;
+    reader->size = 0;
+    reader->line_number = 0;
+}
+
+/* returns the next line of the text (without the \n) or NULL when the text ended.
+ * unlike strtok the text is not modified, the line is copied into a buffer owned by the reader which is reused for every line */
+char* next_line(line_reader* reader) {
+    char* line_end;
+    int length;
+    
+    if (reader->next == NULL || *reader->next == '\0')
         return NULL;
+    
+    line_end = strchr(reader->next, '\n');
+    if (line_end == NULL) /* the last line doesn't end with \n */
+        line_end = strchr(reader->next, '\0');
+    
+    length = line_end - reader->next;
+    
+    /* grow the buffer if the line doesn't fit (+1 for the null terminator) */
+    if (length + 1 > reader->size) {
+        char* bigger = (char*)REALLOC(reader->line, length + 1);
+        if (bigger == NULL) {
+            printf("Memory allocation failed.\n");
+            exit(1);
+        }
+        reader->line = bigger;
+        reader->size = length + 1;
     }
+    
+    memcpy(reader->line, reader->next, length);
+    reader->line[length] = '\0';
+    
+    reader->next = (*line_end == '\n') ? line_end + 1 : line_end;
+    reader->line_number++;
+    
+    return reader->line;
+}
 
-    /* Null-terminate the string */
-    file_contents[file_size] = '\0';
+/* frees the buffer of a line reader */
+void end_lines(line_reader* reader) {
+    FREE(reader->line);
+    reader->line = NULL;
+    reader->size = 0;
+}
 
-    fclose(file);
-    return file_contents;
+
+/* returns whether the given file exists and contains exactly the given text */
+int file_has_contents(char* filename, char* text, long length) {
+    source_file file;
+    int same;
+    
+    if (!read_file(filename, &file))
+        return FALSE;
+    
+    same = (file.length == length && memcmp(file.text, text, length) == 0);
+    
+    close_file(&file);
+    return same;
 }
 
 
+/* writes the string to the file. a file that already contains exactly the string isn't rewritten, so its modification time stays */
 void write_file(char* filename, char* str) {
+    FILE* file;
+    
+    STATS_ENTER(PHASE_WRITE_FILE);
+    if (file_has_contents(filename, str, strlen(str))) {
+        STATS_LEAVE();
+        return;
+    }
+    
     /* Open the file in write mode */
-    FILE* file = fopen(filename, "w+");
+    file = fopen(filename, "w+");
     if (file == NULL) {
         printf("Error opening file");
         exit(1);
@@ -195,6 +471,74 @@ void write_file(char* filename, char* str) {
 
     /* Close the file */
     fclose(file);
+    STATS_ADD(bytes_written, strlen(str));
+    STATS_LEAVE();
+}
+
+
+/* moves the complete temp_filename over filename, unless filename already has the same contents (then the temporary file is removed) */
+void replace_file(char* temp_filename, char* filename) {
+    source_file temp;
+    
+    TRACE_BEGIN("replace_file", NULL);
+    if (read_file(temp_filename, &temp)) {
+        int same = file_has_contents(filename, temp.text, temp.length);
+        close_file(&temp);
+        
+        if (same) {
+            remove(temp_filename);
+            TRACE_END();
+            return;
+        }
+    }
+    
+    rename(temp_filename, filename);
+    TRACE_END();
+}
+
+
+/* writes a section of a stream of outputs: a "<name> <length>" line followed by exactly length bytes of text (NULL is an empty section) */
+void write_section(FILE* out, char* name, char* text) {
+    long length = (text == NULL) ? 0 : strlen(text);
+    
+    fprintf(out, "%s %ld\n", name, length);
+    if (length > 0)
+        fwrite(text, 1, length, out);
+}
+
+/* reads the section that starts at *cursor (written by write_section) if it's called name.
+ * returns a null terminated copy of its text (NULL if it is empty or missing) and moves the cursor after it */
+char* read_section(char** cursor, char* end, char* name, int* found) {
+    char* line_end;
+    long length;
+    int name_length;
+    char* text;
+    
+    *found = FALSE;
+    name_length = strlen(name);
+    line_end = memchr(*cursor, '\n', end - *cursor);
+    
+    if (line_end == NULL || line_end - *cursor <= name_length || strncmp(*cursor, name, name_length) != 0 || (*cursor)[name_length] != ' ')
+        return NULL;
+    
+    length = atol(*cursor + name_length + 1);
+    if (length < 0 || length > end - (line_end + 1))
+        return NULL;
+    
+    *found = TRUE;
+    *cursor = line_end + 1 + length;
+    if (length == 0)
+        return NULL;
+    
+    text = (char*)MALLOC(length + 1);
+    if (text == NULL) {
+        printf("Memory allocation failed\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(text, line_end + 1, length);
+    text[length] = '\0';
+    
+    return text;
 }
 
 
@@ -207,7 +551,7 @@ char* reformed_array_and_index(const char* name, int index) {
     length = strlen(name) + 6; /* 6 for maximum integer string length and '[' and '\0' */
 
     /* Allocate memory for the resulting string */
-    result = (char*)malloc(length * sizeof(char));
+    result = (char*)MALLOC(length * sizeof(char));
     if (result == NULL) {
         printf("Memory allocation failed\n");
         exit(EXIT_FAILURE);
@@ -235,7 +579,7 @@ char* number_to_string(int num) {
     } while (temp != 0);
     
     /* Allocate memory for the string (+1 for the null terminator and +1 for the #) */
-    str = (char*)malloc((digits + 2) * sizeof(char));
+    str = (char*)MALLOC((digits + 2) * sizeof(char));
     if (str == NULL) {
         printf("Memory allocation failed\n");
         exit(EXIT_FAILURE);
@@ -262,7 +606,7 @@ char* data_number_to_string(int num) {
     } while (temp != 0);
 
     /* allocate memory for the string (+1 for the null terminator) */
-    str = (char*)malloc((digits + 1) * sizeof(char));
+    str = (char*)MALLOC((digits + 1) * sizeof(char));
     if (str == NULL) {
         printf("Memory allocation failed\n");
         exit(EXIT_FAILURE);
@@ -276,14 +620,14 @@ char* data_number_to_string(int num) {
 
 
 
-char* strdup(char* src) {
+char* strdup(const char* src) {
     /* calculate the length of the source string */
     int len; /* length of the new string */
     char* dst; /* destination */
     
     len = strlen(src) + 1; /* +1 for null terminator */
     /* allocate memory for the duplicated string */
-    dst = (char*)malloc(len);
+    dst = (char*)MALLOC(len);
 
     /* check if memory allocation was successful */
     if (dst != NULL) 
@@ -294,8 +638,9 @@ char* strdup(char* src) {
 }
 
 
-
-
-
-
-
+/* the current time in microseconds (of a clock that only goes forward) */
+double now_in_microseconds() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e6 + now.tv_nsec / 1e3;
+}
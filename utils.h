@@ -1,5 +1,41 @@
+/* a read only view of a file's contents, the text is always null terminated */
+typedef struct source_file {
+    char* text; /* must not be modified, it might be mapped straight from the file */
+    long length;
+    int is_mapped;
+} source_file;
+
+/* a string that grows at its end, adding to it doesn't go through what is already in it (unlike merge_strings) */
+typedef struct text_buffer {
+    char* text; /* NULL until something is added */
+    long length;
+    long capacity;
+} text_buffer;
+
+/* finds the number of a line in a text by the contents of the line (see find_line_number),
+ * the lines are hashed the first time one is looked up */
+typedef struct line_map {
+    char* text;
+    struct mapped_line* table; /* NULL until the first lookup */
+    long size; /* the size of the table, a power of 2 */
+} line_map;
+
+/* goes through the lines of a text without modifying it */
+typedef struct line_reader {
+    char* next; /* the start of the next line in the text */
+    char* line; /* a copy of the current line */
+    int size; /* the allocated size of line */
+    int line_number; /* the number of the current line in the text (starting at 1) */
+} line_reader;
+
 char* merge_strings(char* str, char* line);
 
+void start_text(text_buffer* buffer);
+
+char* reserve_text(text_buffer* buffer, long size);
+
+void add_text(text_buffer* buffer, char* text);
+
 int is_integer(char *str);
 
 int to_integer(char *str);
@@ -10,14 +46,42 @@ int count_lines(char* str);
 
 int find_line_number(char* str1, char* str2);
 
-char* read_file(char* filename);
+void start_line_map(line_map* map, char* text);
+
+int find_mapped_line(line_map* map, char* line);
+
+void free_line_map(line_map* map);
+
+int read_file(char* filename, source_file* file);
+
+int read_fd(int fd, source_file* file);
+
+int read_stream(int fd, source_file* file);
+
+void close_file(source_file* file);
+
+void start_lines(line_reader* reader, char* text);
+
+char* next_line(line_reader* reader);
+
+void end_lines(line_reader* reader);
+
+int file_has_contents(char* filename, char* text, long length);
 
 void write_file(char* filename, char* text);
 
-char* strdup(char* src);
+void replace_file(char* temp_filename, char* filename);
+
+void write_section(FILE* out, char* name, char* text);
+
+char* read_section(char** cursor, char* end, char* name, int* found);
+
+char* strdup(const char* src);
 
 char* data_number_to_string(int num);
 
 char* number_to_string(int num);
 
 char* reformed_array_and_index(const char* name, int index);
+
+double now_in_microseconds();
@@ -0,0 +1,305 @@
+#define _POSIX_C_SOURCE 200112L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <dirent.h>
+#include <sys/inotify.h>
+#include "sentences.h"
+#include "utils.h"
+#include "asm.h"
+#include "watch.h"
+#include "alloc.h"
+
+#define ALLOC_SUBSYSTEM ALLOC_DRIVER
+
+
+/* a watched .as file and its warm state */
+typedef struct watched_file {
+    char* name; /* the filename without the .as extension */
+    asm_session* session; /* NULL until the file is assembled for the first time */
+    char* text; /* the source the session has */
+    long length;
+    int is_dirty; /* the file changed since it was assembled */
+    struct watched_file* next;
+} watched_file;
+
+
+/* returns whether the filename ends with .as, and puts the name without it in name */
+int is_source_name(char* filename, char* name) {
+    int length = strlen(filename);
+
+    if (length <= 3 || length > 100 || strcmp(filename + length - 3, ".as") != 0)
+        return FALSE;
+    memcpy(name, filename, length - 3);
+    name[length - 3] = '\0';
+    return TRUE;
+}
+
+/* returns the watched file of the name, it is added to the list if it's new */
+watched_file* get_watched(watched_file** head, char* name) {
+    watched_file* current;
+
+    for (current = *head; current != NULL; current = current->next)
+        if (strcmp(current->name, name) == 0)
+            return current;
+
+    current = (watched_file*)MALLOC(sizeof(watched_file));
+    if (current == NULL) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    current->name = STRDUP(name);
+    current->session = NULL;
+    current->text = NULL;
+    current->length = 0;
+    current->is_dirty = FALSE;
+    current->next = *head;
+    *head = current;
+    return current;
+}
+
+void free_watched(watched_file* file) {
+    asm_session_destroy(file->session);
+    FREE(file->name);
+    FREE(file->text);
+    FREE(file);
+}
+
+/* stops watching the file of the name (it was deleted or moved away) */
+void forget_watched(watched_file** head, char* name) {
+    watched_file** link = head;
+
+    while (*link != NULL && strcmp((*link)->name, name) != 0)
+        link = &(*link)->next;
+    if (*link != NULL) {
+        watched_file* file = *link;
+        *link = file->next;
+        free_watched(file);
+    }
+}
+
+
+/* sets starts to the offset of every line of the text and the length of the text after them, returns the amount of lines */
+int line_starts(char* text, long length, long** starts) {
+    int count;
+    long i;
+
+    count = 0;
+    for (i=0; i<length; i++)
+        if (text[i] == '\n')
+            count++;
+    if (length > 0 && text[length-1] != '\n')
+        count++;
+
+    *starts = (long*)MALLOC((count + 1) * sizeof(long));
+    if (*starts == NULL) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+
+    count = 0;
+    (*starts)[0] = 0;
+    for (i=0; i<length; i++)
+        if (text[i] == '\n' && i + 1 < length)
+            (*starts)[++count] = i + 1;
+    if (length > 0)
+        count++;
+    (*starts)[count] = length;
+    return count;
+}
+
+int same_line(char* old_text, long* old_starts, int old_line, char* new_text, long* new_starts, int new_line) {
+    long length = old_starts[old_line+1] - old_starts[old_line];
+    return length == new_starts[new_line+1] - new_starts[new_line] &&
+           memcmp(old_text + old_starts[old_line], new_text + new_starts[new_line], length) == 0;
+}
+
+/* edits the session of the file to the new text. only the lines between the unchanged start and end of the file are replaced */
+int edit_session(watched_file* file, char* text, long length, asm_edit_stats* stats) {
+    long* old_starts;
+    long* new_starts;
+    int old_count;
+    int new_count;
+    int prefix;
+    int suffix;
+    int succeeded;
+
+    old_count = line_starts(file->text, file->length, &old_starts);
+    new_count = line_starts(text, length, &new_starts);
+
+    prefix = 0;
+    while (prefix < old_count && prefix < new_count && same_line(file->text, old_starts, prefix, text, new_starts, prefix))
+        prefix++;
+    suffix = 0;
+    while (suffix < old_count - prefix && suffix < new_count - prefix &&
+           same_line(file->text, old_starts, old_count - 1 - suffix, text, new_starts, new_count - 1 - suffix))
+        suffix++;
+
+    succeeded = asm_session_edit(file->session, prefix + 1, old_count - prefix - suffix, text + new_starts[prefix],
+                                 new_starts[new_count - suffix] - new_starts[prefix], stats);
+
+    FREE(old_starts);
+    FREE(new_starts);
+    return succeeded;
+}
+
+/* writes the file <dir>/<name>.<extension> */
+void write_watched_output(char* dir, char* name, char* extension, char* text) {
+    char filename[256];
+    sprintf(filename, "%.120s/%.100s.%s", dir, name, extension);
+    write_file(filename, text);
+}
+
+/* assembles a file that changed and rewrites its outputs (files whose contents stay the same aren't touched) */
+void reassemble(asm_context* context, char* dir, watched_file* file) {
+    char filename[256];
+    source_file source;
+    asm_result result;
+    asm_edit_stats stats;
+    double start;
+    int i;
+
+    file->is_dirty = FALSE;
+    sprintf(filename, "%.120s/%.100s.as", dir, file->name);
+    if (!read_file(filename, &source))
+        return; /* it was deleted before we got to it */
+
+    if (file->text != NULL && file->length == source.length && memcmp(file->text, source.text, source.length) == 0) {
+        close_file(&source); /* saved without changes */
+        return;
+    }
+
+    start = now_in_microseconds();
+
+    if (file->session == NULL) {
+        file->session = asm_session_create(context);
+        asm_session_load(file->session, source.text, source.length);
+        memset(&stats, 0, sizeof(stats));
+    }
+    else
+        edit_session(file, source.text, source.length, &stats);
+
+    asm_session_result(file->session, &result);
+
+    if (result.am != NULL)
+        write_watched_output(dir, file->name, "am", result.am);
+    if (result.succeeded) {
+        write_watched_output(dir, file->name, "ob", result.ob);
+        if (result.ent != NULL)
+            write_watched_output(dir, file->name, "ent", result.ent);
+        if (result.ext != NULL)
+            write_watched_output(dir, file->name, "ext", result.ext);
+    }
+
+    for (i=0; i<result.message_count; i++) {
+        asm_message* m = &result.messages[i];
+        printf("%s/%s.as:%d:%d: %s: %s [%s]\n", dir, file->name, m->line, m->column, m->severity, m->message, m->code);
+    }
+
+    if (stats.incremental)
+        printf("%s.as: compilation %s in %.2f ms (%d lines lexed, %d words encoded, %d words patched)\n", file->name,
+               result.succeeded ? "succeeded" : "failed", (now_in_microseconds() - start) / 1000,
+               stats.lines_lexed, stats.words_encoded, stats.words_patched);
+    else
+        printf("%s.as: compilation %s in %.2f ms (full assembly)\n", file->name,
+               result.succeeded ? "succeeded" : "failed", (now_in_microseconds() - start) / 1000);
+    fflush(stdout);
+
+    asm_free_result(context, &result);
+
+    FREE(file->text);
+    file->text = (char*)MALLOC(source.length + 1);
+    if (file->text == NULL) {
+        printf("Memory allocation failed\n");
+        exit(1);
+    }
+    memcpy(file->text, source.text, source.length);
+    file->text[source.length] = '\0';
+    file->length = source.length;
+    close_file(&source);
+}
+
+/* reads the waiting inotify events and marks the files they are about */
+void read_events(int fd, watched_file** head) {
+    char buffer[4096];
+    long length;
+    long offset;
+
+    length = read(fd, buffer, sizeof(buffer));
+    for (offset = 0; offset < length; ) {
+        struct inotify_event* event = (struct inotify_event*)(buffer + offset);
+        char name[101];
+
+        if (event->len > 0 && is_source_name(event->name, name)) {
+            if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+                forget_watched(head, name);
+            else
+                get_watched(head, name)->is_dirty = TRUE;
+        }
+        offset += sizeof(struct inotify_event) + event->len;
+    }
+}
+
+/* watches the .as files of the directory and re-assembles them whenever they are written, it never returns unless it fails */
+int watch_directory(char* dir) {
+    asm_context* context;
+    watched_file* files;
+    watched_file* file;
+    struct pollfd waiting;
+    DIR* directory;
+    struct dirent* entry;
+    int fd;
+
+    fd = inotify_init();
+    if (fd < 0 || inotify_add_watch(fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM) < 0) {
+        perror(dir);
+        return 1;
+    }
+
+    context = asm_create_context(NULL);
+    files = NULL;
+
+    /* assemble everything once */
+    directory = opendir(dir);
+    if (directory == NULL) {
+        perror(dir);
+        return 1;
+    }
+    while ((entry = readdir(directory)) != NULL) {
+        char name[101];
+        if (is_source_name(entry->d_name, name))
+            get_watched(&files, name)->is_dirty = TRUE;
+    }
+    closedir(directory);
+
+    printf("watching %s\n", dir);
+    waiting.fd = fd;
+    waiting.events = POLLIN;
+
+    while (1) {
+        for (file = files; file != NULL; file = file->next)
+            if (file->is_dirty)
+                reassemble(context, dir, file);
+
+        if (poll(&waiting, 1, -1) < 0) {
+            perror("poll");
+            break;
+        }
+        read_events(fd, &files);
+
+        /* wait until the files stay quiet */
+        while (poll(&waiting, 1, DEBOUNCE_MILLISECONDS) > 0)
+            read_events(fd, &files);
+    }
+
+    while (files != NULL) {
+        file = files->next;
+        free_watched(files);
+        files = file;
+    }
+    asm_destroy_context(context);
+    close(fd);
+    return 1;
+}
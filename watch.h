@@ -0,0 +1,8 @@
+/* the watch mode (all --watch <dir>).
+ * every .as file in the directory stays loaded in an assembler session, and when a file is written
+ * only the lines that changed are assembled again and its output files are rewritten */
+
+/* how long the files have to stay quiet before they are assembled (editors write a file in several steps) */
+#define DEBOUNCE_MILLISECONDS 50
+
+int watch_directory(char* dir);